@@ -0,0 +1,132 @@
+/**
+ * @file ana.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Check a reflow process against the limits of its profile
+ */
+#include "ana.h"
+#include "profile.h"
+
+#define NEAR_PEAK (5 * 4) // range below the peak temperature (5 degC)
+
+static profile_limits_t lim;
+static int16_t liquidus;
+static uint32_t t; // time since the start (ms)
+
+// last readings, for the ramp rates:
+static int16_t window[ANA_WINDOW];
+static uint8_t win_pos, win_count;
+static uint8_t ramp_up, ramp_down;
+
+static uint32_t tal_ms, soak_ms;
+static int16_t peak;
+
+// Each time the peak rises, the new peak and the current time are appended;
+// entries that are no longer within 5 degC of the peak are dropped from the
+// front. Thus the first entry tells when the temperature has first come
+// within 5 degC of the peak. The temperatures increase by at least 1, so
+// there are at most NEAR_PEAK + 1 entries.
+static int16_t near_temp[NEAR_PEAK + 1];
+static uint16_t near_time[NEAR_PEAK + 1]; // (s)
+static uint8_t near_head, near_count;
+static uint16_t near_last; // last time within 5 degC of the peak (s)
+
+void ana_start(uint8_t profile)
+{
+    profile_limits(profile, &lim);
+    liquidus = profile_liquidus(profile);
+    t = 0;
+    win_pos = win_count = 0;
+    ramp_up = ramp_down = 0;
+    tal_ms = soak_ms = 0;
+    near_head = near_count = 0;
+}
+
+/**
+ * @brief Update the maximum ramp rates with the reading @p temp .
+ */
+static void update_rates(int temp, uint16_t dt)
+{
+    if (win_count == ANA_WINDOW) {
+        // change over the window in 0.1 degC/s
+        int32_t rate = ((int32_t)temp - window[win_pos]) * 2500 / ((int32_t)ANA_WINDOW * dt);
+        if (rate > ramp_up)
+            ramp_up = rate > 255 ? 255 : rate;
+        if (-rate > ramp_down)
+            ramp_down = -rate > 255 ? 255 : -rate;
+    } else
+        win_count++;
+
+    window[win_pos] = temp;
+    if (++win_pos == ANA_WINDOW)
+        win_pos = 0;
+}
+
+/**
+ * @brief Update the peak temperature and the time within 5 degC of it.
+ */
+static void update_peak(int temp)
+{
+    uint16_t now = t / 1000;
+
+    if (near_count == 0 || temp > peak) {
+        peak = temp;
+        while (near_count > 0 && near_temp[near_head] < peak - NEAR_PEAK) {
+            if (++near_head == NEAR_PEAK + 1)
+                near_head = 0;
+            near_count--;
+        }
+
+        uint8_t i = near_head + near_count;
+        if (i >= NEAR_PEAK + 1)
+            i -= NEAR_PEAK + 1;
+        near_temp[i] = temp;
+        near_time[i] = now;
+        near_count++;
+    }
+
+    if (temp >= peak - NEAR_PEAK)
+        near_last = now;
+}
+
+void ana_update(int temp, uint16_t dt, uint8_t soak)
+{
+    if (dt == 0)
+        return;
+
+    t += dt;
+    update_rates(temp, dt);
+    update_peak(temp);
+
+    if (temp >= liquidus)
+        tal_ms += dt;
+    if (soak)
+        soak_ms += dt;
+}
+
+uint8_t ana_result(ana_result_t *res)
+{
+    uint8_t fails = 0;
+
+    res->ramp_up = ramp_up;
+    res->ramp_down = ramp_down;
+    res->peak = near_count > 0 ? peak : 0;
+    res->tal = tal_ms / 1000;
+    res->near_peak = near_count > 0 ? near_last - near_time[near_head] : 0;
+    res->soak = soak_ms / 1000;
+
+    if (res->ramp_up > lim.ramp_up)
+        fails |= ANA_F_RAMP_UP;
+    if (res->ramp_down > lim.ramp_down)
+        fails |= ANA_F_RAMP_DOWN;
+    if (res->tal < lim.tal_min || res->tal > lim.tal_max)
+        fails |= ANA_F_TAL;
+    if (res->peak < lim.peak_min || res->peak > lim.peak_max)
+        fails |= ANA_F_PEAK;
+    if (res->near_peak > lim.near_peak_max)
+        fails |= ANA_F_NEAR_PEAK;
+    if (res->soak < lim.soak_min || res->soak > lim.soak_max)
+        fails |= ANA_F_SOAK;
+    return fails;
+}
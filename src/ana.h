@@ -0,0 +1,74 @@
+/**
+ * @file ana.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Check a reflow process against the limits of its profile
+ *
+ * The process metrics are updated with each temperature reading, in
+ * constant time and without keeping the trace:
+ *
+ *  - the maximum ramp-up and ramp-down rate, over a window of
+ *    @c ANA_WINDOW readings (which smooths the quantization of the
+ *    thermocouple)
+ *  - the time above the liquidus temperature
+ *  - the peak temperature and the time within 5 degC of it (from the first
+ *    to the last reading in that range)
+ *  - the time spent in the soak zone (segments with @c SEG_F_SOAK )
+ *
+ * The metrics are final once the temperature has dropped below the
+ * liquidus temperature after the peak (the ramp-down rate is updated until
+ * the end).
+ */
+
+#ifndef ANA_H
+#define ANA_H
+
+#include <stdint.h>
+
+// number of readings over which the ramp rates are measured
+#ifndef ANA_WINDOW
+#define ANA_WINDOW  5
+#endif
+
+// Limits violated by a process (see ana_result()):
+#define ANA_F_RAMP_UP   1  // ramp-up rate too high
+#define ANA_F_RAMP_DOWN 2  // ramp-down rate too high
+#define ANA_F_TAL       4  // time above liquidus too short or too long
+#define ANA_F_PEAK      8  // peak temperature too low or too high
+#define ANA_F_NEAR_PEAK 16 // too long within 5 degC of the peak
+#define ANA_F_SOAK      32 // soak time too short or too long
+
+typedef struct {
+    uint8_t ramp_up, ramp_down; // max. ramp rates (0.1 degC/s)
+    int16_t peak;               // peak temperature (multiplied by 4)
+    uint16_t tal;               // time above liquidus (s)
+    uint16_t near_peak;         // time within 5 degC of the peak (s)
+    uint16_t soak;              // soak time (s)
+} ana_result_t;
+
+/**
+ * @brief Start checking a process with profile number @p profile .
+ */
+void ana_start(uint8_t profile);
+
+/**
+ * @brief Update the process metrics with a new reading.
+ *
+ * @p temp is the temperature within the oven (multiplied by 4), @p dt is
+ * the time since the last update (or the start) in ms and @p soak is
+ * nonzero while the process is in the soak zone. The rates assume that
+ * @p dt stays the same.
+ */
+void ana_update(int temp, uint16_t dt, uint8_t soak);
+
+/**
+ * @brief Get the process metrics.
+ *
+ * The metrics so far are written to @p res . The function returns the
+ * limits of the profile that are violated (ANA_F_* bits, 0 if the process
+ * passes).
+ */
+uint8_t ana_result(ana_result_t *res);
+
+#endif // ANA_H
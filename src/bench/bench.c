@@ -0,0 +1,234 @@
+/**
+ * @file bench.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Cycle count benchmark on a simulated AVR
+ *
+ * The oven is driven through all modes (and the phases of a reflow) by a
+ * fixed scenario. For each step, the number of runs, the average and the
+ * maximum cycle count of each interrupt routine and task are collected and
+ * written to the serial line at the end, one line per step and path:
+ *
+ *     bench,STEP,PATH,RUNS,AVG,MAX
+ *
+ * followed by the fraction of the time the CPU has been active (not
+ * sleeping in the main loop) in each step, in 1/1000:
+ *
+ *     active,STEP,PERMILLE
+ *
+ * After the scenario, building the temperature line of the LCD with fmt.h
+ * is compared with building it with snprintf(), as the display did before
+ * fmt.h, over a range of temperatures (step "format", paths "fmt" and
+ * "snprintf"; the benchmark build is the only one that links snprintf).
+ * Last comes the high-water mark of the stack over the whole scenario in
+ * bytes (see @c hal_ram_usage() ):
+ *
+ *     stack,BYTES
+ *
+ * Then the CPU is put to sleep with interrupts disabled, which ends the
+ * simulation.
+ */
+#include "bench.h"
+#include "hal.h"
+#include "oven.h"
+#include "uart.h"
+#include "fmt.h"
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#define T(deg)   ((deg) * 4)  // hot junction temperature
+#define IC(deg)  ((deg) * 16) // cold junction temperature
+#define S(secs)  ((secs) * HAL_TICK_HZ)
+
+#define PRESS    1 // short press at the start of the step
+#define HOLD     2 // long press (3 s) at the start of the step
+
+typedef struct {
+    const char *name;
+    uint8_t bake;       // mode switch
+    uint8_t button;     // PRESS, HOLD or 0
+    int hot, cold;      // readings of the MAX31855K
+    uint8_t fault;
+    uint16_t ticks;     // duration
+    const char *cmd;    // received over the serial line at the start of the step
+} step_t;
+
+static const step_t steps[] = {
+    { "idle",            0, 0,     T(25),  IC(25), 0, S(10), NULL },
+    { "remote",          0, 0,     T(25),  IC(25), 0, S(2),  "status\r\nset temp 130\r\nprofile\r\n" },
+    { "reflow-preheat",  0, PRESS, T(60),  IC(25), 0, S(10), NULL },
+    { "reflow-soak",     0, 0,     T(110), IC(25), 0, S(125), NULL },
+    { "reflow-ramp",     0, 0,     T(170), IC(25), 0, S(5), NULL },
+    { "reflow-liquidus", 0, 0,     T(200), IC(25), 0, S(5), NULL },
+    { "reflow-peak",     0, 0,     T(236), IC(25), 0, S(5), NULL },
+    { "reflow-cool",     0, 0,     T(150), IC(25), 0, S(10), NULL },
+    { "reflow-end",      0, 0,     T(40),  IC(25), 0, S(3), NULL },
+    { "bake",            1, PRESS, T(120), IC(25), 0, S(20), NULL },
+    { "bake-cool",       1, PRESS, T(100), IC(25), 0, S(10), NULL },
+    { "bake-end",        1, 0,     T(40),  IC(25), 0, S(3), NULL },
+    { "tune",            1, HOLD,  T(100), IC(25), 0, S(10), NULL },
+    { "tune-relay",      1, 0,     T(160), IC(25), 0, S(10), NULL },
+    { "tune-cool",       1, PRESS, T(40),  IC(25), 0, S(3), NULL },
+    { "overheat",        0, 0,     T(25),  IC(45), 0, S(10), NULL },
+    { "fault",           0, 0,     T(25),  IC(25), 1, S(10), NULL },
+};
+
+#define NUM_STEPS (sizeof(steps) / sizeof(steps[0]))
+
+// tasks in the order of registration (see oven_init())
+static const char *const paths[BENCH_PATHS] = {
+    [BENCH_ISR_TICK] = "isr_tick",
+    [BENCH_ISR_PWM] = "isr_pwm",
+    [BENCH_ISR_UART] = "isr_uart",
+    [BENCH_ISR_BUTTON] = "isr_button",
+    [BENCH_ISR_SPI] = "isr_spi",
+    [BENCH_ISR_RX] = "isr_rx",
+    [BENCH_TASK(0)] = "button_task",
+    [BENCH_TASK(1)] = "sample_task",
+    [BENCH_TASK(2)] = "control_task",
+#ifdef USE_TELEMETRY
+    [BENCH_TASK(3)] = "telem_task",
+#else
+    [BENCH_TASK(3)] = "display_task",
+#endif
+    [BENCH_TASK(4)] = "cmd_task",
+};
+
+typedef struct {
+    uint16_t runs;
+    uint32_t sum, max;
+} stat_t;
+
+static stat_t stats[NUM_STEPS][BENCH_PATHS];
+static uint64_t slept[NUM_STEPS];   // cycles
+static uint16_t elapsed[NUM_STEPS]; // ticks
+static volatile uint8_t step;
+
+void bench_add(uint8_t path, uint32_t cycles)
+{
+    if (step >= NUM_STEPS)
+        return;
+
+    stat_t *s = &stats[step][path];
+    HAL_ATOMIC {
+        if (s->runs != 0xffff) {
+            s->runs++;
+            s->sum += cycles;
+        }
+        if (cycles > s->max)
+            s->max = cycles;
+    }
+}
+
+void bench_sleep(uint32_t cycles)
+{
+    if (step < NUM_STEPS)
+        slept[step] += cycles;
+}
+
+/**
+ * @brief Run the oven for @p n ticks.
+ */
+static void run(uint16_t n)
+{
+    uint16_t start = bench_ticks();
+    while ((uint16_t)(bench_ticks() - start) < n)
+        oven_poll();
+}
+
+/**
+ * @brief Build the temperature line for the temperatures from -20 to 300
+ * degC, with fmt.h or (@p use_printf non-zero) with snprintf(), and collect
+ * the cycle counts in @p s .
+ */
+static void bench_format(uint8_t use_printf, stat_t *s)
+{
+    char line[21];
+    int t;
+
+    for (t = T(-20); t <= T(300); t += 7) {
+        uint32_t t0, cycles;
+        HAL_ATOMIC {
+            t0 = bench_now();
+            if (use_printf) {
+                if (t >= 0)
+                    snprintf(line, sizeof(line), "Temp: %d.%02d degC", t >> 2, (t & 3) * 25);
+                else
+                    snprintf(line, sizeof(line), "Temp: -%d.%02d degC", -t >> 2, (-t & 3) * 25);
+            } else {
+                char *p = fmt_str(line, "Temp: ");
+                p = fmt_temp4(p, t, 0);
+                fmt_str(p, " degC");
+            }
+            cycles = bench_now() - t0;
+        }
+        s->runs++;
+        s->sum += cycles;
+        if (cycles > s->max)
+            s->max = cycles;
+    }
+}
+
+int main()
+{
+    uint8_t i, j;
+
+    bench_hw_init();
+    bench_set_temp(T(25), IC(25), 0);
+    oven_init();
+
+    for (i = 0; i < NUM_STEPS; i++) {
+        const step_t *s = &steps[i];
+
+        uint16_t t0 = bench_ticks();
+        step = i;
+        bench_set_switch(s->bake);
+        bench_set_temp(s->hot, s->cold, s->fault);
+        if (s->cmd != NULL)
+            bench_send(s->cmd);
+        if (s->button) {
+            bench_set_button(1);
+            run(s->button == HOLD ? S(3) : 2);
+            bench_set_button(0);
+        }
+        run(s->ticks);
+        elapsed[i] = bench_ticks() - t0;
+    }
+
+    // wait for the display output to be sent, stop measuring
+    run(S(2));
+    step = NUM_STEPS;
+
+    fprintf(uart_file, "\n");
+    for (i = 0; i < NUM_STEPS; i++)
+        for (j = 0; j < BENCH_PATHS; j++) {
+            const stat_t *s = &stats[i][j];
+            if (s->runs == 0 || paths[j] == NULL)
+                continue;
+            fprintf(uart_file, "bench,%s,%s,%u,%lu,%lu\n", steps[i].name, paths[j], s->runs,
+                    (unsigned long)((s->sum + s->runs / 2) / s->runs), (unsigned long)s->max);
+        }
+    for (i = 0; i < 2; i++) {
+        stat_t s = { 0, 0, 0 };
+        bench_format(i, &s);
+        fprintf(uart_file, "bench,format,%s,%u,%lu,%lu\n", i ? "snprintf" : "fmt", s.runs,
+                (unsigned long)((s.sum + s.runs / 2) / s.runs), (unsigned long)s.max);
+    }
+    for (i = 0; i < NUM_STEPS; i++) {
+        uint64_t total = (uint64_t)elapsed[i] * (F_CPU / HAL_TICK_HZ / BENCH_SPEEDUP);
+        uint64_t active = total > slept[i] ? total - slept[i] : 0;
+        fprintf(uart_file, "active,%s,%u\n", steps[i].name, (unsigned)((active * 1000 + total / 2) / total));
+    }
+    hal_ram_t ram;
+    hal_ram_usage(&ram);
+    fprintf(uart_file, "stack,%u\n", ram.stack);
+
+    // sleeping with interrupts disabled ends the simulation
+    uart_flush();
+    cli();
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_mode();
+    return 0;
+}
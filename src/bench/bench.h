@@ -0,0 +1,102 @@
+/**
+ * @file bench.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Cycle count benchmark on a simulated AVR
+ *
+ * simavr does not simulate the XMEGA family, hence the benchmark build
+ * runs the firmware on an ATmega1284P (same AVR core, compiled with BENCH
+ * defined) with the hardware abstraction layer in hal_bench.c. The
+ * MAX31855K, the button, the mode switch and the serial input are replaced
+ * by inputs set by the benchmark scenario in bench.c; the SPI transfers
+ * complete at once.
+ *
+ * Timer 1 counts CPU cycles. The interrupt routines and the tasks of the
+ * scheduler report their cycle counts with @c bench_add() ; the counts of
+ * the tasks include the interrupts that preempt them. The cycles the CPU
+ * sleeps in the main loop are reported with @c bench_sleep() , which gives
+ * the fraction of the time it is active.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include "sched.h"
+
+/**
+ * @brief Factor by which the update timer runs faster than real time.
+ *
+ * A factor above 1 shortens the simulation of the long reflow phases, but
+ * tasks waiting for the serial line then take up a larger part of a tick.
+ */
+#ifndef BENCH_SPEEDUP
+#define BENCH_SPEEDUP 1
+#endif
+
+// Measured code paths:
+#define BENCH_ISR_TICK   0 // update timer interrupt
+#define BENCH_ISR_PWM    1 // start of a PWM period
+#define BENCH_ISR_UART   2 // USART data register empty interrupt
+#define BENCH_ISR_BUTTON 3 // button interrupt
+#define BENCH_ISR_SPI    4 // SPI transfer complete interrupt
+#define BENCH_ISR_RX     5 // USART receive complete interrupt
+#define BENCH_TASK(i)    (6 + (i)) // task number i of the scheduler
+#define BENCH_PATHS      BENCH_TASK(SCHED_MAX_TASKS)
+
+/**
+ * @brief Start the cycle counter.
+ */
+void bench_hw_init();
+
+/**
+ * @brief Get the number of CPU cycles since @c bench_hw_init() .
+ */
+uint32_t bench_now();
+
+/**
+ * @brief Add a run of path @p path (BENCH_*) that took @p cycles cycles.
+ */
+void bench_add(uint8_t path, uint32_t cycles);
+
+/**
+ * @brief Add @p cycles cycles the CPU has slept.
+ */
+void bench_sleep(uint32_t cycles);
+
+/**
+ * @brief Get the number of ticks of the update timer since the start.
+ */
+uint16_t bench_ticks();
+
+/**
+ * @brief Set the reading of the MAX31855K (the same for all devices).
+ *
+ * @p hot is the hot junction temperature (multiplied by 4), @p cold the
+ * cold junction temperature (multiplied by 16); with @p fault set, the
+ * fault bit is reported instead.
+ */
+void bench_set_temp(int hot, int cold, uint8_t fault);
+
+/**
+ * @brief Receive the characters of @p str over the serial line.
+ *
+ * Each character calls @c hal_on_uart_rx() like the interrupt routine.
+ */
+void bench_send(const char *str);
+
+/**
+ * @brief Set the mode switch (@p bake non-zero: bake).
+ */
+void bench_set_switch(uint8_t bake);
+
+/**
+ * @brief Press (@p down non-zero) or release the start/stop button.
+ *
+ * Pressing the button calls @c hal_on_button() like the interrupt routine.
+ */
+void bench_set_button(uint8_t down);
+
+#endif // BENCH_H
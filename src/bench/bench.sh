@@ -0,0 +1,96 @@
+#!/bin/sh
+# Collect the section sizes of the firmware and run the cycle count
+# benchmark under simavr (see bench.h); the results are written to stdout
+# as CSV, one value per line. Fails if the RAM left beyond the variables
+# and the high-water mark of the stack is less than MARGIN bytes.
+#
+# usage: bench.sh ELF MMCU BENCH_ELF BENCH_MMCU MARGIN
+
+set -e
+
+elf=$1
+mmcu=$2
+bench_elf=$3
+bench_mmcu=$4
+margin=$5
+
+for tool in avr-size avr-nm simavr; do
+    if ! command -v $tool > /dev/null; then
+        echo "$0: $tool not found, no benchmark results" >&2
+        exit 1
+    fi
+done
+
+# application flash and SRAM of the target (bytes)
+case $mmcu in
+    atxmega32a4u) flash=32768; sram=4096 ;;
+    *) echo "$0: unknown MCU $mmcu" >&2; exit 1 ;;
+esac
+
+echo "metric,scope,item,value"
+
+# the RAM not used by variables is left for the stack
+sizes=$(avr-size -A "$elf" | awk -v mmcu="$mmcu" -v flash="$flash" -v sram="$sram" '
+    $1 == ".text"   { text = $2 }
+    $1 == ".data"   { data = $2 }
+    $1 == ".bss"    { bss = $2 }
+    $1 == ".noinit" { noinit = $2 }
+    END {
+        printf "size,%s,text,%d\n", mmcu, text
+        printf "size,%s,data,%d\n", mmcu, data
+        printf "size,%s,bss,%d\n", mmcu, bss + noinit
+        printf "size,%s,flash_free,%d\n", mmcu, flash - text - data
+        printf "size,%s,ram_free,%d\n", mmcu, sram - data - bss - noinit
+    }')
+echo "$sizes"
+ram_free=$(echo "$sizes" | awk -F, '$3 == "ram_free" { print $4 }')
+
+# the largest variable, the run record (REC_SIZE, see rec.h), is the one to
+# shrink if the headroom below is too small
+rec_size=$(avr-nm -S "$elf" | awk '$4 == "rec" { print $2 }')
+echo "size,$mmcu,rec_buffer,$((0x${rec_size:-0}))"
+
+# flash of the number formatter (see fmt.h) against that of snprintf(),
+# which only the benchmark build links, to compare them (see bench.c)
+sym_size() {
+    total=0
+    for s in $(avr-nm -S "$1" | awk -v re="$2" '$4 ~ re { print $2 }'); do
+        total=$((total + 0x$s))
+    done
+    echo "$total"
+}
+echo "size,$mmcu,fmt,$(sym_size "$elf" '^fmt_')"
+echo "size,$bench_mmcu,snprintf,$(sym_size "$bench_elf" '^(snprintf|vfprintf|__ultoa_invert)$')"
+
+# simavr prints each line sent by USART0 (possibly with colour codes) and
+# exits when the firmware sleeps with interrupts disabled; the clock
+# matches F_CPU (see clock.h)
+out=$(simavr -m "$bench_mmcu" -f 32000000 "$bench_elf" 2>&1 |
+      sed 's/\x1b\[[0-9;]*m//g' | tr -d '\r' | grep -o '\(bench\|active\|stack\),.*' || true)
+if [ -z "$out" ]; then
+    echo "$0: no results from $bench_elf" >&2
+    exit 1
+fi
+
+echo "$out" | awk -F, '
+    $1 == "bench" {
+        printf "runs,%s,%s,%s\n", $2, $3, $4
+        printf "cycles_avg,%s,%s,%s\n", $2, $3, $5
+        printf "cycles_max,%s,%s,%s\n", $2, $3, $6
+    }
+    $1 == "active" { printf "active_permille,%s,cpu,%s\n", $2, $3 }'
+
+# the stack of the benchmark build (same AVR core and code, see bench.h)
+# must fit into the RAM of the target with the margin to spare
+stack=$(echo "$out" | awk -F, '$1 == "stack" { print $2 }')
+if [ -z "$stack" ]; then
+    echo "$0: no stack high-water mark from $bench_elf" >&2
+    exit 1
+fi
+headroom=$((ram_free - stack))
+echo "size,$mmcu,stack,$stack"
+echo "size,$mmcu,ram_headroom,$headroom"
+if [ "$headroom" -lt "$margin" ]; then
+    echo "$0: $headroom bytes of RAM left beyond the stack, less than the margin of $margin" >&2
+    exit 1
+fi
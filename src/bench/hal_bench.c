@@ -0,0 +1,331 @@
+/**
+ * @file hal_bench.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Hardware abstraction layer for the benchmark on a simulated
+ * ATmega1284P (see bench.h)
+ */
+#include "hal.h"
+#include "bench.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+
+// PWM periods are derived from the update timer (ticks per period, rounded)
+#define PWM_TICKS ((CLOCK_PWM_PERIOD * CLOCK_PWM_DIV / (F_CPU / HAL_TICK_HZ / 2) + 1) / 2)
+
+// USART0 in double speed mode
+#define UBRR ((F_CPU / 8 + CLOCK_BAUD / 2) / CLOCK_BAUD - 1)
+
+// pattern of the RAM not used yet (see hal_ram_usage())
+#define RAM_PAINT 0xc5
+
+// boundaries of the sections in RAM, from the linker script
+extern uint8_t __data_start, __data_end, __bss_start, _end, __stack;
+
+static volatile uint16_t cycles_hi; // overflows of timer 1
+static volatile uint16_t ticks;
+static uint8_t pwm_ticks;
+
+static uint32_t frame;      // reading of the simulated MAX31855K (all devices)
+static uint8_t spi_pos;     // bytes of the frame transferred
+static uint8_t spi_pending, spi_active;
+static uint8_t button, bake;
+
+void bench_hw_init()
+{
+    TCCR1A = 0;
+    TCCR1B = 1; // normal mode, no prescaler
+    TIMSK1 = 1; // overflow interrupt
+}
+
+uint32_t bench_now()
+{
+    uint16_t hi, lo;
+
+    HAL_ATOMIC {
+        lo = TCNT1;
+        hi = cycles_hi;
+        if ((TIFR1 & 1) && lo < 0x8000)
+            hi++; // overflow not handled yet
+    }
+    return ((uint32_t)hi << 16) | lo;
+}
+
+uint16_t bench_ticks()
+{
+    uint16_t t;
+    HAL_ATOMIC {
+        t = ticks;
+    }
+    return t;
+}
+
+void bench_set_temp(int hot, int cold, uint8_t fault)
+{
+    frame = ((uint32_t)(hot & 0x3fff) << 18) | ((uint16_t)(cold & 0xfff) << 4);
+    if (fault)
+        frame |= 0x10001; // fault bit and open circuit
+}
+
+void bench_set_switch(uint8_t on)
+{
+    bake = on;
+}
+
+void bench_set_button(uint8_t down)
+{
+    if (down && !button) {
+        uint32_t t0;
+        HAL_ATOMIC {
+            t0 = bench_now();
+            hal_on_button();
+            bench_add(BENCH_ISR_BUTTON, bench_now() - t0);
+        }
+    }
+    button = down;
+}
+
+void bench_send(const char *str)
+{
+    for (; *str != 0; str++)
+        HAL_ATOMIC {
+            uint32_t t0 = bench_now();
+            hal_on_uart_rx(*str);
+            bench_add(BENCH_ISR_RX, bench_now() - t0);
+        }
+}
+
+void hal_irq_enable()
+{
+    sei();
+}
+
+void hal_irq_disable()
+{
+    cli();
+}
+
+void hal_sleep()
+{
+    // the interrupt that wakes the CPU runs before sleep_cpu() returns, its
+    // cycles count as sleeping (also the overflows of the cycle counter,
+    // which wake the CPU every 65536 cycles)
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    uint32_t t0 = bench_now();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    bench_sleep(bench_now() - t0);
+}
+
+void hal_power_init()
+{
+}
+
+/**
+ * @brief Fill the RAM between the variables and the top of the stack with
+ * @c RAM_PAINT , like on the target (see hal_avr.c).
+ */
+void hal_ram_paint() __attribute__((naked, used, section(".init3")));
+void hal_ram_paint()
+{
+    __asm__ volatile (
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, %0\n"
+        "    ldi r25, hi8(__stack + 1)\n"
+        "1:  st Z+, r24\n"
+        "    cpi r30, lo8(__stack + 1)\n"
+        "    cpc r31, r25\n"
+        "    brne 1b\n"
+        :: "M" (RAM_PAINT));
+}
+
+void hal_ram_usage(hal_ram_t *ram)
+{
+    const uint8_t *p = &_end;
+
+    // the bytes above the stack pointer are in use now
+    while (p <= (const uint8_t *)(uintptr_t)SP && *p == RAM_PAINT)
+        p++;
+
+    ram->data = &__data_end - &__data_start;
+    ram->bss = &_end - &__bss_start;
+    ram->free = p - &_end;
+    ram->stack = &__stack + 1 - p;
+}
+
+void hal_pwm_init()
+{
+    DDRB |= 2; // heater outputs (not driven, the duty cycle is not simulated)
+}
+
+void hal_pwm_power(uint8_t on)
+{
+}
+
+void hal_pwm_set(uint8_t ch, uint16_t duty)
+{
+}
+
+void hal_tick_init()
+{
+    OCR3A = CLOCK_TICK_PERIOD(HAL_TICK_HZ) / BENCH_SPEEDUP - 1;
+    TCCR3A = 0;
+    TCCR3B = 0x0b; // CTC mode, prescaler 64
+    TIMSK3 = 2;    // output compare A interrupt
+}
+
+void hal_tick_restart()
+{
+    TCNT3 = 0;
+    TIFR3 = 2; // clear a pending interrupt
+}
+
+void hal_button_init()
+{
+}
+
+uint8_t hal_button_down()
+{
+    return button;
+}
+
+uint8_t hal_switch_bake()
+{
+    return bake;
+}
+
+uint8_t hal_jumper()
+{
+    return 0;
+}
+
+void hal_eeprom_read(uint16_t addr, void *buf, uint16_t len)
+{
+    eeprom_read_block(buf, (const void *)(uintptr_t)addr, len);
+}
+
+void hal_eeprom_write(uint16_t addr, const void *buf, uint16_t len)
+{
+    eeprom_update_block(buf, (void *)(uintptr_t)addr, len);
+}
+
+void hal_led_init()
+{
+    DDRB |= 1;
+    PORTB &= ~1;
+}
+
+void hal_led_set(uint8_t on)
+{
+    if (on)
+        PORTB |= 1;
+    else
+        PORTB &= ~1;
+}
+
+void hal_led_toggle()
+{
+    PINB = 1;
+}
+
+void hal_uart_init()
+{
+    UBRR0 = UBRR;
+    UCSR0A = 2;    // double speed
+    UCSR0C = 6;    // async, no parity, 8 bit data, 1 stop bit
+    UCSR0B = 8;    // enable transmitter (the input comes from bench_send())
+}
+
+FILE *hal_uart_stream(int (*put)(char, FILE *))
+{
+    static FILE stream;
+    fdev_setup_stream(&stream, put, NULL, _FDEV_SETUP_WRITE);
+    return &stream;
+}
+
+uint8_t hal_uart_tx_ready()
+{
+    return UCSR0A & 0x20; // data register empty flag
+}
+
+void hal_uart_tx(char c)
+{
+    UDR0 = c;
+}
+
+void hal_uart_tx_irq(uint8_t on)
+{
+    UCSR0B = on ? 0x28 : 8; // DRE interrupt, transmitter
+}
+
+void hal_spi_init()
+{
+}
+
+void hal_spi_select(uint8_t dev, uint8_t on)
+{
+    spi_pos = 0;
+}
+
+void hal_spi_write(uint8_t data)
+{
+    // the transfer completes at once; the interrupt routine is called here
+    // unless it is running already (it starts the next transfer itself)
+    spi_pending = 1;
+    if (spi_active)
+        return;
+
+    spi_active = 1;
+    while (spi_pending) {
+        spi_pending = 0;
+        HAL_ATOMIC {
+            uint16_t t0 = TCNT1;
+            hal_on_spi(frame >> (24 - 8 * spi_pos++));
+            bench_add(BENCH_ISR_SPI, (uint16_t)(TCNT1 - t0));
+        }
+    }
+    spi_active = 0;
+}
+
+/**
+ * @brief Cycle counter overflow.
+ */
+ISR(TIMER1_OVF_vect)
+{
+    cycles_hi++;
+}
+
+/**
+ * @brief Update timer interrupt routine, also starts the PWM periods.
+ */
+ISR(TIMER3_COMPA_vect)
+{
+    uint16_t t0 = TCNT1;
+    hal_on_tick();
+    bench_add(BENCH_ISR_TICK, (uint16_t)(TCNT1 - t0));
+    ticks++;
+
+    if (++pwm_ticks >= PWM_TICKS) {
+        pwm_ticks = 0;
+        t0 = TCNT1;
+        hal_on_pwm_period();
+        bench_add(BENCH_ISR_PWM, (uint16_t)(TCNT1 - t0));
+    }
+}
+
+/**
+ * @brief USART data register empty interrupt routine.
+ */
+ISR(USART0_UDRE_vect)
+{
+    uint16_t t0 = TCNT1;
+    hal_on_uart_tx();
+    bench_add(BENCH_ISR_UART, (uint16_t)(TCNT1 - t0));
+}
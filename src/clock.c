@@ -0,0 +1,41 @@
+/**
+ * @file clock.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief System clock
+ */
+#include "clock.h"
+#include "hal.h"
+
+#include <avr/io.h>
+#include <avr/xmega.h>
+
+_Static_assert(CLOCK_PER(HAL_PWM_PERIOD) >= 1 && CLOCK_PER(HAL_PWM_PERIOD) <= 0xffff,
+               "PWM period exceeds 16 bits");
+_Static_assert(CLOCK_PER(CLOCK_TICK_PERIOD(HAL_TICK_HZ)) <= 0xffff, "tick period exceeds 16 bits");
+_Static_assert((CLOCK_PER(CLOCK_TICK_PERIOD(HAL_TICK_HZ)) + 1) * CLOCK_TICK_DIV * HAL_TICK_HZ == F_CPU,
+               "tick rate is not HAL_TICK_HZ");
+_Static_assert(CLOCK_BSEL < 4096, "baud rate too low for F_CPU");
+_Static_assert(CLOCK_BAUD_ACTUAL >= CLOCK_BAUD * 99 && CLOCK_BAUD_ACTUAL <= CLOCK_BAUD * 101,
+               "baud rate error exceeds 1 %");
+
+void clock_init()
+{
+#if F_CPU == 32000000UL
+    // enable the 32 MHz and the 32.768 kHz oscillator and wait until stable
+    OSC.CTRL |= OSC_RC32MEN_bm | OSC_RC32KEN_bm;
+    while ((OSC.STATUS & (OSC_RC32MRDY_bm | OSC_RC32KRDY_bm)) != (OSC_RC32MRDY_bm | OSC_RC32KRDY_bm));
+
+    // calibrate the 32 MHz oscillator against the 32.768 kHz oscillator
+    // (DFLL, default reference)
+    DFLLRC32M.CTRL = DFLL_ENABLE_bm;
+
+    // system clock: 32 MHz oscillator; CLK.CTRL is protected, the write
+    // has to follow the unlock within 4 cycles, which only the inline
+    // assembly of _PROTECTED_WRITE guarantees at any optimization level
+    _PROTECTED_WRITE(CLK.CTRL, CLK_SCLKSEL_RC32M_gc);
+
+    OSC.CTRL &= ~OSC_RC2MEN_bm; // disable the 2 MHz oscillator
+#endif
+}
@@ -0,0 +1,119 @@
+/**
+ * @file clock.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief System clock and derived timing constants
+ *
+ * All prescalers, timer periods and baud rate settings are calculated at
+ * compile time from @c F_CPU (host/test-clock.c checks them). Supported are the 2 MHz oscillator that is
+ * active after reset and the 32 MHz oscillator (default), which is
+ * calibrated against the internal 32.768 kHz oscillator.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+/**
+ * @brief CPU and peripheral clock in Hz (2 or 32 MHz).
+ */
+#ifndef F_CPU
+#define F_CPU 32000000UL
+#endif
+
+#if F_CPU != 2000000UL && F_CPU != 32000000UL
+#error "F_CPU must be 2 MHz or 32 MHz"
+#endif
+
+/**
+ * @brief Baud rate of the serial line.
+ *
+ * The serial LCD expects 9600 baud; the text and telemetry output use a
+ * faster rate.
+ */
+#ifndef CLOCK_BAUD
+#ifdef USE_LCD_DISP
+#define CLOCK_BAUD 9600UL
+#else
+#define CLOCK_BAUD 115200UL
+#endif
+#endif
+
+/**
+ * @brief Value of the PER register of a timer for a period of @p counts
+ * timer counts (the timer counts from 0 to PER).
+ */
+#define CLOCK_PER(counts) ((counts) - 1)
+
+// Heater PWM (TCE0): the fastest of the prescalers 64, 256 and 1024 for
+// which the default period of 1.966 s (12288 / 6250 s) fits into 16 bits.
+#define CLOCK_PWM_COUNTS(div) (F_CPU / 6250 * 12288 / (div))
+#if CLOCK_PER(CLOCK_PWM_COUNTS(64)) <= 0xffff
+#define CLOCK_PWM_DIV   64
+#define CLOCK_PWM_CTRLA 5
+#elif CLOCK_PER(CLOCK_PWM_COUNTS(256)) <= 0xffff
+#define CLOCK_PWM_DIV   256
+#define CLOCK_PWM_CTRLA 6
+#else
+#define CLOCK_PWM_DIV   1024
+#define CLOCK_PWM_CTRLA 7
+#endif
+#define CLOCK_PWM_PERIOD CLOCK_PWM_COUNTS(CLOCK_PWM_DIV)
+
+// Update timer (TCC0): prescaler 64, period for HAL_TICK_HZ (see hal.h) in
+// timer counts.
+#define CLOCK_TICK_DIV   64
+#define CLOCK_TICK_CTRLA 5
+#define CLOCK_TICK_PERIOD(hz) (F_CPU / CLOCK_TICK_DIV / (hz))
+
+// SPI (MAX31855K, at most 5 MHz): the smallest possible prescaler.
+#define CLOCK_SPI_MAX 5000000UL
+#if F_CPU / 2 <= CLOCK_SPI_MAX
+#define CLOCK_SPI_DIV  2
+#define CLOCK_SPI_CTRL 0x80 // CLK2X, clk / 4
+#elif F_CPU / 4 <= CLOCK_SPI_MAX
+#define CLOCK_SPI_DIV  4
+#define CLOCK_SPI_CTRL 0x00 // clk / 4
+#elif F_CPU / 8 <= CLOCK_SPI_MAX
+#define CLOCK_SPI_DIV  8
+#define CLOCK_SPI_CTRL 0x81 // CLK2X, clk / 16
+#else
+#define CLOCK_SPI_DIV  16
+#define CLOCK_SPI_CTRL 0x01 // clk / 16
+#endif
+
+// USART: BSEL for BSCALE = -n (baud = F_CPU / (16 * (BSEL / 2^n + 1))).
+// The most negative BSCALE (finest resolution) with BSEL < 4096 is used.
+#define CLOCK_BSEL_N(n) ((((F_CPU * 1ULL) << (n)) - ((16ULL * CLOCK_BAUD) << (n)) + 8 * CLOCK_BAUD) / (16 * CLOCK_BAUD))
+#if CLOCK_BSEL_N(7) < 4096
+#define CLOCK_BSCALE_N 7
+#elif CLOCK_BSEL_N(6) < 4096
+#define CLOCK_BSCALE_N 6
+#elif CLOCK_BSEL_N(5) < 4096
+#define CLOCK_BSCALE_N 5
+#elif CLOCK_BSEL_N(4) < 4096
+#define CLOCK_BSCALE_N 4
+#elif CLOCK_BSEL_N(3) < 4096
+#define CLOCK_BSCALE_N 3
+#elif CLOCK_BSEL_N(2) < 4096
+#define CLOCK_BSCALE_N 2
+#elif CLOCK_BSEL_N(1) < 4096
+#define CLOCK_BSCALE_N 1
+#else
+#define CLOCK_BSCALE_N 0
+#endif
+#define CLOCK_BSEL ((uint16_t)CLOCK_BSEL_N(CLOCK_BSCALE_N))
+#define CLOCK_BAUDCTRLA (CLOCK_BSEL & 0xff)
+#define CLOCK_BAUDCTRLB ((((-CLOCK_BSCALE_N) & 0xf) << 4) | (CLOCK_BSEL >> 8))
+
+/**
+ * @brief Actual baud rate (in 1/100 baud) with the chosen BSEL and BSCALE.
+ */
+#define CLOCK_BAUD_ACTUAL ((F_CPU * 100ULL << CLOCK_BSCALE_N) / (16ULL * (CLOCK_BSEL + (1UL << CLOCK_BSCALE_N))))
+
+/**
+ * @brief Switch the system clock to @c F_CPU .
+ */
+void clock_init();
+
+#endif // CLOCK_H
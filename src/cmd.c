@@ -0,0 +1,471 @@
+/**
+ * @file cmd.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Commands received over the serial line
+ */
+#include "cmd.h"
+#include "fmt.h"
+#include "hal.h"
+#include "oven.h"
+#include "profile.h"
+#include "tune.h"
+#include "uart.h"
+
+#include <string.h>
+
+#define MAX_WORDS 10 // the command and up to 9 values (limits)
+
+#define BAKE_MIN  40  // bake temperature range (degC)
+#define BAKE_MAX  200
+#define BAKE_TIME_MAX 540 // longest bake duration (min, the bake time is counted in an int)
+
+#define TUNE_MIN  60  // auto-tune temperature range (degC, it ends below 50 degC)
+#define TUNE_MAX  200
+
+#if CMD_LINE_MAX + 2 > UART_RX_BUF_SIZE - 1
+#error "a command line with CR and LF must fit into the receive buffer"
+#endif
+
+static char line[CMD_LINE_MAX + 1];
+static uint8_t len;
+static uint8_t overlong;  // the line is too long, discard it up to its end
+static uint8_t lost;      // characters of the line were lost, discard it
+static profile_t *upload; // profile being uploaded (NULL: none)
+#ifndef USE_TELEMETRY
+static uint8_t redraw;    // replies have been sent since the last redraw
+#endif
+
+typedef struct {
+    char name[8];
+    uint8_t min_words, max_words; // including the command
+    void (*run)(char **w, uint8_t n);
+} cmd_t;
+
+#ifndef USE_TELEMETRY
+/**
+ * @brief Send the reply written since @c uart_tx_begin() , or drop it if
+ * it does not fit into the transmit buffer.
+ */
+static void reply_end()
+{
+    if (uart_tx_end())
+        redraw = 1;
+}
+
+/**
+ * @brief Send @p key (in the program memory) followed by the number
+ * @p val .
+ */
+static void put_uint(const char *key, uint32_t val)
+{
+    char num[11];
+    uart_puts_P(key);
+    fmt_uint(num, val, 0, ' ');
+    uart_puts(num);
+}
+
+/**
+ * @brief Send @p key (in the program memory) followed by the number
+ * @p val .
+ */
+static void put_int(const char *key, int val)
+{
+    char num[7];
+    uart_puts_P(key);
+    fmt_int(num, val, 0, ' ');
+    uart_puts(num);
+}
+
+/**
+ * @brief Send @p key (in the program memory) followed by the temperature
+ * @p temp (multiplied by 4).
+ */
+static void put_temp(const char *key, int temp)
+{
+    char num[10];
+    uart_puts_P(key);
+    fmt_temp4(num, temp, 0);
+    uart_puts(num);
+}
+#endif
+
+/**
+ * @brief Answer a successful command.
+ */
+static void ok()
+{
+#ifndef USE_TELEMETRY
+    uart_tx_begin();
+    uart_puts_P(PSTR("ok\r\n"));
+    reply_end();
+#endif
+}
+
+/**
+ * @brief Answer a failed command with the reason @p msg (in the program
+ * memory).
+ */
+static void error(const char *msg)
+{
+#ifndef USE_TELEMETRY
+    uart_tx_begin();
+    uart_puts_P(PSTR("error: "));
+    uart_puts_P(msg);
+    uart_puts_P(PSTR("\r\n"));
+    reply_end();
+#endif
+}
+
+/**
+ * @brief Parse the word @p w as a decimal number within [ @p min , @p max ].
+ *
+ * The function returns 1 and stores the number in @p val if the word is
+ * valid, and 0 otherwise.
+ */
+static uint8_t number(const char *w, int32_t min, int32_t max, int32_t *val)
+{
+    uint8_t neg = 0, digits = 0;
+    int32_t v = 0;
+
+    if (*w == '-') {
+        neg = 1;
+        w++;
+    }
+    for (; *w != 0; w++) {
+        if (*w < '0' || *w > '9' || ++digits > 6)
+            return 0;
+        v = v * 10 + (*w - '0');
+    }
+    if (digits == 0)
+        return 0;
+    if (neg)
+        v = -v;
+    if (v < min || v > max)
+        return 0;
+
+    *val = v;
+    return 1;
+}
+
+static void run_start(char **w, uint8_t n)
+{
+    int mode = w[0][0] == 'r' ? OVEN_MODE_REFLOW : w[0][0] == 'b' ? OVEN_MODE_BAKE : OVEN_MODE_TUNE;
+    int32_t v;
+
+    if (oven_mode() != OVEN_MODE_IDLE) {
+        error(PSTR("not idle"));
+        return;
+    }
+    if (n > 1) { // tune DEGC
+        if (!number(w[1], TUNE_MIN, TUNE_MAX, &v)) {
+            error(PSTR("invalid temperature"));
+            return;
+        }
+        tune_set_temp(v * 4);
+    }
+
+    if (!oven_start(mode))
+        error(mode == OVEN_MODE_REFLOW ? PSTR("invalid profile") : PSTR("busy"));
+    else
+        ok();
+}
+
+static void run_stop(char **w, uint8_t n)
+{
+    if (oven_abort())
+        ok();
+    else
+        error(PSTR("not running"));
+}
+
+static void run_status(char **w, uint8_t n)
+{
+#ifndef USE_TELEMETRY
+    oven_status_t st;
+    oven_status(&st);
+
+    uart_tx_begin();
+    put_int(PSTR("ok mode="), st.mode);
+    put_uint(PSTR(" phase="), st.phase);
+    put_uint(PSTR(" profile="), st.profile);
+    put_uint(PSTR(" flags="), st.flags);
+    put_temp(PSTR(" temp="), st.temp);
+    put_temp(PSTR(" sp="), st.setpoint);
+    put_int(PSTR(" out="), st.out);
+    put_uint(PSTR(" time="), st.time);
+    put_int(PSTR(" bake_temp="), st.bake_temp >> 2);
+    put_uint(PSTR(" bake_time="), st.bake_duration / 60);
+    uart_puts_P(PSTR("\r\n"));
+    reply_end();
+#endif
+}
+
+static void run_mem(char **w, uint8_t n)
+{
+#ifndef USE_TELEMETRY
+    hal_ram_t ram;
+    hal_ram_usage(&ram);
+
+    uart_tx_begin();
+    put_uint(PSTR("ok data="), ram.data);
+    put_uint(PSTR(" bss="), ram.bss);
+    put_uint(PSTR(" stack="), ram.stack);
+    put_uint(PSTR(" free="), ram.free);
+    uart_puts_P(PSTR("\r\n"));
+    reply_end();
+#endif
+}
+
+static void run_set(char **w, uint8_t n)
+{
+    oven_status_t st;
+    int32_t v;
+
+    oven_status(&st);
+    if (strcmp_P(w[1], PSTR("temp")) == 0 && number(w[2], BAKE_MIN, BAKE_MAX, &v))
+        oven_set_bake(v * 4, st.bake_duration);
+    else if (strcmp_P(w[1], PSTR("time")) == 0 && number(w[2], 0, BAKE_TIME_MAX, &v))
+        oven_set_bake(st.bake_temp, v * 60);
+    else {
+        error(PSTR("invalid setting"));
+        return;
+    }
+    ok();
+}
+
+static void run_profile(char **w, uint8_t n)
+{
+    int32_t v;
+
+    if (n == 1) {
+#ifndef USE_TELEMETRY
+        char name[sizeof(upload->name) + 1];
+        oven_status_t st;
+
+        oven_status(&st);
+        profile_name(name, st.profile);
+        uart_tx_begin();
+        put_uint(PSTR("ok profile="), st.profile);
+        uart_puts_P(PSTR(" name="));
+        uart_puts(name);
+        if (oven_profile() == OVEN_PROFILE_JUMPER)
+            uart_puts_P(PSTR(" auto"));
+        uart_puts_P(PSTR("\r\n"));
+        reply_end();
+#endif
+        return;
+    }
+
+    if (strcmp_P(w[1], PSTR("auto")) == 0)
+        v = OVEN_PROFILE_JUMPER;
+    else if (!number(w[1], 0, PROFILE_COUNT - 1, &v)) {
+        error(PSTR("invalid profile"));
+        return;
+    }
+    if (oven_select_profile(v))
+        ok();
+    else
+        error(PSTR("invalid profile"));
+}
+
+static void run_upload(char **w, uint8_t n)
+{
+    int32_t liquidus;
+    const char *c;
+
+    for (c = w[1]; PROFILE_NAME_CHAR(*c); c++);
+
+    if (oven_mode() != OVEN_MODE_IDLE)
+        error(PSTR("not idle"));
+    else if (*c != 0)
+        error(PSTR("invalid name"));
+    else if (strlen(w[1]) >= sizeof(upload->name))
+        error(PSTR("name too long"));
+    else if (!number(w[2], 0, PROFILE_TEMP_MAX / 4, &liquidus))
+        error(PSTR("invalid liquidus"));
+    else {
+        upload = profile_user_edit();
+        strcpy(upload->name, w[1]);
+        upload->liquidus = liquidus * 4;
+        ok();
+    }
+}
+
+static void run_limits(char **w, uint8_t n)
+{
+    static const int32_t max[9] = { 255, 255, 65535, 65535, 65535, 65535,
+                                    PROFILE_TEMP_MAX / 4, PROFILE_TEMP_MAX / 4, 65535 };
+    int32_t v[9];
+    uint8_t i;
+
+    if (upload == NULL) {
+        error(PSTR("no upload"));
+        return;
+    }
+    for (i = 0; i < 9; i++)
+        if (!number(w[i + 1], 0, max[i], &v[i])) {
+            error(PSTR("invalid limit"));
+            return;
+        }
+
+    profile_limits_t *lim = &upload->limits;
+    lim->ramp_up = v[0];
+    lim->ramp_down = v[1];
+    lim->soak_min = v[2];
+    lim->soak_max = v[3];
+    lim->tal_min = v[4];
+    lim->tal_max = v[5];
+    lim->peak_min = v[6] * 4;
+    lim->peak_max = v[7] * 4;
+    lim->near_peak_max = v[8];
+    ok();
+}
+
+static void run_seg(char **w, uint8_t n)
+{
+    static const int32_t max[7] = { SEG_COOL, SEG_OUT_PID, SEG_EXIT_PREDICT, 255,
+                                    PROFILE_TEMP_MAX / 4, 65535, 255 };
+    int32_t v[7];
+    uint8_t i;
+
+    if (upload == NULL) {
+        error(PSTR("no upload"));
+        return;
+    }
+    if (upload->num_segs >= PROFILE_MAX_SEGS) {
+        error(PSTR("too many segments"));
+        return;
+    }
+    for (i = 0; i < 7; i++)
+        if (!number(w[i + 1], 0, max[i], &v[i])) {
+            error(PSTR("invalid segment"));
+            return;
+        }
+
+    profile_seg_t *s = &upload->segs[upload->num_segs++];
+    s->kind = v[0];
+    s->out = v[1];
+    s->exit = v[2];
+    s->flags = v[3];
+    s->temp = v[4] * 4;
+    s->time = v[5];
+    s->rate = v[6];
+    ok();
+}
+
+static void run_end(char **w, uint8_t n)
+{
+    if (upload == NULL) {
+        error(PSTR("no upload"));
+        return;
+    }
+    upload = NULL;
+    if (profile_user_done())
+        ok();
+    else
+        error(PSTR("invalid profile"));
+}
+
+static const cmd_t cmds[] PROGMEM = {
+    { "reflow",  1, 1,  run_start },
+    { "bake",    1, 1,  run_start },
+    { "tune",    1, 2,  run_start },
+    { "stop",    1, 1,  run_stop },
+    { "status",  1, 1,  run_status },
+    { "mem",     1, 1,  run_mem },
+    { "set",     3, 3,  run_set },
+    { "profile", 1, 2,  run_profile },
+    { "upload",  3, 3,  run_upload },
+    { "limits",  10, 10, run_limits },
+    { "seg",     8, 8,  run_seg },
+    { "end",     1, 1,  run_end },
+};
+
+/**
+ * @brief Split the line into words and execute its command.
+ */
+static void execute()
+{
+    char *w[MAX_WORDS];
+    uint8_t n = 0, i;
+    char *p = line;
+    cmd_t cmd;
+
+    for (;;) {
+        while (*p == ' ' || *p == '\t')
+            *p++ = 0;
+        if (*p == 0)
+            break;
+        if (n == MAX_WORDS) {
+            error(PSTR("too many words"));
+            return;
+        }
+        w[n++] = p;
+        while (*p != 0 && *p != ' ' && *p != '\t')
+            p++;
+    }
+    if (n == 0)
+        return;
+
+    for (i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+        memcpy_P(&cmd, &cmds[i], sizeof(cmd));
+        if (strcmp(w[0], cmd.name) == 0) {
+            if (n < cmd.min_words || n > cmd.max_words)
+                error(PSTR("wrong number of values"));
+            else
+                cmd.run(w, n);
+            return;
+        }
+    }
+    error(PSTR("unknown command"));
+}
+
+uint8_t cmd_feed(char c)
+{
+    if (c == '\r' || c == '\n') {
+        uint8_t done = 1;
+        if (lost)
+            error(PSTR("input lost"));
+        else if (overlong)
+            error(PSTR("line too long"));
+        else if (len > 0) {
+            line[len] = 0;
+            execute();
+        } else
+            done = 0;
+        len = 0;
+        overlong = 0;
+        lost = 0;
+        return done;
+    }
+
+    if (c == 0) // see uart_getc()
+        lost = 1;
+    else if (len < CMD_LINE_MAX)
+        line[len++] = c;
+    else
+        overlong = 1;
+    return 0;
+}
+
+void cmd_task()
+{
+    uint8_t lines = 0;
+    uint16_t n;
+    int c = 0;
+
+    // at most one buffer full and CMD_RUN_LINES lines, so that a flood
+    // cannot hold up the other tasks
+    for (n = 0; n < UART_RX_BUF_SIZE && lines < CMD_RUN_LINES && (c = uart_getc()) >= 0; n++)
+        lines += cmd_feed(c);
+
+#ifndef USE_TELEMETRY
+    // the LCD shows the replies as well, redraw it once they are over
+    if (redraw && c < 0) {
+        redraw = 0;
+        oven_redraw();
+    }
+#endif
+}
@@ -0,0 +1,83 @@
+/**
+ * @file cmd.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Commands received over the serial line
+ *
+ * A command is a line of text (terminated by CR or LF, at most
+ * @c CMD_LINE_MAX characters) of words separated by spaces:
+ *
+ *     reflow             start a reflow with the selected profile
+ *     bake               start baking
+ *     tune [DEGC]        start the auto-tune (at DEGC, 60 to 200 degC, for
+ *                        this and the following ones; default TUNE_TEMP)
+ *     stop               abort the process: heater off, cool down
+ *     status             report the state of the oven
+ *     mem                report the usage of the RAM in bytes (variables,
+ *                        high-water mark of the stack, never used)
+ *     set temp DEGC      set the bake temperature (40 to 200 degC)
+ *     set time MIN       set the bake duration (0: until stopped)
+ *     profile [N|auto]   select profile N (see profile.h) for the
+ *                        following reflows, or the one of the jumper
+ *     upload NAME LIQ    start uploading profile 2 (liquidus in degC, the
+ *                        name of up to 9 printable characters except '|')
+ *     limits RU RD SOAKMIN SOAKMAX TALMIN TALMAX PEAKMIN PEAKMAX NEARMAX
+ *                        limits of the profile being uploaded (rates in
+ *                        0.1 degC/s, times in s, temperatures in degC)
+ *     seg KIND OUT EXIT FLAGS DEGC TIME RATE
+ *                        append a segment to the profile being uploaded
+ *                        (SEG_* values of profile.h, time in s, rate in
+ *                        0.1 degC/s)
+ *     end                check the uploaded profile and make it usable
+ *
+ * Each command is answered with a line starting with "ok" or "error:",
+ * except in the telemetry build (see telem.h), where the records show the
+ * effect. Replies never wait for the serial line: one that does not fit
+ * into the transmit buffer is dropped (see @c uart_tx_begin() ).
+ *
+ * The UART interrupt only stores the received characters (see uart.h);
+ * @c cmd_task() takes them from the buffer outside of interrupt context.
+ * Each character takes constant time, a complete line at most
+ * @c CMD_LINE_MAX steps to split and a command constant time, and a run
+ * handles at most @c UART_RX_BUF_SIZE characters and @c CMD_RUN_LINES
+ * lines, so the time taken from the control loop is bounded. In the LCD
+ * build the display is redrawn once the received lines are handled.
+ *
+ * A line and its line end fit into the receive buffer, so a host that
+ * waits for the reply before sending the next line never overruns it.
+ * A line in which received characters were lost (or that contains a 0)
+ * is answered with "error: input lost"; the telemetry records flag the
+ * loss instead (@c TELEM_F_RX_LOST ).
+ */
+
+#ifndef CMD_H
+#define CMD_H
+
+#include <stdint.h>
+
+// longest command line (characters without the line end)
+#ifndef CMD_LINE_MAX
+#define CMD_LINE_MAX 61
+#endif
+
+// lines handled per run of cmd_task() (the task runs once per tick)
+#ifndef CMD_RUN_LINES
+#define CMD_RUN_LINES 1
+#endif
+
+/**
+ * @brief Handle the characters received since the last run, up to
+ * @c CMD_RUN_LINES lines; the rest stays in the receive buffer.
+ */
+void cmd_task();
+
+/**
+ * @brief Handle the received character @p c .
+ *
+ * A line end executes the command of the line. The function returns 1 if
+ * it ended a line that is not empty, and 0 otherwise.
+ */
+uint8_t cmd_feed(char c);
+
+#endif // CMD_H
@@ -0,0 +1,66 @@
+/**
+ * @file coast.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Predict the overshoot after switching the heater off
+ */
+#include "coast.h"
+#include "nvm.h"
+
+#define COAST_VERSION 1
+
+#define COAST_MAX       600     // upper limit of the coast gain (60 s)
+#define MIN_RATE        20      // min. rate for a measurement (0.2 degC/s)
+#define PEAK_DROP       (2 * 4) // drop that marks the peak as passed (2 degC)
+
+uint16_t coast_gain = COAST_GAIN;
+
+static uint8_t measuring;
+static int cut_temp, cut_rate, peak;
+
+void coast_init()
+{
+    uint16_t gain;
+
+    if (!nvm_load(NVM_COAST, COAST_VERSION, &gain, sizeof(gain)))
+        gain = COAST_GAIN;
+    coast_gain = gain;
+    measuring = 0;
+}
+
+int coast_predict(int temp, int rate, uint16_t dt)
+{
+    if (rate <= 0)
+        return temp;
+
+    // rate (0.01 degC/s) * lag (0.1 s) / 250 = overshoot (degC * 4)
+    int32_t lag = coast_gain + (dt + 50) / 100 / 2;
+    return temp + (int)(((int32_t)rate * lag + 125) / 250);
+}
+
+void coast_cut(int temp, int rate)
+{
+    cut_temp = peak = temp;
+    cut_rate = rate;
+    measuring = rate >= MIN_RATE;
+}
+
+void coast_update(int temp)
+{
+    if (!measuring)
+        return;
+
+    if (temp > peak)
+        peak = temp;
+    if (temp > peak - PEAK_DROP)
+        return;
+
+    // gain that would have predicted this overshoot, averaged with the
+    // previous one
+    int32_t gain = ((int32_t)(peak - cut_temp) * 250 + cut_rate / 2) / cut_rate;
+    gain = (gain + coast_gain + 1) / 2;
+    coast_gain = gain > COAST_MAX ? COAST_MAX : gain;
+    nvm_save(NVM_COAST, COAST_VERSION, &coast_gain, sizeof(coast_gain));
+    measuring = 0;
+}
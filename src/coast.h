@@ -0,0 +1,67 @@
+/**
+ * @file coast.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Predict the overshoot after switching the heater off
+ *
+ * When the heater is switched off, the oven temperature keeps rising for a
+ * while, since the heating elements are hotter than the air and the
+ * thermocouple lags behind. The overshoot is modelled as the rise rate at
+ * the moment the heater is switched off times a lag time (the coast
+ * gain). The heater is switched off as soon as the predicted peak reaches
+ * the target temperature.
+ *
+ * After each reflow, the coast gain is re-estimated from the measured
+ * overshoot and the rate at the cut-off, averaged with the previous value
+ * and stored in the EEPROM. Hence it adapts to the oven and to the thermal
+ * mass of the boards within a few runs.
+ */
+
+#ifndef COAST_H
+#define COAST_H
+
+#include <stdint.h>
+
+// initial coast gain (0.1 s), used until a reflow has been measured
+#ifndef COAST_GAIN
+#define COAST_GAIN  45
+#endif
+
+/**
+ * @brief Current coast gain (0.1 s).
+ */
+extern uint16_t coast_gain;
+
+/**
+ * @brief Load the coast gain from the EEPROM.
+ *
+ * The default @c COAST_GAIN is used if no valid gain has been stored.
+ */
+void coast_init();
+
+/**
+ * @brief Predict the peak temperature if the heater is switched off now.
+ *
+ * @p temp is the temperature within the oven (multiplied by 4), @p rate
+ * its rise rate (0.01 degC/s, see @c est_rate() ). The heater can only be
+ * switched off at the next update, @p dt ms later, hence half of that time
+ * is added to the lag.
+ */
+int coast_predict(int temp, int rate, uint16_t dt);
+
+/**
+ * @brief Start measuring the overshoot after the heater has been switched
+ * off at temperature @p temp with rise rate @p rate .
+ */
+void coast_cut(int temp, int rate);
+
+/**
+ * @brief Update the overshoot measurement with a new reading.
+ *
+ * Once the temperature has dropped 2 degC below the peak, the coast gain
+ * is updated and stored in the EEPROM (at most once per cut-off).
+ */
+void coast_update(int temp);
+
+#endif // COAST_H
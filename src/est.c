@@ -0,0 +1,47 @@
+/**
+ * @file est.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Filtered oven temperature and its rate of change
+ */
+#include "est.h"
+
+#define FRAC 8 // fractional bits of the state (besides the ones of the readings)
+
+static uint8_t valid;
+static int32_t x; // temperature (degC * 4 << FRAC)
+static int32_t v; // rate (degC * 4 << FRAC per reading)
+
+void est_reset()
+{
+    valid = 0;
+}
+
+void est_update(int temp)
+{
+    int32_t z = (int32_t)temp << FRAC;
+
+    if (!valid) {
+        x = z;
+        v = 0;
+        valid = 1;
+        return;
+    }
+
+    x += v;
+    int32_t r = z - x;
+    x += (r * EST_ALPHA + 128) >> 8;
+    v += (r * EST_BETA + 128) >> 8;
+}
+
+int est_temp()
+{
+    return (x + (1 << (FRAC - 1))) >> FRAC;
+}
+
+int est_rate()
+{
+    // degC * 4 << FRAC per reading -> 0.01 degC/s
+    return (v * (25 * EST_HZ) + (1 << (FRAC - 1))) >> FRAC;
+}
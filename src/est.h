@@ -0,0 +1,64 @@
+/**
+ * @file est.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Filtered oven temperature and its rate of change
+ *
+ * An alpha-beta filter tracks the temperature and its rate from the
+ * thermocouple readings, which are quantized to 0.25 degC and noisy. With
+ * each reading, the state is predicted one reading ahead, and temperature
+ * and rate are corrected by the fractions @c EST_ALPHA and @c EST_BETA of
+ * the difference between the reading and the prediction.
+ *
+ * The state is kept with 8 more fractional bits than the readings, the
+ * rate per reading interval. An update takes two multiplications with
+ * constants, a few additions and shifts of 32 bit values, without loops or
+ * divisions; its cycle count is part of the one of the sample task in the
+ * benchmark (see bench/bench.h).
+ */
+
+#ifndef EST_H
+#define EST_H
+
+#include <stdint.h>
+
+// readings per second the filter is tuned for (see EST_BETA)
+#ifndef EST_HZ
+#define EST_HZ      10
+#endif
+
+// Filter gains (multiplied by 256): alpha = 1/8 and the beta of a critically
+// damped filter, beta = 2 (2 - alpha) - 4 sqrt(1 - alpha) = 0.008. The rate
+// follows a change within about 4 s; with 0.5 degC of noise on the readings,
+// the temperature varies by 0.17 degC and the rate by 0.08 degC/s.
+#ifndef EST_ALPHA
+#define EST_ALPHA   32
+#endif
+#ifndef EST_BETA
+#define EST_BETA    2
+#endif
+
+/**
+ * @brief Restart the filter with the next reading.
+ */
+void est_reset();
+
+/**
+ * @brief Update the filter with the reading @p temp (multiplied by 4).
+ *
+ * The readings must be @c 1 / EST_HZ s apart.
+ */
+void est_update(int temp);
+
+/**
+ * @brief Get the filtered temperature (multiplied by 4).
+ */
+int est_temp();
+
+/**
+ * @brief Get the filtered rate of change of the temperature (0.01 degC/s).
+ */
+int est_rate();
+
+#endif // EST_H
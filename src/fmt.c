@@ -0,0 +1,118 @@
+/**
+ * @file fmt.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Lightweight number formatting for the display and serial output
+ */
+#include "fmt.h"
+
+// powers of ten used for the conversion (the AVR has no divide instruction,
+// so the digits of a number are obtained by repeated subtraction instead of
+// a division per digit; only fmt_uint(), fmt_hms() and fmt_tenths()
+// divide, once per group of digits or field, to split their argument)
+static const unsigned int dec_pow[] = { 10000, 1000, 100, 10, 1 };
+
+char *fmt_str(char *buf, const char *str)
+{
+    while (*str != 0)
+        *buf++ = *str++;
+    *buf = 0;
+    return buf;
+}
+
+/**
+ * @brief Write an unsigned number with a sign prefix, padded to a width.
+ *
+ * @p neg selects whether a '-' is written in front of the digits. If @p pad
+ * is '0' the padding goes between the sign and the digits.
+ */
+static char *fmt_num(char *buf, unsigned int val, uint8_t neg, uint8_t width, char pad)
+{
+    char digits[5];
+    uint8_t n = 0, i;
+
+    for (i = 0; i < 5; i++) {
+        char d = '0';
+        while (val >= dec_pow[i]) {
+            val -= dec_pow[i];
+            d++;
+        }
+        if (d != '0' || n != 0 || i == 4)
+            digits[n++] = d;
+    }
+
+    uint8_t len = n + neg;
+    if (neg && pad == '0')
+        *buf++ = '-';
+    for (; len < width; len++)
+        *buf++ = pad;
+    if (neg && pad != '0')
+        *buf++ = '-';
+    for (i = 0; i < n; i++)
+        *buf++ = digits[i];
+    *buf = 0;
+    return buf;
+}
+
+char *fmt_int(char *buf, int val, uint8_t width, char pad)
+{
+    if (val < 0)
+        return fmt_num(buf, -(unsigned int)val, 1, width, pad);
+    return fmt_num(buf, val, 0, width, pad);
+}
+
+char *fmt_uint(char *buf, uint32_t val, uint8_t width, char pad)
+{
+    if (val < 10000)
+        return fmt_num(buf, val, 0, width, pad);
+
+    // the digits above the last four first
+    uint32_t high = val / 10000;
+    buf = fmt_uint(buf, high, width > 4 ? width - 4 : 0, pad);
+    return fmt_num(buf, val - high * 10000, 0, 4, '0');
+}
+
+/**
+ * @brief Write a fixed point number with @p frac_bits fractional bits.
+ *
+ * @p step is the decimal value of the least significant bit, scaled such
+ * that it yields @p decimals digits (25 for 2 bits, 625 for 4 bits).
+ */
+static char *fmt_fixed(char *buf, int val, uint8_t width, uint8_t frac_bits,
+                       unsigned int step, uint8_t decimals)
+{
+    uint8_t neg = val < 0;
+    unsigned int abs_val = neg ? -(unsigned int)val : (unsigned int)val;
+
+    buf = fmt_num(buf, abs_val >> frac_bits, neg, width, ' ');
+    *buf++ = '.';
+    return fmt_num(buf, (abs_val & ((1 << frac_bits) - 1)) * step, 0, decimals, '0');
+}
+
+char *fmt_temp4(char *buf, int temp, uint8_t width)
+{
+    return fmt_fixed(buf, temp, width, 2, 25, 2);
+}
+
+char *fmt_temp16(char *buf, int temp, uint8_t width)
+{
+    return fmt_fixed(buf, temp, width, 4, 625, 4);
+}
+
+char *fmt_hms(char *buf, unsigned int secs)
+{
+    unsigned int mins = secs / 60;
+    buf = fmt_num(buf, mins / 60, 0, 2, ' ');
+    *buf++ = ':';
+    buf = fmt_num(buf, mins % 60, 0, 2, '0');
+    *buf++ = ':';
+    return fmt_num(buf, secs % 60, 0, 2, '0');
+}
+
+char *fmt_tenths(char *buf, unsigned int val, uint8_t width)
+{
+    buf = fmt_num(buf, val / 10, 0, width, ' ');
+    *buf++ = '.';
+    return fmt_num(buf, val % 10, 0, 1, '0');
+}
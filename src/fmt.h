@@ -0,0 +1,77 @@
+/**
+ * @file fmt.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Lightweight number formatting for the display and serial output
+ *
+ * These functions replace the printf family for the few formats needed by
+ * the oven. Each function writes its output (followed by a terminating null
+ * character) into the buffer pointed to by @p buf and returns a pointer to
+ * that null character, so that calls can be chained to build up a line:
+ *
+ *     char line[21];
+ *     char *p = fmt_str(line, "Temp: ");
+ *     p = fmt_temp4(p, temp, 3);
+ *     fmt_str(p, " degC");
+ *
+ * The caller is responsible for providing a sufficiently large buffer.
+ */
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+
+/**
+ * @brief Copy a string.
+ */
+char *fmt_str(char *buf, const char *str);
+
+/**
+ * @brief Write a decimal integer.
+ *
+ * The number @p val is padded on the left to at least @p width characters
+ * using the character @p pad (either ' ' or '0'). Like "%*d" or "%0*d".
+ */
+char *fmt_int(char *buf, int val, uint8_t width, char pad);
+
+/**
+ * @brief Write an unsigned decimal integer of up to 32 bits.
+ *
+ * Padded like @c fmt_int() , e.g. for times and counters. Like "%*lu" or
+ * "%0*lu".
+ */
+char *fmt_uint(char *buf, uint32_t val, uint8_t width, char pad);
+
+/**
+ * @brief Write a hot junction temperature (2 fractional bits).
+ *
+ * The integer part (including the sign) is padded with spaces to at least
+ * @p width characters, followed by two decimals, e.g. "-12.75".
+ */
+char *fmt_temp4(char *buf, int temp, uint8_t width);
+
+/**
+ * @brief Write a cold junction temperature (4 fractional bits).
+ *
+ * The integer part (including the sign) is padded with spaces to at least
+ * @p width characters, followed by four decimals, e.g. "23.0625".
+ */
+char *fmt_temp16(char *buf, int temp, uint8_t width);
+
+/**
+ * @brief Write a duration given in seconds as "hh:mm:ss".
+ *
+ * The hours are padded with spaces to two characters, like "%2d:%02d:%02d".
+ */
+char *fmt_hms(char *buf, unsigned int secs);
+
+/**
+ * @brief Write a number given in tenths with one decimal, e.g. "2.5".
+ *
+ * The integer part is padded with spaces to at least @p width characters.
+ */
+char *fmt_tenths(char *buf, unsigned int val, uint8_t width);
+
+#endif // FMT_H
@@ -0,0 +1,323 @@
+/**
+ * @file hal.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Hardware abstraction layer
+ *
+ * All accesses to the peripherals of the microcontroller go through this
+ * interface. It is implemented in hal_avr.c for the ATxmega32A4U and in
+ * host/hal_host.c for the simulation running on a PC (compiled with HOST
+ * defined).
+ *
+ * Interrupts are forwarded to the hal_on_*() functions, which have to be
+ * provided by the application.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "clock.h"
+
+#ifdef HOST
+// the simulation is single-threaded, interrupts never preempt the program
+#define HAL_ATOMIC for (uint8_t hal_atomic_once = 1; hal_atomic_once; hal_atomic_once = 0)
+
+// there is only one address space
+#include <string.h>
+#define PROGMEM
+#define PSTR(str) (str)
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#else
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+/**
+ * @brief Execute the following block with interrupts disabled.
+ */
+#define HAL_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+
+/**
+ * @brief Enable interrupts.
+ */
+void hal_irq_enable();
+
+/**
+ * @brief Disable interrupts.
+ */
+void hal_irq_disable();
+
+/**
+ * @brief Sleep until the next interrupt.
+ *
+ * This function must be called with interrupts disabled. They are enabled
+ * right before the CPU is put to sleep, so that an interrupt in between
+ * wakes it up at once instead of being missed. Interrupts are enabled on
+ * return.
+ *
+ * The peripherals keep running (idle sleep mode).
+ */
+void hal_sleep();
+
+/**
+ * @brief Stop the clocks of the peripherals that are not used.
+ */
+void hal_power_init();
+
+/**
+ * @brief Usage of the RAM (bytes).
+ */
+typedef struct {
+    uint16_t data;  // initialized variables (.data)
+    uint16_t bss;   // other variables (.bss and .noinit)
+    uint16_t stack; // deepest extent of the stack since the start
+    uint16_t free;  // never used since the start
+} hal_ram_t;
+
+/**
+ * @brief Measure the usage of the RAM.
+ *
+ * Before the variables are initialized, the RAM between them and the top
+ * of the stack is filled with a pattern, which the stack overwrites as it
+ * grows. The function counts the bytes of the pattern left above the
+ * variables (a few cycles per free byte); a stack frame whose deepest
+ * bytes have not been written yet is not counted. The simulation reports
+ * 0 for all values.
+ */
+void hal_ram_usage(hal_ram_t *ram);
+
+/**
+ * @brief Period of the heater PWM in timer counts (duty cycle 100 %).
+ *
+ * The timer counts at F_CPU / CLOCK_PWM_DIV (31250 Hz at 32 MHz), the
+ * default period is 1.966 s. A shorter period reduces the temperature
+ * ripple of the heater elements, but must stay long compared to a mains
+ * cycle if a zero-crossing relay is used.
+ */
+#ifndef HAL_PWM_PERIOD
+#define HAL_PWM_PERIOD CLOCK_PWM_PERIOD
+#endif
+
+/**
+ * @brief Number of heater outputs (1 to 3).
+ *
+ * Each output drives the heater elements of one zone of the oven with a
+ * compare channel of the PWM timer (see hal_avr.c for the pins); all of
+ * them share the period. The fourth compare channel would drive the pin
+ * of the status LED.
+ */
+#ifndef HAL_PWM_CHANNELS
+#define HAL_PWM_CHANNELS 1
+#endif
+
+#if HAL_PWM_CHANNELS < 1 || HAL_PWM_CHANNELS > 3
+#error "the PWM timer has 3 compare channels free, the fourth one is on the LED pin"
+#endif
+
+/**
+ * @brief Initialize the PWM outputs to steer the heater elements.
+ *
+ * At the start of each PWM period @c hal_on_pwm_period() is called.
+ */
+void hal_pwm_init();
+
+/**
+ * @brief Power the PWM timer up (@p on non-zero) or down.
+ *
+ * Powering it down drives the heater outputs low at once and stops the
+ * clock of the timer; @c hal_on_pwm_period() is not called while it is
+ * down. Powering it up restarts it with a duty cycle of 0 (like
+ * @c hal_pwm_init() ).
+ */
+void hal_pwm_power(uint8_t on);
+
+/**
+ * @brief Set the duty cycle of heater output @p ch .
+ *
+ * The new duty cycle @p duty (between 0 and @c HAL_PWM_PERIOD ) takes
+ * effect at the start of the next PWM period.
+ */
+void hal_pwm_set(uint8_t ch, uint16_t duty);
+
+/**
+ * @brief Frequency of the update timer in Hz.
+ */
+#define HAL_TICK_HZ 10
+
+/**
+ * @brief Initialize the update timer.
+ *
+ * The timer calls @c hal_on_tick() @c HAL_TICK_HZ times per second.
+ */
+void hal_tick_init();
+
+/**
+ * @brief Restart the update timer.
+ */
+void hal_tick_restart();
+
+/**
+ * @brief Set up the start/stop button, the mode switch and the jumper.
+ *
+ * Pressing the button calls @c hal_on_button() .
+ */
+void hal_button_init();
+
+/**
+ * @brief Check whether the start/stop button is held down.
+ */
+uint8_t hal_button_down();
+
+/**
+ * @brief Check whether the mode switch selects bake mode.
+ *
+ * The function returns 0 if reflow mode is selected and non-zero for bake
+ * mode.
+ */
+uint8_t hal_switch_bake();
+
+/**
+ * @brief Read the profile selection jumper.
+ *
+ * The function returns 0 if the jumper is open and 1 if it is closed.
+ */
+uint8_t hal_jumper();
+
+/**
+ * @brief Size of the EEPROM in bytes.
+ */
+#define HAL_EEPROM_SIZE 1024
+
+/**
+ * @brief Read @p len bytes at address @p addr of the EEPROM into @p buf .
+ */
+void hal_eeprom_read(uint16_t addr, void *buf, uint16_t len);
+
+/**
+ * @brief Write @p len bytes from @p buf to address @p addr of the EEPROM.
+ *
+ * Only bytes that differ from the EEPROM contents are written (each cell
+ * endures about 100000 write cycles). The function blocks until all bytes
+ * have been written.
+ */
+void hal_eeprom_write(uint16_t addr, const void *buf, uint16_t len);
+
+/**
+ * @brief Initialize the status LED (off).
+ */
+void hal_led_init();
+
+/**
+ * @brief Switch the status LED on (@p on non-zero) or off.
+ */
+void hal_led_set(uint8_t on);
+
+/**
+ * @brief Toggle the status LED.
+ */
+void hal_led_toggle();
+
+/**
+ * @brief Initialize the USART for transmission and reception.
+ *
+ * Each character received calls @c hal_on_uart_rx() .
+ */
+void hal_uart_init();
+
+/**
+ * @brief Create the stdio stream for the serial output.
+ *
+ * Each character written to the returned stream is passed to @p put .
+ */
+FILE *hal_uart_stream(int (*put)(char, FILE *));
+
+/**
+ * @brief Check whether the transmit data register is empty.
+ */
+uint8_t hal_uart_tx_ready();
+
+/**
+ * @brief Write a character to the transmit data register.
+ */
+void hal_uart_tx(char c);
+
+/**
+ * @brief Enable (@p on non-zero) or disable the data register empty
+ * interrupt, which calls @c hal_on_uart_tx() .
+ */
+void hal_uart_tx_irq(uint8_t on);
+
+/**
+ * @brief Number of MAX31855K on the SPI bus (1 to 4).
+ *
+ * They share the clock and data lines, each has its own chip select line
+ * (see hal_avr.c for the pins).
+ */
+#ifndef HAL_SPI_DEVICES
+#define HAL_SPI_DEVICES 1
+#endif
+
+#if HAL_SPI_DEVICES < 1 || HAL_SPI_DEVICES > 4
+#error "there are chip select lines for 4 devices"
+#endif
+
+/**
+ * @brief Initialize the SPI bus for the MAX31855K.
+ */
+void hal_spi_init();
+
+/**
+ * @brief Assert (@p on non-zero) or release the chip select line of device
+ * @p dev .
+ */
+void hal_spi_select(uint8_t dev, uint8_t on);
+
+/**
+ * @brief Start transferring one byte over the SPI bus.
+ *
+ * When the transfer has completed, @c hal_on_spi() is called with the
+ * byte received.
+ */
+void hal_spi_write(uint8_t data);
+
+
+// Interrupt handlers, implemented by the application:
+
+/**
+ * @brief Called by the update timer interrupt.
+ */
+void hal_on_tick();
+
+/**
+ * @brief Called at the start of each PWM period, after the duty cycle set
+ * by @c hal_pwm_set() has taken effect.
+ */
+void hal_on_pwm_period();
+
+/**
+ * @brief Called when the start/stop button is pressed.
+ */
+void hal_on_button();
+
+/**
+ * @brief Called when the USART is ready to accept a character.
+ */
+void hal_on_uart_tx();
+
+/**
+ * @brief Called when the USART has received the character @p c .
+ */
+void hal_on_uart_rx(char c);
+
+/**
+ * @brief Called when a transfer over the SPI bus has completed, with the
+ * byte received @p data .
+ */
+void hal_on_spi(uint8_t data);
+
+#endif // HAL_H
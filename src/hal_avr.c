@@ -0,0 +1,340 @@
+/**
+ * @file hal_avr.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Hardware abstraction layer for the ATxmega32A4U
+ */
+#include "hal.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+
+// status LED (bit mask of port E)
+#define LED_PIN 0x04 // pin E2
+
+// Heater output ch is driven by compare channel PWM_CC<ch> of TCE0 (0 to 3:
+// channel A to D on pins E0 to E3); channel C would drive the LED.
+#define PWM_CC0 3 // D, pin E3
+#define PWM_CC1 1 // B, pin E1
+#define PWM_CC2 0 // A, pin E0
+static const uint8_t pwm_cc[3] = { PWM_CC0, PWM_CC1, PWM_CC2 };
+#define PWM_PINS (1 << PWM_CC0 | (HAL_PWM_CHANNELS > 1) << PWM_CC1 | (HAL_PWM_CHANNELS > 2) << PWM_CC2)
+#define PWM_CCEN (PWM_PINS << 4) // compare enable bits in CTRLB
+
+#if PWM_PINS & LED_PIN
+#error "a heater output shares its pin with the status LED"
+#endif
+
+// Chip select line of each MAX31855K (bit masks of port C, active low). C4
+// is the SS pin of SPIC: it must not be an input driven low in master mode.
+#ifndef HAL_SPI_CS
+#define HAL_SPI_CS { 0x02, 0x10, 0x08, 0x04 } // pins C1, C4, C3, C2
+#endif
+
+static const uint8_t spi_cs[4] = HAL_SPI_CS;
+
+// pattern of the RAM not used yet (see hal_ram_usage())
+#define RAM_PAINT 0xc5
+
+// boundaries of the sections in RAM, from the linker script
+extern uint8_t __data_start, __data_end, __bss_start, _end, __stack;
+
+void hal_irq_enable()
+{
+    PMIC.CTRL = 0x03; // medium level: update timer, button; low level: PWM, UART, SPI
+    sei();
+}
+
+void hal_irq_disable()
+{
+    cli();
+}
+
+void hal_sleep()
+{
+    SLEEP.CTRL = SLEEP_SMODE_IDLE_gc | SLEEP_SEN_bm;
+    sei(); // takes effect after the next instruction
+    sleep_cpu();
+    SLEEP.CTRL = 0;
+}
+
+void hal_power_init()
+{
+    // used: TCC0 (update timer), TCE0 (PWM), SPIC, USARTD1
+    PR.PRGEN = PR_USB_bm | PR_AES_bm | PR_EBI_bm | PR_RTC_bm | PR_EVSYS_bm | PR_DMA_bm;
+    PR.PRPA = PR_DAC_bm | PR_ADC_bm | PR_AC_bm;
+    PR.PRPC = PR_TWI_bm | PR_USART1_bm | PR_USART0_bm | PR_HIRES_bm | PR_TC1_bm;
+    PR.PRPD = PR_TWI_bm | PR_USART0_bm | PR_SPI_bm | PR_HIRES_bm | PR_TC1_bm | PR_TC0_bm;
+    PR.PRPE = PR_TWI_bm | PR_USART1_bm | PR_USART0_bm | PR_SPI_bm | PR_HIRES_bm | PR_TC1_bm;
+}
+
+/**
+ * @brief Fill the RAM between the variables and the top of the stack with
+ * @c RAM_PAINT (see @c hal_ram_usage() ).
+ *
+ * This runs in .init3, after the stack pointer has been set up and before
+ * the variables are initialized, when nothing is on the stack yet.
+ */
+void hal_ram_paint() __attribute__((naked, used, section(".init3")));
+void hal_ram_paint()
+{
+    __asm__ volatile (
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, %0\n"
+        "    ldi r25, hi8(__stack + 1)\n"
+        "1:  st Z+, r24\n"
+        "    cpi r30, lo8(__stack + 1)\n"
+        "    cpc r31, r25\n"
+        "    brne 1b\n"
+        :: "M" (RAM_PAINT));
+}
+
+void hal_ram_usage(hal_ram_t *ram)
+{
+    const uint8_t *p = &_end;
+
+    // the bytes above the stack pointer are in use now
+    while (p <= (const uint8_t *)(uintptr_t)SP && *p == RAM_PAINT)
+        p++;
+
+    ram->data = &__data_end - &__data_start;
+    ram->bss = &_end - &__bss_start;
+    ram->free = p - &_end;
+    ram->stack = &__stack + 1 - p;
+}
+
+void hal_pwm_init()
+{
+    uint8_t ch;
+
+    PORTE.DIRSET = PWM_PINS;
+
+    // set period (see clock.h)
+    TCE0.PERL = CLOCK_PER(HAL_PWM_PERIOD) & 0xff;
+    TCE0.PERH = CLOCK_PER(HAL_PWM_PERIOD) >> 8;
+
+    // initiate duty cycles to 0 (CCA to CCD are consecutive)
+    for (ch = 0; ch < HAL_PWM_CHANNELS; ch++) {
+        (&TCE0.CCAL)[2 * pwm_cc[ch]] = 0;
+        (&TCE0.CCAH)[2 * pwm_cc[ch]] = 0;
+    }
+
+    TCE0.INTCTRLA = 1; // enable overflow interrupt with level 1
+    TCE0.CTRLB = PWM_CCEN | 3; // enable the compare channels, activate single-slope PWM waveform generation
+    TCE0.CTRLA = CLOCK_PWM_CTRLA; // prescaler: CLOCK_PWM_DIV
+}
+
+void hal_pwm_power(uint8_t on)
+{
+    if (on) {
+        PR.PRPE &= ~PR_TC0_bm;
+        hal_pwm_init();
+    } else {
+        PORTE.OUTCLR = PWM_PINS; // the port drives the pins once released
+        TCE0.CTRLB = 0;    // release the pins
+        TCE0.CTRLA = 0;    // stop the timer
+        TCE0.INTFLAGS = 1; // clear a pending overflow interrupt
+        PR.PRPE |= PR_TC0_bm;
+    }
+}
+
+void hal_pwm_set(uint8_t ch, uint16_t duty)
+{
+    // CCABUF to CCDBUF are consecutive
+    (&TCE0.CCABUFL)[2 * pwm_cc[ch]] = duty & 0xff;
+    (&TCE0.CCABUFH)[2 * pwm_cc[ch]] = duty >> 8;
+}
+
+void hal_tick_init()
+{
+    // set period to 1 / HAL_TICK_HZ (prescaler: 64, see clock.h)
+    TCC0.PERL = CLOCK_PER(CLOCK_TICK_PERIOD(HAL_TICK_HZ)) & 0xff;
+    TCC0.PERH = CLOCK_PER(CLOCK_TICK_PERIOD(HAL_TICK_HZ)) >> 8;
+
+    TCC0.INTCTRLA = 2; // enable overflow interrupt with level 2
+    TCC0.CTRLA = CLOCK_TICK_CTRLA; // prescaler: 64
+}
+
+void hal_tick_restart()
+{
+    TCC0.CTRLFSET = 8; // write restart command to F register
+    TCC0.CTRLFCLR = 0xc; // clear command bits in F register
+
+    TCC0.INTFLAGS = 1; // clear overflow interrupt (in case one is pending)
+}
+
+void hal_button_init()
+{
+    PORTD.INT0MASK = 1; // add pin 0 to port interrupt 0
+    PORTD.PIN0CTRL = 2; // sense falling edge
+
+    PORTD.INTCTRL = 2; // activate port interrupt 0 with level 2
+
+    PORTD.PIN2CTRL = 0x18; // pin 2 (profile jumper to ground): pull-up
+}
+
+uint8_t hal_button_down()
+{
+    return !(PORTD.IN & 1);
+}
+
+uint8_t hal_switch_bake()
+{
+    return PORTD.IN & 2;
+}
+
+uint8_t hal_jumper()
+{
+    return !(PORTD.IN & 4);
+}
+
+void hal_eeprom_read(uint16_t addr, void *buf, uint16_t len)
+{
+    eeprom_read_block(buf, (const void *)(uintptr_t)addr, len);
+}
+
+void hal_eeprom_write(uint16_t addr, const void *buf, uint16_t len)
+{
+    eeprom_update_block(buf, (void *)(uintptr_t)addr, len);
+}
+
+void hal_led_init()
+{
+    PORTE.DIRSET = LED_PIN;
+    PORTE.OUTCLR = LED_PIN;
+}
+
+void hal_led_set(uint8_t on)
+{
+    if (on)
+        PORTE.OUTSET = LED_PIN;
+    else
+        PORTE.OUTCLR = LED_PIN;
+}
+
+void hal_led_toggle()
+{
+    PORTE.OUTTGL = LED_PIN;
+}
+
+void hal_uart_init()
+{
+    // set pin D7 high and as output (TX pin)
+    PORTD.OUTSET = 0x80;
+    PORTD.DIRSET = 0x80;
+
+    // baud rate: CLOCK_BAUD (see clock.h)
+    USARTD1.BAUDCTRLB = CLOCK_BAUDCTRLB;
+    USARTD1.BAUDCTRLA = CLOCK_BAUDCTRLA;
+
+    USARTD1.CTRLA = 0x10; // RXC interrupt with level 1 (DRE interrupt is enabled on demand)
+    USARTD1.CTRLC = 3; // async, no parity, 8 bit data, 1 stop bit
+
+    USARTD1.CTRLB = 0x18; // enable receiver (pin D6) and transmitter
+}
+
+FILE *hal_uart_stream(int (*put)(char, FILE *))
+{
+    static FILE stream;
+    fdev_setup_stream(&stream, put, NULL, _FDEV_SETUP_WRITE);
+    return &stream;
+}
+
+uint8_t hal_uart_tx_ready()
+{
+    return USARTD1.STATUS & 0x20; // data register empty flag
+}
+
+void hal_uart_tx(char c)
+{
+    USARTD1.DATA = c;
+}
+
+void hal_uart_tx_irq(uint8_t on)
+{
+    USARTD1.CTRLA = on ? 0x11 : 0x10; // DRE interrupt with level 1, keep the RXC interrupt
+}
+
+void hal_spi_init()
+{
+    uint8_t dev;
+
+    // set the CS pins high and as outputs
+    for (dev = 0; dev < HAL_SPI_DEVICES; dev++) {
+        PORTC.OUTSET = spi_cs[dev];
+        PORTC.DIRSET = spi_cs[dev];
+    }
+
+    // set pin C7 low and as output (SCK pin)
+    PORTC.OUTCLR = 0x80;
+    PORTC.DIRSET = 0x80;
+
+    SPIC.INTCTRL = 1; // enable interrupt with level 1
+    SPIC.CTRL = 0x50 | CLOCK_SPI_CTRL; // master spi in mode 0, clk / CLOCK_SPI_DIV, msb first
+}
+
+void hal_spi_select(uint8_t dev, uint8_t on)
+{
+    if (on)
+        PORTC.OUTCLR = spi_cs[dev]; // CS low
+    else
+        PORTC.OUTSET = spi_cs[dev]; // CS high
+}
+
+void hal_spi_write(uint8_t data)
+{
+    SPIC.DATA = data;
+}
+
+/**
+ * @brief Update timer interrupt routine.
+ */
+ISR(TCC0_OVF_vect)
+{
+    hal_on_tick();
+}
+
+/**
+ * @brief PWM timer interrupt routine (start of a PWM period).
+ */
+ISR(TCE0_OVF_vect)
+{
+    hal_on_pwm_period();
+}
+
+/**
+ * @brief Start/stop button interrupt routine.
+ */
+ISR(PORTD_INT0_vect)
+{
+    hal_on_button();
+}
+
+/**
+ * @brief USART data register empty interrupt routine.
+ */
+ISR(USARTD1_DRE_vect)
+{
+    hal_on_uart_tx();
+}
+
+/**
+ * @brief USART receive complete interrupt routine (reading the data clears
+ * the flag).
+ */
+ISR(USARTD1_RXC_vect)
+{
+    hal_on_uart_rx(USARTD1.DATA);
+}
+
+/**
+ * @brief SPI transfer complete interrupt routine (clears the flag).
+ */
+ISR(SPIC_INT_vect)
+{
+    hal_on_spi(SPIC.DATA);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file check.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Assertions for the unit tests run by "make check"
+ *
+ * Each test program evaluates its conditions with @c CHECK() or
+ * @c CHECK_EQ() , which report the failed ones with file and line on
+ * stderr, and returns @c check_done() from main() (exit status 1 if any
+ * check failed).
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static unsigned check_count, check_failed;
+
+static inline int check(int ok, const char *cond, const char *file, int line)
+{
+    check_count++;
+    if (!ok) {
+        check_failed++;
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, cond);
+    }
+    return ok;
+}
+
+static inline int check_eq(long a, long b, const char *cond, const char *file, int line)
+{
+    if (!check(a == b, cond, file, line))
+        fprintf(stderr, "    %ld != %ld\n", a, b);
+    return a == b;
+}
+
+/**
+ * @brief Check that @p cond holds.
+ */
+#define CHECK(cond) check((cond) != 0, #cond, __FILE__, __LINE__)
+
+/**
+ * @brief Check that the integers @p a and @p b are equal (both are shown
+ * if not).
+ */
+#define CHECK_EQ(a, b) check_eq((long)(a), (long)(b), #a " == " #b, __FILE__, __LINE__)
+
+/**
+ * @brief Report the number of checks of the test @p name and of those that
+ * failed; returns the exit status.
+ */
+static inline int check_done(const char *name)
+{
+    printf("%s: %u checks, %u failed\n", name, check_count, check_failed);
+    return check_failed != 0;
+}
+
+#endif // CHECK_H
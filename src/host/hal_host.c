@@ -0,0 +1,359 @@
+/**
+ * @file hal_host.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Simulated hardware for running the firmware on a PC
+ */
+#define _GNU_SOURCE
+#include "hal_host.h"
+#include "hal.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define PWM_CLK     ((double)F_CPU / CLOCK_PWM_DIV) // PWM timer count rate (Hz)
+#define PWM_PERIOD  (HAL_PWM_PERIOD / PWM_CLK)  // PWM period (s)
+#define TICK_PERIOD (1. / HAL_TICK_HZ)          // update timer period (s)
+#define CONV_PERIOD 0.1                         // MAX31855 conversion time (s)
+
+static plant_t *plant;
+static FILE *sink;
+static double noise;
+static unsigned rand_state;
+
+static double now;
+static uint8_t irq_on;
+
+static uint8_t tick_on, button_on, button_down, switch_bake, jumper, led;
+static double next_tick;
+
+static uint16_t duty_buf[HAL_PWM_CHANNELS], duty[HAL_PWM_CHANNELS]; // CCxBUF and CCx
+static uint8_t pwm_on;              // PWM timer powered
+static double pwm_start;            // start of the current PWM period
+
+static uint8_t uart_irq;
+static char rx_queue[4096];         // characters still to be received
+static unsigned rx_head, rx_tail;
+
+static double next_conv;
+static uint32_t conv_data[HAL_SPI_DEVICES]; // result of the last conversion of each device
+static uint32_t spi_shift;          // shift register of the selected device
+static uint8_t spi_pending, spi_data; // transfer waiting for its interrupt
+static uint8_t tc_fault;            // fault bits reported by the MAX31855K
+
+static uint8_t eeprom[HAL_EEPROM_SIZE];
+
+void hal_host_init(plant_t *p, FILE *uart_sink, double n, unsigned seed)
+{
+    plant = p;
+    sink = uart_sink;
+    noise = n;
+    rand_state = seed;
+    memset(eeprom, 0xff, sizeof(eeprom));
+}
+
+/**
+ * @brief Approximately normal distributed random number (mean 0, sd 1).
+ */
+static double gauss()
+{
+    double sum = 0.;
+    int i;
+    for (i = 0; i < 12; i++) {
+        rand_state = rand_state * 1103515245u + 12345u;
+        sum += (rand_state >> 8) / (double)(1u << 24);
+    }
+    return sum - 6.;
+}
+
+double hal_host_noise()
+{
+    return noise * gauss();
+}
+
+/**
+ * @brief Let the simulated MAX31855K convert the thermocouple temperatures
+ * (device i measures zone i of the plant).
+ */
+static void convert()
+{
+    int i;
+
+    for (i = 0; i < HAL_SPI_DEVICES; i++) {
+        double hj = plant->t_sensor[i % plant->zones] + noise * gauss();
+        long hj_q = lround(hj * 4.), cj_q = lround(plant->ambient * 16.);
+
+        conv_data[i] = ((uint32_t)(hj_q & 0x3fff) << 18) | ((uint32_t)(cj_q & 0xfff) << 4);
+        if (tc_fault)
+            conv_data[i] = (conv_data[i] & 0xfff0) | 0x10000 | tc_fault;
+    }
+}
+
+void hal_host_step(double dt)
+{
+    double on[PLANT_ZONES];
+    int i;
+
+    now += dt;
+
+    // the duty cycle buffers are copied at the start of each PWM period
+    while (now - pwm_start >= PWM_PERIOD) {
+        pwm_start += PWM_PERIOD;
+        memcpy(duty, duty_buf, sizeof(duty));
+        if (irq_on && pwm_on)
+            hal_on_pwm_period();
+    }
+    // the heater of zone i is driven by output i (of the ones there are)
+    for (i = 0; i < plant->zones; i++)
+        on[i] = (now - pwm_start) * PWM_CLK < duty[i % HAL_PWM_CHANNELS] ? 1. : 0.;
+    plant_step(plant, on, dt);
+
+    if (now >= next_conv) {
+        next_conv += CONV_PERIOD;
+        convert();
+    }
+
+    if (irq_on) {
+        if (tick_on && now >= next_tick) {
+            next_tick += TICK_PERIOD;
+            hal_on_tick();
+        }
+        // the serial line is not simulated, the buffer is drained at once
+        while (uart_irq)
+            hal_on_uart_tx();
+        // one character is received per step
+        if (rx_tail != rx_head) {
+            hal_on_uart_rx(rx_queue[rx_tail]);
+            rx_tail = (rx_tail + 1) % sizeof(rx_queue);
+        }
+        // nor is the SPI bus, a frame is transferred within one step
+        while (spi_pending) {
+            spi_pending = 0;
+            hal_on_spi(spi_data);
+        }
+    }
+}
+
+double hal_host_time()
+{
+    return now;
+}
+
+void hal_host_press_button()
+{
+    hal_host_set_button(1);
+    hal_host_set_button(0);
+}
+
+void hal_host_set_button(uint8_t down)
+{
+    // the interrupt is triggered by the falling edge (pressing the button)
+    if (down && !button_down && irq_on && button_on)
+        hal_on_button();
+    button_down = down;
+}
+
+void hal_host_set_switch(uint8_t bake)
+{
+    switch_bake = bake;
+}
+
+void hal_host_set_jumper(uint8_t closed)
+{
+    jumper = closed;
+}
+
+void hal_host_uart_rx(const char *str)
+{
+    for (; *str != 0; str++) {
+        unsigned next = (rx_head + 1) % sizeof(rx_queue);
+        if (next == rx_tail)
+            break;
+        rx_queue[rx_head] = *str;
+        rx_head = next;
+    }
+}
+
+void hal_host_set_tc_fault(uint8_t fault)
+{
+    tc_fault = fault & 7;
+}
+
+double hal_host_duty(uint8_t ch)
+{
+    return (double)duty[ch] / HAL_PWM_PERIOD;
+}
+
+uint8_t hal_host_led()
+{
+    return led;
+}
+
+uint8_t *hal_host_eeprom()
+{
+    return eeprom;
+}
+
+void hal_irq_enable()
+{
+    irq_on = 1;
+}
+
+void hal_irq_disable()
+{
+    irq_on = 0;
+}
+
+void hal_sleep()
+{
+    // the simulation advances in fixed steps, whether the CPU sleeps or not
+    irq_on = 1;
+}
+
+void hal_power_init()
+{
+}
+
+void hal_ram_usage(hal_ram_t *ram)
+{
+    // the simulation does not run in the RAM of the microcontroller
+    memset(ram, 0, sizeof(*ram));
+}
+
+void hal_pwm_init()
+{
+    memset(duty_buf, 0, sizeof(duty_buf));
+    memset(duty, 0, sizeof(duty));
+    pwm_start = now;
+    pwm_on = 1;
+}
+
+void hal_pwm_power(uint8_t on)
+{
+    if (on)
+        hal_pwm_init();
+    else {
+        memset(duty_buf, 0, sizeof(duty_buf));
+        memset(duty, 0, sizeof(duty));
+        pwm_on = 0;
+    }
+}
+
+void hal_pwm_set(uint8_t ch, uint16_t d)
+{
+    if (pwm_on)
+        duty_buf[ch] = d > HAL_PWM_PERIOD ? HAL_PWM_PERIOD : d;
+}
+
+void hal_tick_init()
+{
+    tick_on = 1;
+    next_tick = now + TICK_PERIOD;
+}
+
+void hal_tick_restart()
+{
+    next_tick = now + TICK_PERIOD;
+}
+
+void hal_button_init()
+{
+    button_on = 1;
+}
+
+uint8_t hal_button_down()
+{
+    return button_down;
+}
+
+uint8_t hal_switch_bake()
+{
+    return switch_bake;
+}
+
+uint8_t hal_jumper()
+{
+    return jumper;
+}
+
+void hal_eeprom_read(uint16_t addr, void *buf, uint16_t len)
+{
+    memcpy(buf, eeprom + addr, len);
+}
+
+void hal_eeprom_write(uint16_t addr, const void *buf, uint16_t len)
+{
+    memcpy(eeprom + addr, buf, len);
+}
+
+void hal_led_init()
+{
+    led = 0;
+}
+
+void hal_led_set(uint8_t on)
+{
+    led = on != 0;
+}
+
+void hal_led_toggle()
+{
+    led = !led;
+}
+
+void hal_uart_init()
+{
+}
+
+static ssize_t stream_write(void *cookie, const char *buf, size_t size)
+{
+    int (*put)(char, FILE *) = (int (*)(char, FILE *))cookie;
+    size_t i;
+    for (i = 0; i < size; i++)
+        put(buf[i], NULL);
+    return size;
+}
+
+FILE *hal_uart_stream(int (*put)(char, FILE *))
+{
+    cookie_io_functions_t funcs = { .write = stream_write };
+    FILE *f = fopencookie((void *)put, "w", funcs);
+    setvbuf(f, NULL, _IONBF, 0);
+    return f;
+}
+
+uint8_t hal_uart_tx_ready()
+{
+    return 1;
+}
+
+void hal_uart_tx(char c)
+{
+    if (sink != NULL)
+        fputc(c, sink);
+}
+
+void hal_uart_tx_irq(uint8_t on)
+{
+    uart_irq = on;
+}
+
+void hal_spi_init()
+{
+    next_conv = now;
+}
+
+void hal_spi_select(uint8_t dev, uint8_t on)
+{
+    if (on)
+        spi_shift = conv_data[dev];
+}
+
+void hal_spi_write(uint8_t data)
+{
+    spi_data = spi_shift >> 24;
+    spi_shift <<= 8;
+    spi_pending = 1;
+}
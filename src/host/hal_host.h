@@ -0,0 +1,106 @@
+/**
+ * @file hal_host.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Simulated hardware for running the firmware on a PC
+ *
+ * The simulation advances in discrete time steps. In each step the heater
+ * PWM drives the plant model, the simulated MAX31855K sample the plant and
+ * due interrupts are delivered to the hal_on_*() handlers.
+ *
+ * Heater output i drives the heater elements of zone i of the plant (and
+ * of every @c HAL_PWM_CHANNELS th zone after it), MAX31855K i reads the
+ * thermocouple of zone i; the plant should have as many zones as there are
+ * outputs or devices, whichever is more.
+ */
+
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "plant.h"
+
+/**
+ * @brief Set up the simulated hardware.
+ *
+ * @p plant is the thermal model driven by the heater PWM. Everything sent
+ * to the serial output is written to @p uart_sink (may be NULL). @p noise
+ * is the standard deviation of the thermocouple noise in deg C, @p seed
+ * initializes the noise generator.
+ */
+void hal_host_init(plant_t *plant, FILE *uart_sink, double noise, unsigned seed);
+
+/**
+ * @brief Get a sample of the thermocouple noise (deg C).
+ *
+ * The samples are approximately normal distributed with the standard
+ * deviation given to @c hal_host_init() and come from the same generator
+ * as the noise of the simulated MAX31855K.
+ */
+double hal_host_noise();
+
+/**
+ * @brief Advance the simulated time by @p dt seconds.
+ */
+void hal_host_step(double dt);
+
+/**
+ * @brief Get the simulated time in seconds.
+ */
+double hal_host_time();
+
+/**
+ * @brief Press and release the start/stop button.
+ */
+void hal_host_press_button();
+
+/**
+ * @brief Press (@p down non-zero) or release the start/stop button.
+ */
+void hal_host_set_button(uint8_t down);
+
+/**
+ * @brief Set the mode switch to bake (@p bake non-zero) or reflow.
+ */
+void hal_host_set_switch(uint8_t bake);
+
+/**
+ * @brief Close (@p closed non-zero) or open the profile selection jumper.
+ */
+void hal_host_set_jumper(uint8_t closed);
+
+/**
+ * @brief Send the characters of @p str to the serial input.
+ *
+ * They are received one per step of the simulation.
+ */
+void hal_host_uart_rx(const char *str);
+
+/**
+ * @brief Let all MAX31855K report the faults @p fault from their next
+ * conversion on (bit 0: open circuit, bit 1: short to GND, bit 2: short
+ * to VCC; 0: no fault).
+ */
+void hal_host_set_tc_fault(uint8_t fault);
+
+/**
+ * @brief Get the duty cycle of heater output @p ch in the current PWM
+ * period (0 to 1).
+ */
+double hal_host_duty(uint8_t ch);
+
+/**
+ * @brief Get the state of the status LED.
+ */
+uint8_t hal_host_led();
+
+/**
+ * @brief Get the contents of the simulated EEPROM (@c HAL_EEPROM_SIZE bytes,
+ * erased to 0xff by @c hal_host_init() ).
+ */
+uint8_t *hal_host_eeprom();
+
+#endif // HAL_HOST_H
@@ -0,0 +1,61 @@
+/**
+ * @file plant.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Thermal model of the oven for the host simulation
+ */
+#include "plant.h"
+
+void plant_init(plant_t *plant)
+{
+    int i;
+
+    plant->power = 1500.;
+    plant->heater_mass = 300.;
+    plant->oven_mass = 700.;
+    plant->coupling = 30.;
+    plant->loss = 4.;
+    plant->sensor_tau = 3.;
+    plant->ambient = 25.;
+    plant->zones = 1;
+    plant->mix = 10.;
+    plant->skew = 1.;
+
+    for (i = 0; i < PLANT_ZONES; i++)
+        plant->t_heater[i] = plant->t_oven[i] = plant->t_sensor[i] = plant->ambient;
+}
+
+void plant_step(plant_t *plant, const double *heater, double dt)
+{
+    int n = plant->zones, i;
+    double q_mix[PLANT_ZONES + 1] = { 0. }; // heat flow from zone i - 1 into zone i
+
+    for (i = 1; i < n; i++)
+        q_mix[i] = plant->mix * (plant->t_oven[i - 1] - plant->t_oven[i]);
+
+    for (i = 0; i < n; i++) {
+        // the losses of the zones average to the loss of the oven
+        double loss = plant->loss / n;
+        if (n > 1)
+            loss *= (1. + plant->skew * i / (n - 1)) / (1. + plant->skew / 2.);
+
+        double q_heater = plant->power / n * heater[i];
+        double q_coupling = plant->coupling / n * (plant->t_heater[i] - plant->t_oven[i]);
+        double q_loss = loss * (plant->t_oven[i] - plant->ambient);
+
+        plant->t_heater[i] += (q_heater - q_coupling) / (plant->heater_mass / n) * dt;
+        plant->t_oven[i] += (q_coupling - q_loss + q_mix[i] - q_mix[i + 1]) / (plant->oven_mass / n) * dt;
+        plant->t_sensor[i] += (plant->t_oven[i] - plant->t_sensor[i]) / plant->sensor_tau * dt;
+    }
+}
+
+double plant_mean(const plant_t *plant, const double *t)
+{
+    double sum = 0.;
+    int i;
+
+    for (i = 0; i < plant->zones; i++)
+        sum += t[i];
+    return sum / plant->zones;
+}
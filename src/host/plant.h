@@ -0,0 +1,62 @@
+/**
+ * @file plant.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Thermal model of the oven for the host simulation
+ *
+ * The oven is modelled by three first order lags: the heater elements
+ * (heated by the electrical power, coupled to the oven), the oven contents
+ * (air, tray and board, losing heat to the ambient) and the thermocouple
+ * (following the oven temperature with a time constant).
+ *
+ * The oven can be split into up to @c PLANT_ZONES zones of the same size
+ * (e.g. top and bottom), each with its own heater elements, contents and
+ * thermocouple. The contents of neighbouring zones exchange heat, and the
+ * losses to the ambient are skewed from the first to the last zone.
+ */
+
+#ifndef PLANT_H
+#define PLANT_H
+
+#define PLANT_ZONES 4
+
+typedef struct {
+    // parameters (of the whole oven):
+    double power;       // heater power at 100 % duty cycle (W)
+    double heater_mass; // heat capacity of the heater elements (J/K)
+    double oven_mass;   // heat capacity of the oven contents (J/K)
+    double coupling;    // heat transfer heater -> oven (W/K)
+    double loss;        // heat transfer oven -> ambient (W/K)
+    double sensor_tau;  // time constant of the thermocouple (s)
+    double ambient;     // ambient temperature (deg C)
+    int zones;          // number of zones (1 to PLANT_ZONES)
+    double mix;         // heat transfer between neighbouring zones (W/K)
+    double skew;        // loss of the last zone relative to the first one, minus 1
+
+    // state of each zone (deg C):
+    double t_heater[PLANT_ZONES], t_oven[PLANT_ZONES], t_sensor[PLANT_ZONES];
+} plant_t;
+
+/**
+ * @brief Initialize a plant with the default parameters.
+ *
+ * The defaults roughly match a 1.5 kW toaster oven with one zone. All
+ * temperatures start at the ambient temperature.
+ */
+void plant_init(plant_t *plant);
+
+/**
+ * @brief Advance the plant by @p dt seconds.
+ *
+ * @p heater holds the fraction of the heater power of each zone applied
+ * during this step (0 for off, 1 for on).
+ */
+void plant_step(plant_t *plant, const double *heater, double dt);
+
+/**
+ * @brief Get the mean of the zone temperatures @p t .
+ */
+double plant_mean(const plant_t *plant, const double *t);
+
+#endif // PLANT_H
@@ -0,0 +1,441 @@
+/**
+ * @file replay.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Replay captured serial output through the controller
+ *
+ * Reads the serial output of the firmware built without display (one line
+ * per second of a reflow, "TIME\tTEMP\t PHASE" or "TIME\tTEMP\tdiff: ...
+ * => DUTY%" during soak, and "TEMP\tdiff: ...\tout: DUTY%" while baking)
+ * from files, or from all files below a directory. The recorded
+ * temperatures of each run are fed to @c reflow_update() or to the bake
+ * controller, and the phase and heater duty of each update are compared
+ * to the recorded ones (the duty only where the capture shows it).
+ *
+ * Each divergence is reported with the file, line and time of the run;
+ * the exit status is 1 if there was any, so the tool can be used as a
+ * regression check (see "make check").
+ *
+ * The rise rate used to predict the overshoot (see coast.h) is estimated
+ * from the recorded temperatures, interpolated to the sample rate of the
+ * firmware; a capture of a noisy thermocouple may hence switch the heater
+ * off a second earlier or later on replay.
+ */
+#include "hal_host.h"
+#include "reflow.h"
+#include "profile.h"
+#include "coast.h"
+#include "est.h"
+#include "pid.h"
+#include "tune.h"
+#include "out.h"
+
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TIMEOUT     (12 * 60) // of a reflow (s, see reflow.c)
+#define MAX_REPORTS 5         // divergences reported per run (unless -v)
+#define BAKE_DROP   (20 * 4)  // drop between two lines that starts a new bake
+
+// phase shown by the firmware for each segment kind (see reflow_show())
+static const char *const labels[] = {
+    [SEG_PREHEAT] = "PREHEAT",
+    [SEG_SOAK] = "SOAK",
+    [SEG_RAMP] = "RAMPING UP",
+    [SEG_RAMP_LIQUIDUS] = "RAMPING UP",
+    [SEG_LIQUIDUS] = "LIQUIDUS PHASE",
+    [SEG_COAST] = "LIQUIDUS PHASE, HEATER OFF",
+    [SEG_PEAK] = "PEAK",
+    [SEG_CHILL] = "CHILLING",
+    [SEG_COOL] = "COOL DOWN",
+};
+
+typedef enum { RUN_NONE, RUN_REFLOW, RUN_BAKE, RUN_SKIP } run_kind_t;
+
+// options
+static uint8_t profile = PROFILE_LEADED;
+static int bake_temp = 125 * 4;
+static int coast = -1; // coast gain (-1: as loaded by the firmware)
+static int verbose;
+
+// state of the run being replayed
+static run_kind_t run;
+static int last_t, last_temp;   // of the last update
+static unsigned run_reports;
+static pid_state_t bake_pid;
+
+// totals
+static unsigned long steps, divergences, reflows, bakes, skipped;
+
+/**
+ * @brief Parse a temperature "D.DD" as written by the firmware at @p s ,
+ * store it (multiplied by 4) in @p temp and return a pointer behind it, or
+ * NULL if there is none.
+ */
+static const char *parse_temp(const char *s, int *temp)
+{
+    char *end;
+    long deg = strtol(s, &end, 10);
+    int neg = *s == '-';
+
+    if (end == s || *end != '.' || end[1] < '0' || end[1] > '9' || end[2] < '0' || end[2] > '9')
+        return NULL;
+    int quarters = ((end[1] - '0') * 10 + (end[2] - '0')) / 25;
+    *temp = deg * 4 + (neg ? -quarters : quarters);
+    return end + 3;
+}
+
+/**
+ * @brief Parse the heater duty "N%" at the end of @p s .
+ */
+static int parse_duty(const char *s, int *duty)
+{
+    const char *p = strrchr(s, '>');
+    if (p == NULL && (p = strstr(s, "out:")) == NULL)
+        return 0;
+    p += *p == '>' ? 1 : 4;
+    return sscanf(p, "%d%%", duty) == 1;
+}
+
+/**
+ * @brief Report a divergence of the run in @p file at @p line .
+ */
+static void diverge(const char *file, int line, const char *fmt, ...)
+{
+    va_list ap;
+
+    divergences++;
+    if (!verbose && ++run_reports > MAX_REPORTS) {
+        if (run_reports == MAX_REPORTS + 1)
+            printf("%s:%d: more divergences in this run not shown\n", file, line);
+        return;
+    }
+    printf("%s:%d: ", file, line);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+}
+
+// copy of the filter state of est.c and the last reconstructed reading
+// (see feed_est())
+static int32_t est_x, est_v;
+static int est_z, est_dz;
+
+/**
+ * @brief Run the filter of est.c on the readings of one second, rising
+ * linearly from after @p z0 to @p z1 , from the state @p x , @p v .
+ */
+static void est_model(int32_t *x, int32_t *v, int z0, int z1)
+{
+    int i;
+    for (i = 1; i <= EST_HZ; i++) {
+        int32_t z = (int32_t)(z0 + (z1 - z0) * i / EST_HZ) << 8;
+        *x += *v;
+        int32_t r = z - *x;
+        *x += (r * EST_ALPHA + 128) >> 8;
+        *v += (r * EST_BETA + 128) >> 8;
+    }
+}
+
+/**
+ * @brief Run a copy of the filter on the readings of one second rising to
+ * @p z , return the filtered temperature and store the rate in @p rate .
+ */
+static int est_end(int z, int *rate)
+{
+    int32_t x = est_x, v = est_v;
+    est_model(&x, &v, est_z, z);
+    *rate = (v * (25 * EST_HZ) + 128) >> 8;
+    return (x + 128) >> 8;
+}
+
+/**
+ * @brief Feed the filter with the readings of one second that lead to the
+ * filtered temperature @p temp .
+ *
+ * The captures only show the filtered temperature, rounded to 0.25 degC,
+ * so the readings are reconstructed: a linear rise from the last reading
+ * over the second to an end reading for which a copy of the filter ends
+ * at @p temp . Of these, the one closest to the trend of the last seconds
+ * is taken, unless @p target is non-zero: then one for which the
+ * predicted peak (see coast.h) reaches @p target if @p cut is set, and
+ * stays below it otherwise, is preferred.
+ */
+static void feed_est(int temp, int target, uint8_t cut)
+{
+    int lo = -0x2000, hi = 0x2000, z, best, rate, i;
+
+    // lowest end reading leading to temp
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (est_end(mid, &rate) < temp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    best = est_z + est_dz;
+    if (best < lo || est_end(lo, &rate) != temp)
+        best = lo;
+    else
+        while (est_end(best, &rate) > temp)
+            best--;
+
+    if (target != 0) {
+        est_end(best, &rate);
+        if ((coast_predict(temp, rate, 1000) >= target) != cut)
+            for (z = lo; est_end(z, &rate) == temp; z++)
+                if ((coast_predict(temp, rate, 1000) >= target) == cut) {
+                    best = z;
+                    break;
+                }
+    }
+
+    est_model(&est_x, &est_v, est_z, best);
+    for (i = 1; i <= EST_HZ; i++)
+        est_update(est_z + (best - est_z) * i / EST_HZ);
+    est_dz = best - est_z;
+    est_z = best;
+}
+
+/**
+ * @brief Start a run of kind @p kind at temperature @p temp .
+ */
+static void start_run(run_kind_t kind, int temp)
+{
+    run = kind;
+    run_reports = 0;
+    last_t = 0;
+    last_temp = temp;
+
+    est_reset();
+    est_update(temp);
+    est_x = (int32_t)temp << 8;
+    est_v = 0;
+    est_z = temp;
+    est_dz = 0;
+    if (kind == RUN_REFLOW) {
+        reflow_start(profile);
+        if (coast >= 0)
+            coast_gain = coast;
+        reflows++;
+    } else {
+        bake_pid = tune_pid();
+        bakes++;
+    }
+}
+
+/**
+ * @brief Replay one update of a reflow, recorded at @p line as time
+ * @p t , temperature @p temp and the rest of the line @p rest .
+ */
+static void reflow_line(const char *file, int line, int t, int temp, const char *rest)
+{
+    int out = 0, duty;
+
+    if ((run != RUN_REFLOW && run != RUN_SKIP) || t < last_t) {
+        if (t != 1) {
+            // the capture starts within this run, its state is unknown
+            run = RUN_SKIP;
+            skipped++;
+        } else
+            start_run(RUN_REFLOW, temp);
+    }
+    if (run == RUN_SKIP) {
+        last_t = t;
+        return;
+    }
+    if (t == last_t)
+        return; // repeated line
+
+    if (t > last_t + 1)
+        printf("%s:%d: t=%d s: %d updates missing in the capture\n", file, line, t, t - last_t - 1);
+
+    // the predicted peak decides whether the heater is switched off (the
+    // phase changes); follow the capture where its rounding allows both
+    const char *rec = strncmp(rest, "diff:", 5) == 0 ? labels[SEG_SOAK] : rest + (*rest == ' ');
+    profile_seg_t s;
+    profile_seg(profile, reflow_phase(), &s);
+    int target = s.exit == SEG_EXIT_PREDICT ? s.temp : 0;
+    uint8_t cut = strcmp(rec, labels[s.kind]) != 0;
+
+    // interpolate the temperatures of missing updates
+    for (; last_t < t; last_t++) {
+        int tt = last_temp + (temp - last_temp) / (t - last_t);
+        if (last_t + 1 < t)
+            feed_est(tt, 0, 0);
+        else
+            feed_est(tt, target, cut);
+        out = reflow_update(tt, 1000);
+        last_temp = tt;
+        steps++;
+    }
+
+    profile_seg(profile, reflow_phase(), &s);
+    const char *phase = t >= TIMEOUT ? "TIMEOUT" : s.kind < sizeof(labels) / sizeof(labels[0]) ? labels[s.kind] : "?";
+    int level = (out * 100L + OUT_MAX / 2) / OUT_MAX;
+
+    if (strcmp(rec, phase) != 0)
+        diverge(file, line, "t=%d s: phase %s, replayed %s", t, rec, phase);
+    else if (rec == labels[SEG_SOAK] && parse_duty(rest, &duty) && duty != level)
+        diverge(file, line, "t=%d s: heater %d%%, replayed %d%%", t, duty, level);
+}
+
+/**
+ * @brief Replay one update of a bake, recorded at @p line with
+ * temperature @p temp and the rest of the line @p rest .
+ */
+static void bake_line(const char *file, int line, int temp, const char *rest)
+{
+    int duty;
+
+    // the oven cools down without output between two bakes
+    if (run != RUN_BAKE || temp < last_temp - BAKE_DROP)
+        start_run(RUN_BAKE, temp);
+
+    feed_est(temp, 0, 0);
+    int out = pid_update(&bake_pid, bake_temp, temp, OUT_FF, 1000);
+    int level = (out * 100L + OUT_MAX / 2) / OUT_MAX;
+    last_temp = temp;
+    last_t++;
+    steps++;
+
+    if (parse_duty(rest, &duty) && duty != level)
+        diverge(file, line, "t=%d s: heater %d%%, replayed %d%%", last_t, duty, level);
+}
+
+/**
+ * @brief Replay the capture in @p file .
+ */
+static int replay_file(const char *file)
+{
+    FILE *f = fopen(file, "r");
+    char buf[256];
+    int line = 0;
+
+    if (f == NULL) {
+        perror(file);
+        return 0;
+    }
+
+    // each capture starts with the coast gain not yet adapted
+    memset(hal_host_eeprom(), 0xff, HAL_EEPROM_SIZE);
+    coast_gain = COAST_GAIN;
+    run = RUN_NONE;
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        char *end;
+        const char *p;
+        int temp;
+
+        line++;
+        buf[strcspn(buf, "\r\n")] = 0;
+
+        long t = strtol(buf, &end, 10);
+        if (end != buf && *end == '\t' && (p = parse_temp(end + 1, &temp)) != NULL && *p == '\t')
+            reflow_line(file, line, t, temp, p + 1);
+        else if ((p = parse_temp(buf, &temp)) != NULL && strncmp(p, "\tdiff:", 6) == 0)
+            bake_line(file, line, temp, p + 1);
+        else if (strncmp(buf, "ERROR", 5) == 0)
+            est_reset(); // no update while the thermocouple fails
+        else if (run == RUN_BAKE && strncmp(buf, "OVERHEATED", 10) != 0)
+            run = RUN_NONE;
+    }
+    fclose(f);
+    return 1;
+}
+
+/**
+ * @brief Replay @p path , or all files below it if it is a directory.
+ */
+static int replay_path(const char *path)
+{
+    struct stat st;
+    struct dirent **names;
+    int n, i, ok = 1;
+
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return 0;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return replay_file(path);
+
+    if ((n = scandir(path, &names, NULL, alphasort)) < 0) {
+        perror(path);
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        if (names[i]->d_name[0] != '.') {
+            char sub[4096];
+            snprintf(sub, sizeof(sub), "%s/%s", path, names[i]->d_name);
+            ok &= replay_path(sub);
+        }
+        free(names[i]);
+    }
+    free(names);
+    return ok;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options] FILE|DIR...\n"
+            "  -p N        profile of the reflows (default: 0, see profile.h)\n"
+            "  -b DEGC     bake temperature (default: 125)\n"
+            "  -g P,I,D    controller gains (default: those of tune.h)\n"
+            "  -c GAIN     coast gain (0.1 s, default: see coast.h)\n"
+            "  -v          report all divergences (default: %d per run)\n", prog, MAX_REPORTS);
+}
+
+int main(int argc, char **argv)
+{
+    int opt, i, ok = 1;
+
+    hal_host_init(NULL, NULL, 0., 0);
+    tune_init();
+
+    while ((opt = getopt(argc, argv, "p:b:g:c:vh")) != -1) {
+        switch (opt) {
+            case 'p':
+                profile = atoi(optarg);
+                if (!profile_valid(profile)) {
+                    fprintf(stderr, "%s: no built-in profile %s\n", argv[0], optarg);
+                    return 2;
+                }
+                break;
+            case 'b': bake_temp = atoi(optarg) * 4; break;
+            case 'c': coast = atoi(optarg); break;
+            case 'g':
+                if (sscanf(optarg, "%hd,%hd,%hd", &tune_gains.P, &tune_gains.I, &tune_gains.D) != 3) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'v': verbose = 1; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    clock_t wall = clock();
+    for (i = optind; i < argc; i++)
+        ok &= replay_path(argv[i]);
+
+    fprintf(stderr, "replayed %lu reflows and %lu bakes (%lu updates) in %.0f ms, "
+            "%lu incomplete runs skipped, %lu divergences\n",
+            reflows, bakes, steps, (clock() - wall) * 1000. / CLOCKS_PER_SEC, skipped, divergences);
+    return !ok ? 2 : divergences != 0;
+}
@@ -0,0 +1,338 @@
+/**
+ * @file sim.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Run the oven firmware against a simulated oven on a PC
+ *
+ * The firmware is started, the start button is pressed (or held for the
+ * auto-tune) and the simulation runs until the oven has returned to idle
+ * (or a time limit is reached). Instead of pressing the button, commands
+ * (see cmd.h) can be sent to the serial input at given times.
+ * A trace of the run is written as CSV.
+ *
+ * The temperature ripple while the controller holds a set point (second
+ * half of the soak segments, or of the bake time) is reported at the end,
+ * to compare builds with different output stage settings (see out.h).
+ *
+ * With more than one heater output or thermocouple (see @c HAL_PWM_CHANNELS
+ * and @c HAL_SPI_DEVICES ), the oven is split into as many zones; the trace
+ * then shows the mean of the zones followed by the oven temperature of each
+ * zone, and the largest difference between the zones while holding a set
+ * point is reported as well.
+ *
+ * The run recorded by the firmware (see rec.h) can be decoded from the
+ * EEPROM and written as CSV as well; its size is reported.
+ */
+#include "hal_host.h"
+#include "hal.h"
+#include "plant.h"
+#include "oven.h"
+#include "reflow.h"
+#include "profile.h"
+#include "rec.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STEP 0.001 // simulation time step (s)
+#define HOLD 2.5   // time the button is held to start the auto-tune (s)
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -b          bake instead of reflow\n"
+            "  -a          auto-tune the controller instead of reflow\n"
+            "  -f          close the profile jumper (lead-free profile)\n"
+            "  -d SECONDS  bake duration before pressing stop (default: 3600)\n"
+            "  -o FILE     write the CSV trace to FILE (default: stdout)\n"
+            "  -i SECONDS  trace interval (default: 1)\n"
+            "  -u FILE     write the serial output to FILE\n"
+            "  -t SECONDS  simulated time limit (default: 3600)\n"
+            "  -m FACTOR   scale the heat capacity of the oven contents\n"
+            "  -p WATTS    heater power (default: 1500)\n"
+            "  -k FACTOR   loss of the last zone relative to the first one,\n"
+            "              minus 1 (default: 1)\n"
+            "  -n DEGC     thermocouple noise (standard deviation)\n"
+            "  -s SEED     seed for the noise generator\n"
+            "  -e FILE     load the EEPROM contents from FILE (if it exists) and\n"
+            "              save them to FILE at the end\n"
+            "  -r FILE     write the recorded run to FILE as CSV\n"
+            "  -c T0,T1    open the thermocouple from T0 to T1 seconds\n"
+            "  -x FILE     send the commands in FILE to the serial input instead\n"
+            "              of pressing the button, one per line after the time in\n"
+            "              seconds at which it is sent (e.g. \"0.5 reflow\")\n", prog);
+}
+
+/**
+ * @brief Decode the recorded run from the EEPROM and write it to @p file .
+ */
+static void write_rec(const char *file)
+{
+    if (!rec_load()) {
+        fprintf(stderr, "no run recorded\n");
+        return;
+    }
+
+    FILE *f = fopen(file, "w");
+    if (f == NULL) {
+        perror(file);
+        return;
+    }
+
+    const rec_head_t *head = rec_head();
+    rec_iter_t iter = { 0, 0, 0 };
+    int temp;
+    unsigned t = 0;
+
+    fprintf(f, "time,oven\n");
+    while (rec_next(&iter, &temp)) {
+        fprintf(f, "%u,%.2f\n", t, temp / 4.);
+        t += head->interval;
+    }
+    fclose(f);
+
+    // compared to the samples as int16_t at the same interval
+    unsigned size = sizeof(*head) + head->len;
+    fprintf(stderr, "recorded %u samples every %u s in %u bytes "
+            "(%.2f bytes per sample, %.1f times smaller than raw)\n",
+            head->count, head->interval, size, (double)head->len / head->count,
+            2. * head->count / size);
+}
+
+#define MAX_CMDS 64
+
+static double cmd_time[MAX_CMDS];
+static char cmd_line[MAX_CMDS][80];
+static int num_cmds;
+
+/**
+ * @brief Read the commands to send from @p file .
+ */
+static int read_cmds(const char *file)
+{
+    FILE *f = fopen(file, "r");
+    char buf[100];
+    int n;
+
+    if (f == NULL) {
+        perror(file);
+        return 0;
+    }
+    while (num_cmds < MAX_CMDS && fgets(buf, sizeof(buf), f) != NULL) {
+        if (sscanf(buf, "%lf %n", &cmd_time[num_cmds], &n) != 1)
+            continue;
+        snprintf(cmd_line[num_cmds], sizeof(cmd_line[0]), "%s", buf + n);
+        num_cmds++;
+    }
+    fclose(f);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    plant_t plant;
+    plant_init(&plant);
+    plant.zones = HAL_PWM_CHANNELS > HAL_SPI_DEVICES ? HAL_PWM_CHANNELS : HAL_SPI_DEVICES;
+
+    FILE *trace = stdout, *uart_sink = NULL;
+    const char *eeprom_file = NULL, *rec_file = NULL;
+    int bake = 0, tune = 0, jumper = 0;
+    double bake_time = 3600., interval = 1., limit = 3600., noise = 0.;
+    double open_start = -1., open_end = -1.;
+    unsigned seed = 1;
+    int i;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "bafd:o:i:u:t:m:p:k:n:s:e:r:c:x:h")) != -1) {
+        switch (opt) {
+            case 'b': bake = 1; break;
+            case 'a': tune = 1; break;
+            case 'e': eeprom_file = optarg; break;
+            case 'r': rec_file = optarg; break;
+            case 'x':
+                if (!read_cmds(optarg))
+                    return 1;
+                break;
+            case 'f': jumper = 1; break;
+            case 'd': bake_time = atof(optarg); break;
+            case 'i': interval = atof(optarg); break;
+            case 't': limit = atof(optarg); break;
+            case 'm': plant.oven_mass *= atof(optarg); break;
+            case 'p': plant.power = atof(optarg); break;
+            case 'k': plant.skew = atof(optarg); break;
+            case 'n': noise = atof(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            case 'c':
+                if (sscanf(optarg, "%lf,%lf", &open_start, &open_end) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'o':
+                if ((trace = fopen(optarg, "w")) == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'u':
+                if ((uart_sink = fopen(optarg, "w")) == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    clock_t wall = clock();
+
+    hal_host_init(&plant, uart_sink, noise, seed);
+    if (eeprom_file != NULL) {
+        FILE *f = fopen(eeprom_file, "rb");
+        if (f != NULL) {
+            if (fread(hal_host_eeprom(), 1, HAL_EEPROM_SIZE, f) != HAL_EEPROM_SIZE)
+                fprintf(stderr, "%s: incomplete EEPROM image\n", eeprom_file);
+            fclose(f);
+        }
+    }
+    hal_host_set_switch(bake || tune);
+    hal_host_set_jumper(jumper);
+    oven_init();
+
+    // give the MAX31855K time for its first conversion, then press start
+    // (unless the commands start the process)
+    while (hal_host_time() < 0.5)
+        hal_host_step(STEP);
+    if (num_cmds == 0)
+        hal_host_set_button(1);
+    double release = hal_host_time() + (tune ? HOLD : 0.);
+    int next_cmd = 0;
+
+    fprintf(trace, "time,oven,sensor,heater,duty,mode,phase");
+    for (i = 0; plant.zones > 1 && i < plant.zones; i++)
+        fprintf(trace, ",oven%d", i);
+    fprintf(trace, "\n");
+
+    double oven = plant_mean(&plant, plant.t_oven), sensor = plant_mean(&plant, plant.t_sensor);
+    double next_trace = hal_host_time(), peak = oven, peak_sensor = sensor;
+    int started = 0, stopped = 0;
+
+    // oven temperature range while holding a set point
+    double hold_start = 0., hold_min = 1e9, hold_max = -1e9, hold_spread = 0.;
+    int last_phase = -1;
+
+    // last time the heater was on while the thermocouple was open
+    double open_heat = -1.;
+    while (hal_host_time() < limit) {
+        if (hal_host_time() >= release)
+            hal_host_set_button(0);
+        while (next_cmd < num_cmds && hal_host_time() >= cmd_time[next_cmd])
+            hal_host_uart_rx(cmd_line[next_cmd++]);
+
+        int open = hal_host_time() >= open_start && hal_host_time() < open_end;
+        hal_host_set_tc_fault(open);
+        for (i = 0; i < HAL_PWM_CHANNELS; i++)
+            if (open && hal_host_duty(i) > 0.)
+                open_heat = hal_host_time();
+
+        hal_host_step(STEP);
+        oven_poll();
+
+        int mode = oven_mode();
+        if (mode != OVEN_MODE_IDLE)
+            started = 1;
+        else if (started)
+            break;
+
+        if (bake && !stopped && hal_host_time() >= bake_time) {
+            hal_host_press_button();
+            stopped = 1;
+        }
+
+        oven = plant_mean(&plant, plant.t_oven);
+        sensor = plant_mean(&plant, plant.t_sensor);
+        if (oven > peak)
+            peak = oven;
+        if (sensor > peak_sensor)
+            peak_sensor = sensor;
+
+        int hold = 0;
+        if (mode == OVEN_MODE_REFLOW) {
+            oven_status_t st;
+            profile_seg_t seg;
+            int phase = reflow_phase();
+
+            oven_status(&st);
+            profile_seg(st.profile, phase, &seg);
+            if (phase != last_phase) {
+                hold_start = hal_host_time();
+                last_phase = phase;
+            }
+            hold = seg.kind == SEG_SOAK && hal_host_time() - hold_start >= seg.time / 2.;
+        } else if (mode == OVEN_MODE_BAKE)
+            hold = hal_host_time() >= bake_time / 2.;
+        if (hold) {
+            if (oven < hold_min)
+                hold_min = oven;
+            if (oven > hold_max)
+                hold_max = oven;
+            for (i = 1; i < plant.zones; i++) {
+                double d = fabs(plant.t_oven[i] - plant.t_oven[0]);
+                if (d > hold_spread)
+                    hold_spread = d;
+            }
+        }
+
+        if (hal_host_time() >= next_trace) {
+            next_trace += interval;
+            fprintf(trace, "%.3f,%.2f,%.2f,%.2f,%.4f,%d,%d", hal_host_time(),
+                    oven, sensor, plant_mean(&plant, plant.t_heater),
+                    hal_host_duty(0), mode, mode == OVEN_MODE_REFLOW ? reflow_phase() : -1);
+            for (i = 0; plant.zones > 1 && i < plant.zones; i++)
+                fprintf(trace, ",%.2f", plant.t_oven[i]);
+            fprintf(trace, "\n");
+        }
+    }
+
+    fprintf(stderr, "simulated %.0f s in %.0f ms, peak oven temperature %.1f degC "
+            "(thermocouple %.1f degC)\n",
+            hal_host_time(), (clock() - wall) * 1000. / CLOCKS_PER_SEC, peak, peak_sensor);
+    if (hold_max >= hold_min)
+        fprintf(stderr, "ripple while holding the set point %.2f degC (%.1f to %.1f degC)\n",
+                hold_max - hold_min, hold_min, hold_max);
+    if (hold_max >= hold_min && plant.zones > 1)
+        fprintf(stderr, "difference between the zones while holding the set point up to %.2f degC\n",
+                hold_spread);
+
+    if (open_start >= 0. && open_start < hal_host_time()) {
+        if (open_heat < 0.)
+            fprintf(stderr, "thermocouple open at %.0f s, heater off\n", open_start);
+        else
+            fprintf(stderr, "thermocouple open at %.0f s, heater on until %.1f s later\n",
+                    open_start, open_heat - open_start);
+    }
+
+    if (rec_file != NULL)
+        write_rec(rec_file);
+
+    if (eeprom_file != NULL) {
+        FILE *f = fopen(eeprom_file, "wb");
+        if (f == NULL || fwrite(hal_host_eeprom(), 1, HAL_EEPROM_SIZE, f) != HAL_EEPROM_SIZE)
+            perror(eeprom_file);
+        if (f != NULL)
+            fclose(f);
+    }
+
+    if (trace != stdout)
+        fclose(trace);
+    if (uart_sink != NULL)
+        fclose(uart_sink);
+    return 0;
+}
@@ -0,0 +1,520 @@
+/**
+ * @file sweep.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Sweep the controller parameters against the simulated oven
+ *
+ * Runs a simulated reflow (or bake) for each combination of the controller
+ * gains, their feed-forward output (see @c OUT_FF ), the coast gain (see
+ * coast.h) and two thresholds of the profile:
+ * the offset of the temperature at which the heater is switched off before
+ * the peak (the segment left on @c SEG_EXIT_PREDICT ) and the time it stays
+ * off at most while the temperature still rises (the segment left on
+ * @c SEG_EXIT_ABOVE_OR_TIME ). The profile is modified as an uploaded one
+ * (see @c profile_user_edit() ).
+ *
+ * Each reflow is scored on the oven temperature of the plant (not the
+ * thermocouple): the difference of the peak from the peak temperature of
+ * the profile (overshoot, or undershoot if the heater is cut too early), the
+ * difference of the time above liquidus from the middle of its limits,
+ * the time the ramp rate exceeds the limits of the profile and the time
+ * until the oven is idle again. A bake is scored on the overshoot above the
+ * set point, the ripple in its second half and the time until the oven
+ * stays within @c SETTLE of the set point. Runs that do not reach the peak
+ * temperature of the profile or do not settle are not ranked.
+ *
+ * The runs that are not worse in every score than another one (the Pareto
+ * set) are written to stdout, ranked by the sum of their scores scaled to
+ * the range of each score within the set.
+ *
+ * The firmware keeps its state in static variables, so the runs cannot
+ * share a process: each run is forked from the main process, which has not
+ * started the firmware, and writes its scores to shared memory. Up to one
+ * process per CPU runs at a time, the next run starts as soon as any of
+ * them finishes.
+ */
+#include "hal_host.h"
+#include "hal.h"
+#include "plant.h"
+#include "oven.h"
+#include "profile.h"
+#include "coast.h"
+#include "tune.h"
+#include "out.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STEP 0.001 // simulation time step (s)
+#define LIMIT 3600. // simulated time limit of a run (s)
+#define RATE_WINDOW 5 // interval of the ramp rate measurement (s, see ana.h)
+#define SETTLE 2. // band around the set point of a settled bake (deg C)
+#define NUM_SCORES 4
+
+enum { P_GAIN, I_GAIN, D_GAIN, FF, COAST, OFFSET, WINDOW, NUM_PARAMS };
+
+typedef struct {
+    int from, to, step;
+} range_t;
+
+static const char *const param_names[NUM_PARAMS] = { "P", "I", "D", "ff", "coast", "offset", "window" };
+
+static const char *const reflow_scores[NUM_SCORES] = {
+    "peak_error", "tal_error", "ramp_violation", "cycle_time"
+};
+static const char *const bake_scores[NUM_SCORES] = { "overshoot", "ripple", "settling_time", NULL };
+
+typedef struct {
+    int param[NUM_PARAMS];
+    uint8_t done;  // run completed
+    uint8_t valid; // peak reached or bake settled
+    double score[NUM_SCORES];
+    int front;     // Pareto front (1: not dominated), 0: not ranked
+    double rank;   // sum of the scaled scores within the front
+} run_t;
+
+static int bake, jumper, noise_seed = 1;
+static double bake_time = 1200., mass = 1., power = 0., noise = 0.;
+static int bake_temp = 125;
+
+static run_t *runs;
+static int num_runs, num_scores;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -b          bake instead of reflow\n"
+            "  -f          lead-free profile\n"
+            "  -t DEGC     bake temperature (default: 125)\n"
+            "  -d SECONDS  bake duration (default: 1200)\n"
+            "  -m FACTOR   scale the heat capacity of the oven contents\n"
+            "  -p WATTS    heater power (default: that of plant.c)\n"
+            "  -n DEGC     thermocouple noise (standard deviation)\n"
+            "  -s SEED     seed for the noise generator\n"
+            "  -j JOBS     runs at a time (default: number of CPUs)\n"
+            "  -o FILE     write the parameters and scores of all runs to FILE\n"
+            "              as CSV\n"
+            "parameter ranges (FROM[:TO[:STEP]]):\n"
+            "  -P RANGE    proportional gain (default: 80:240:40)\n"
+            "  -I RANGE    integral gain (default: 0:3:1)\n"
+            "  -D RANGE    differential gain (default: 0:1500:500)\n"
+            "  -F RANGE    feed-forward output, 0 to %d for 0 to 100 %% heater\n"
+            "              power (default: %d)\n"
+            "  -c RANGE    coast gain, 0.1 s (default: 35:55:10)\n"
+            "  -T RANGE    offset of the heater cut-off temperature before the\n"
+            "              peak, degC (default: 0)\n"
+            "  -w RANGE    max. time the heater stays off while the temperature\n"
+            "              rises, s (default: that of the profile)\n",
+            prog, OUT_MAX, OUT_FF_DEFAULT);
+}
+
+/**
+ * @brief Parse a parameter range "FROM[:TO[:STEP]]" from @p str .
+ */
+static int parse_range(const char *str, range_t *r)
+{
+    int n = sscanf(str, "%d:%d:%d", &r->from, &r->to, &r->step);
+    if (n < 1)
+        return 0;
+    if (n < 2)
+        r->to = r->from;
+    if (n < 3)
+        r->step = 1;
+    return r->step > 0 && r->to >= r->from;
+}
+
+/**
+ * @brief Get the number of the first segment of the profile with exit
+ * condition @p exit (-1 if there is none).
+ */
+static int find_seg(const profile_t *p, uint8_t exit)
+{
+    int i;
+    for (i = 0; i < p->num_segs; i++)
+        if (p->segs[i].exit == exit)
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Upload the built-in profile with the thresholds of @p run .
+ */
+static void upload(const run_t *run, uint8_t profile)
+{
+    profile_t *p = profile_user_edit();
+    int i;
+
+    memcpy_P(p, &profiles[profile], sizeof(*p));
+    if ((i = find_seg(p, SEG_EXIT_PREDICT)) >= 0)
+        p->segs[i].temp += run->param[OFFSET] * 4;
+    if ((i = find_seg(p, SEG_EXIT_ABOVE_OR_TIME)) >= 0)
+        p->segs[i].time = run->param[WINDOW];
+    profile_user_done();
+    oven_select_profile(PROFILE_USER);
+}
+
+/**
+ * @brief Simulate a reflow or bake with the parameters of @p run and store
+ * its scores.
+ */
+static void simulate(run_t *run)
+{
+    uint8_t profile = jumper ? PROFILE_LEAD_FREE : PROFILE_LEADED;
+    plant_t plant;
+
+    plant_init(&plant);
+    plant.oven_mass *= mass;
+    if (power > 0.)
+        plant.power = power;
+
+    hal_host_init(&plant, NULL, noise, noise_seed);
+    hal_host_set_switch(bake);
+    hal_host_set_jumper(jumper);
+    oven_init();
+
+    pid_gains_t gains = { run->param[P_GAIN], run->param[I_GAIN], run->param[D_GAIN] };
+    tune_gains = gains;
+    out_ff = run->param[FF];
+    coast_gain = run->param[COAST];
+    if (bake)
+        oven_set_bake(bake_temp * 4, (uint16_t)bake_time);
+    else
+        upload(run, profile);
+
+    while (hal_host_time() < 0.5)
+        hal_host_step(STEP);
+    if (!oven_start(bake ? OVEN_MODE_BAKE : OVEN_MODE_REFLOW))
+        return;
+
+    profile_limits_t lim;
+    double liquidus = profile_liquidus(profile) / 4., target = 0.;
+    profile_limits(profile, &lim);
+    if (!bake) {
+        const profile_t *p = &profiles[profile];
+        int i = find_seg(p, SEG_EXIT_PREDICT);
+        target = i >= 0 ? p->segs[i].temp / 4. : lim.peak_max / 4.;
+    }
+
+    double start = hal_host_time(), next_sample = start + 1.;
+    double hist[RATE_WINDOW] = { 0. }; // oven temperature of the last samples
+    double peak = -1e9, hold_min = 1e9, hold_max = -1e9, settled = 0.;
+    int samples = 0, tal = 0, violation = 0;
+
+    while (hal_host_time() < LIMIT) {
+        hal_host_step(STEP);
+        oven_poll();
+
+        int mode = oven_mode();
+        if (mode != (bake ? OVEN_MODE_BAKE : OVEN_MODE_REFLOW)) {
+            run->done = 1;
+            break;
+        }
+        if (hal_host_time() < next_sample)
+            continue;
+        next_sample += 1.;
+
+        double t = hal_host_time() - start, oven = plant_mean(&plant, plant.t_oven);
+        if (oven > peak)
+            peak = oven;
+        if (bake) {
+            if (fabs(oven - bake_temp) > SETTLE)
+                settled = t;
+            if (t >= bake_time / 2.) {
+                if (oven < hold_min)
+                    hold_min = oven;
+                if (oven > hold_max)
+                    hold_max = oven;
+            }
+        } else {
+            if (oven >= liquidus)
+                tal++;
+            if (samples >= RATE_WINDOW) {
+                double rate = (oven - hist[samples % RATE_WINDOW]) / RATE_WINDOW;
+                if (rate * 10. > lim.ramp_up || -rate * 10. > lim.ramp_down)
+                    violation++;
+            }
+        }
+        hist[samples++ % RATE_WINDOW] = oven;
+    }
+
+    double t = hal_host_time() - start;
+    if (bake) {
+        run->valid = run->done && settled < bake_time / 2.;
+        run->score[0] = peak > bake_temp ? peak - bake_temp : 0.;
+        run->score[1] = hold_max >= hold_min ? hold_max - hold_min : 0.;
+        run->score[2] = settled;
+    } else {
+        run->valid = run->done && peak >= lim.peak_min / 4.;
+        run->score[0] = fabs(peak - target);
+        run->score[1] = fabs(tal - (lim.tal_min + lim.tal_max) / 2.);
+        run->score[2] = violation;
+        run->score[3] = t;
+    }
+}
+
+/**
+ * @brief Simulate all runs, @p jobs at a time.
+ */
+static void simulate_all(int jobs)
+{
+    int next = 0, running = 0, status;
+
+    while (next < num_runs || running > 0) {
+        if (next < num_runs && running < jobs) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                simulate(&runs[next]);
+                _exit(0);
+            }
+            if (pid < 0) {
+                perror("fork");
+                if (running == 0)
+                    exit(1);
+                jobs = running; // wait for the others first
+                continue;
+            }
+            next++;
+            running++;
+        } else if (wait(&status) > 0)
+            running--;
+        else {
+            perror("wait");
+            exit(1);
+        }
+    }
+}
+
+/**
+ * @brief Check whether run @p a is at least as good as run @p b in all
+ * scores and better in at least one.
+ */
+static int dominates(const run_t *a, const run_t *b)
+{
+    int i, better = 0;
+    for (i = 0; i < num_scores; i++) {
+        if (a->score[i] > b->score[i])
+            return 0;
+        if (a->score[i] < b->score[i])
+            better = 1;
+    }
+    return better;
+}
+
+/**
+ * @brief Assign the Pareto front to each valid run: the runs of front 1 are
+ * not dominated by any other, those of front n only by runs of the fronts
+ * before.
+ */
+static void sort_fronts()
+{
+    int front, left = 0, i, j;
+
+    for (i = 0; i < num_runs; i++)
+        if (runs[i].valid)
+            left++;
+
+    for (front = 1; left > 0; front++) {
+        for (i = 0; i < num_runs; i++) {
+            if (!runs[i].valid || runs[i].front != 0)
+                continue;
+            for (j = 0; j < num_runs; j++)
+                if (j != i && runs[j].valid && runs[j].front <= 0 && dominates(&runs[j], &runs[i]))
+                    break;
+            if (j == num_runs)
+                runs[i].front = -front; // still compared with the others of this front
+        }
+        for (i = 0; i < num_runs; i++)
+            if (runs[i].front == -front) {
+                runs[i].front = front;
+                left--;
+            }
+    }
+}
+
+static int by_rank(const void *a, const void *b)
+{
+    const run_t *ra = *(const run_t *const *)a, *rb = *(const run_t *const *)b;
+    return ra->rank < rb->rank ? -1 : ra->rank > rb->rank;
+}
+
+/**
+ * @brief Write the runs of the first Pareto front to stdout, ranked.
+ */
+static void write_front(const char *const *names)
+{
+    double lo[NUM_SCORES], hi[NUM_SCORES];
+    run_t **set = malloc(num_runs * sizeof(*set));
+    int n = 0, i, k;
+
+    for (k = 0; k < num_scores; k++) {
+        lo[k] = 1e9;
+        hi[k] = -1e9;
+    }
+    for (i = 0; i < num_runs; i++) {
+        if (runs[i].front != 1)
+            continue;
+        set[n++] = &runs[i];
+        for (k = 0; k < num_scores; k++) {
+            if (runs[i].score[k] < lo[k])
+                lo[k] = runs[i].score[k];
+            if (runs[i].score[k] > hi[k])
+                hi[k] = runs[i].score[k];
+        }
+    }
+    for (i = 0; i < n; i++) {
+        set[i]->rank = 0.;
+        for (k = 0; k < num_scores; k++)
+            if (hi[k] > lo[k])
+                set[i]->rank += (set[i]->score[k] - lo[k]) / (hi[k] - lo[k]);
+    }
+    qsort(set, n, sizeof(*set), by_rank);
+
+    printf("rank");
+    for (k = 0; k < NUM_PARAMS; k++)
+        printf("\t%s", param_names[k]);
+    for (k = 0; k < num_scores; k++)
+        printf("\t%s", names[k]);
+    printf("\n");
+    for (i = 0; i < n; i++) {
+        printf("%d", i + 1);
+        for (k = 0; k < NUM_PARAMS; k++)
+            printf("\t%d", set[i]->param[k]);
+        for (k = 0; k < num_scores; k++)
+            printf("\t%.1f", set[i]->score[k]);
+        printf("\n");
+    }
+    free(set);
+}
+
+/**
+ * @brief Write all runs to @p file as CSV.
+ */
+static void write_csv(const char *file, const char *const *names)
+{
+    FILE *f = fopen(file, "w");
+    int i, k;
+
+    if (f == NULL) {
+        perror(file);
+        return;
+    }
+    for (k = 0; k < NUM_PARAMS; k++)
+        fprintf(f, "%s,", param_names[k]);
+    for (k = 0; k < num_scores; k++)
+        fprintf(f, "%s,", names[k]);
+    fprintf(f, "done,valid,front\n");
+    for (i = 0; i < num_runs; i++) {
+        for (k = 0; k < NUM_PARAMS; k++)
+            fprintf(f, "%d,", runs[i].param[k]);
+        for (k = 0; k < num_scores; k++)
+            fprintf(f, "%.2f,", runs[i].score[k]);
+        fprintf(f, "%d,%d,%d\n", runs[i].done, runs[i].valid, runs[i].front);
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+    range_t range[NUM_PARAMS] = {
+        [P_GAIN] = { 80, 240, 40 },
+        [I_GAIN] = { 0, 3, 1 },
+        [D_GAIN] = { 0, 1500, 500 },
+        [FF] = { OUT_FF_DEFAULT, OUT_FF_DEFAULT, 1 },
+        [COAST] = { 35, 55, 10 },
+        [OFFSET] = { 0, 0, 1 },
+        [WINDOW] = { -1, -1, 1 }, // -1: time of the profile (below)
+    };
+    const char *csv_file = NULL;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN), opt, i, k;
+
+    while ((opt = getopt(argc, argv, "bft:d:m:p:n:s:j:o:P:I:D:F:c:T:w:h")) != -1) {
+        int param = -1;
+        switch (opt) {
+            case 'b': bake = 1; break;
+            case 'f': jumper = 1; break;
+            case 't': bake_temp = atoi(optarg); break;
+            case 'd': bake_time = atof(optarg); break;
+            case 'm': mass = atof(optarg); break;
+            case 'p': power = atof(optarg); break;
+            case 'n': noise = atof(optarg); break;
+            case 's': noise_seed = strtoul(optarg, NULL, 0); break;
+            case 'j': jobs = atoi(optarg); break;
+            case 'o': csv_file = optarg; break;
+            case 'P': param = P_GAIN; break;
+            case 'I': param = I_GAIN; break;
+            case 'D': param = D_GAIN; break;
+            case 'F': param = FF; break;
+            case 'c': param = COAST; break;
+            case 'T': param = OFFSET; break;
+            case 'w': param = WINDOW; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+        if (param >= 0 && (!parse_range(optarg, &range[param]) ||
+                           (param == FF && (range[FF].from < 0 || range[FF].to > OUT_MAX)))) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (jobs < 1)
+        jobs = 1;
+    if (range[WINDOW].from < 0) {
+        const profile_t *p = &profiles[jumper ? PROFILE_LEAD_FREE : PROFILE_LEADED];
+        int seg = find_seg(p, SEG_EXIT_ABOVE_OR_TIME);
+        range[WINDOW].from = range[WINDOW].to = seg >= 0 ? p->segs[seg].time : 0;
+    }
+    if (bake) {
+        // the reflow parameters do not affect a bake
+        for (k = COAST; k < NUM_PARAMS; k++)
+            range[k].to = range[k].from;
+    }
+
+    num_runs = 1;
+    for (k = 0; k < NUM_PARAMS; k++)
+        num_runs *= (range[k].to - range[k].from) / range[k].step + 1;
+
+    runs = mmap(NULL, num_runs * sizeof(*runs), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (runs == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    for (i = 0; i < num_runs; i++) {
+        int rest = i;
+        for (k = NUM_PARAMS - 1; k >= 0; k--) {
+            int n = (range[k].to - range[k].from) / range[k].step + 1;
+            runs[i].param[k] = range[k].from + rest % n * range[k].step;
+            rest /= n;
+        }
+    }
+
+    const char *const *names = bake ? bake_scores : reflow_scores;
+    num_scores = bake ? 3 : 4;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    simulate_all(jobs);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    int valid = 0;
+    for (i = 0; i < num_runs; i++)
+        valid += runs[i].valid;
+    sort_fronts();
+    write_front(names);
+    if (csv_file != NULL)
+        write_csv(csv_file, names);
+
+    fprintf(stderr, "simulated %d runs in %.1f s on %d processes (%.1f runs/s), "
+            "%d ranked\n", num_runs, wall, jobs, num_runs / wall, valid);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file telem-dec.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Convert a captured telemetry stream to CSV
+ *
+ * Reads the binary records sent by the firmware (see telem.h) from a file
+ * or stdin and writes one CSV line per valid record to stdout. Frames that
+ * are damaged (e.g. because the capture started within a frame) are
+ * skipped and counted.
+ */
+#include "telem.h"
+
+#include <stdio.h>
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    uint8_t frame[256];
+    unsigned len = 0, good = 0, bad = 0;
+    int c;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1] != 0)) {
+        fprintf(stderr, "usage: %s [FILE]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2 && argv[1][0] != '-' && (in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    printf("time,hot,rate,cold,setpoint,p,i,d,out,mode,phase,flags,"
+           "ramp_up,ramp_down,peak,tal,near_peak,soak,verdict,stack,ram_free\n");
+
+    while ((c = fgetc(in)) != EOF) {
+        if (c != 0) {
+            if (len < sizeof(frame))
+                frame[len] = c;
+            len++;
+            continue;
+        }
+
+        telem_rec_t rec;
+        if (len > 0 && len <= TELEM_FRAME_MAX && telem_decode(frame, len, &rec) == 0) {
+            printf("%.3f,%.2f,%.2f,%.4f,%.2f,%d,%d,%d,%u,%u,%u,%u,%.1f,%.1f,%.2f,%u,%u,%u,%u,%u,%u\n",
+                   rec.time / 1000., rec.hot / 4., rec.rate / 100., rec.cold / 16., rec.setpoint / 4.,
+                   rec.p, rec.i, rec.d, rec.out, rec.mode, rec.phase, rec.flags,
+                   rec.ramp_up / 10., rec.ramp_down / 10., rec.peak / 4., rec.tal,
+                   rec.near_peak, rec.soak, rec.verdict, rec.stack, rec.ram_free);
+            good++;
+        } else if (len > 0)
+            bad++;
+        len = 0;
+    }
+    if (len > 0)
+        bad++;
+
+    fprintf(stderr, "%u records, %u damaged frames\n", good, bad);
+    if (in != stdin)
+        fclose(in);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file test-ana.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the check of a reflow against its profile
+ *
+ * Synthetic processes made of linear segments are fed to ana.c as
+ * readings every 100 ms, quantized to 0.25 degC like the MAX31855K, and
+ * checked against the limits of the Sn63Pb37 profile. A process within all
+ * limits has to pass with the ramp rates, the peak temperature, the time
+ * above liquidus, the time near the peak and the soak time it was made
+ * of; each variant breaks one limit and has to fail with that one alone.
+ */
+#include <math.h>
+
+#include "ana.h"
+#include "profile.h"
+#include "check.h"
+
+#define DT 100 // time between two readings (ms)
+
+typedef struct {
+    double secs, temp; // duration and temperature at the end of the segment
+    uint8_t soak;      // in the soak zone
+} seg_t;
+
+#define END { 0, 0, 0 }
+
+/**
+ * @brief Feed the process @p segs starting at 25 degC and get the result.
+ */
+static uint8_t run(const seg_t *segs, ana_result_t *res)
+{
+    double temp = 25, t;
+
+    ana_start(PROFILE_LEADED);
+    for (; segs->secs > 0; segs++) {
+        double rate = (segs->temp - temp) / segs->secs;
+        for (t = DT / 1000.; t <= segs->secs + 1e-9; t += DT / 1000.)
+            ana_update(lround((temp + rate * t) * 4), DT, segs->soak);
+        temp = segs->temp;
+    }
+    return ana_result(res);
+}
+
+/**
+ * @brief Check that @p val is within 1 of @p want (a time in whole
+ * seconds).
+ */
+#define CHECK_SECS(val, want) CHECK(fabs((val) - (want)) <= 1)
+
+int main()
+{
+    ana_result_t res;
+
+    // within all limits: 1.5 degC/s to 145 degC, 100 s soak to 160 degC,
+    // 2 degC/s to 220 degC, 40 s up to the peak of 230 degC and 3 degC/s
+    // down
+    static const seg_t good[] = {
+        { 80, 145, 0 }, { 100, 160, 1 }, { 30, 220, 0 }, { 40, 230, 0 }, { 60, 50, 0 }, END
+    };
+    CHECK_EQ(run(good, &res), 0);
+    CHECK_EQ(res.ramp_up, 20);
+    CHECK_EQ(res.ramp_down, 30);
+    CHECK_EQ(res.peak, 230 * 4);
+    CHECK_SECS(res.tal, 18.5 + 40 + 47 / 3.);
+    CHECK_SECS(res.near_peak, 20 + 5 / 3.);
+    CHECK_SECS(res.soak, 100);
+
+    // before the peak the result is preliminary
+    static const seg_t rising[] = { { 80, 145, 0 }, { 100, 160, 1 }, { 30, 220, 0 }, END };
+    CHECK_EQ(run(rising, &res), ANA_F_TAL);
+    CHECK_EQ(res.peak, 220 * 4);
+    CHECK_SECS(res.tal, 18.5);
+
+    // ramp-up at 4 degC/s
+    static const seg_t fast_up[] = {
+        { 80, 145, 0 }, { 100, 160, 1 }, { 15, 220, 0 }, { 40, 230, 0 }, { 60, 50, 0 }, END
+    };
+    CHECK_EQ(run(fast_up, &res), ANA_F_RAMP_UP);
+    CHECK_EQ(res.ramp_up, 40);
+
+    // ramp-down at 8 degC/s
+    static const seg_t fast_down[] = {
+        { 80, 145, 0 }, { 100, 160, 1 }, { 30, 220, 0 }, { 40, 230, 0 }, { 22.5, 50, 0 }, END
+    };
+    CHECK_EQ(run(fast_down, &res), ANA_F_RAMP_DOWN);
+    CHECK_EQ(res.ramp_down, 80);
+
+    // peak of 245 degC
+    static const seg_t hot[] = {
+        { 80, 145, 0 }, { 100, 160, 1 }, { 30, 220, 0 }, { 40, 245, 0 }, { 65, 50, 0 }, END
+    };
+    CHECK_EQ(run(hot, &res), ANA_F_PEAK);
+    CHECK_EQ(res.peak, 245 * 4);
+    CHECK_SECS(res.near_peak, 8 + 5 / 3.);
+
+    // 180 s above liquidus, from a slow ramp
+    static const seg_t long_tal[] = {
+        { 80, 145, 0 }, { 100, 160, 1 }, { 15, 190, 0 }, { 140, 225, 0 }, { 20, 230, 0 },
+        { 60, 50, 0 }, END
+    };
+    CHECK_EQ(run(long_tal, &res), ANA_F_TAL);
+    CHECK_SECS(res.tal, 3.5 + 140 + 20 + 47 / 3.);
+
+    // 50 s within 5 degC of the peak (and 1.25 s for the rounding of the
+    // readings to 0.25 degC at 0.1 degC/s)
+    static const seg_t long_peak[] = {
+        { 80, 145, 0 }, { 100, 160, 1 }, { 30, 220, 0 }, { 100, 230, 0 }, { 60, 50, 0 }, END
+    };
+    CHECK_EQ(run(long_peak, &res), ANA_F_NEAR_PEAK);
+    CHECK_SECS(res.near_peak, 50 + 1.25 + 5 / 3.);
+
+    // 30 s soak
+    static const seg_t short_soak[] = {
+        { 80, 145, 0 }, { 30, 160, 1 }, { 30, 220, 0 }, { 40, 230, 0 }, { 60, 50, 0 }, END
+    };
+    CHECK_EQ(run(short_soak, &res), ANA_F_SOAK);
+    CHECK_SECS(res.soak, 30);
+
+    return check_done("test-ana");
+}
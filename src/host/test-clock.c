@@ -0,0 +1,70 @@
+/**
+ * @file test-clock.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the timing constants of clock.h
+ *
+ * Built once for each supported @c F_CPU (see the Makefile). The register
+ * values of clock.h are decoded as the ATxmega32A4U does (prescaler
+ * selections, PER + 1 counts per timer period, BSEL and BSCALE) and the
+ * resulting PWM period, tick rate, SPI clock and baud rate are checked:
+ * the PWM period is the nominal 1.966 s at the finest prescaler that fits,
+ * the tick rate is exactly @c HAL_TICK_HZ , the SPI clock is the fastest
+ * one within the limit of the MAX31855K and the baud rate is within 1 %.
+ */
+#include <math.h>
+
+#include "hal.h"
+#include "clock.h"
+#include "check.h"
+
+// prescaler of each CLKSEL value of the timer CTRLA register
+static const unsigned timer_div[8] = { 0, 1, 2, 4, 8, 64, 256, 1024 };
+
+int main()
+{
+    unsigned long per, spi_div;
+    int bscale;
+    unsigned bsel;
+    double baud;
+
+    // heater PWM: the nominal period, no finer prescaler fits
+    per = CLOCK_PER(CLOCK_PWM_PERIOD);
+    CHECK(per >= 1 && per <= 0xffff);
+    CHECK_EQ(timer_div[CLOCK_PWM_CTRLA], CLOCK_PWM_DIV);
+    CHECK_EQ((per + 1) * CLOCK_PWM_DIV * 6250, F_CPU * 12288);
+    if (CLOCK_PWM_DIV > 64)
+        CHECK(F_CPU / 6250 * 12288 / timer_div[CLOCK_PWM_CTRLA - 1] - 1 > 0xffff);
+    CHECK(CLOCK_PER(HAL_PWM_PERIOD) >= 1 && CLOCK_PER(HAL_PWM_PERIOD) <= 0xffff);
+
+    // update timer: exactly HAL_TICK_HZ
+    per = CLOCK_PER(CLOCK_TICK_PERIOD(HAL_TICK_HZ));
+    CHECK(per <= 0xffff);
+    CHECK_EQ(timer_div[CLOCK_TICK_CTRLA], CLOCK_TICK_DIV);
+    CHECK_EQ((per + 1) * CLOCK_TICK_DIV * HAL_TICK_HZ, F_CPU);
+
+    // SPI: PRESCALER bits select clk / 4, 16, 64 or 128, CLK2X doubles it
+    spi_div = (unsigned[]){ 4, 16, 64, 128 }[CLOCK_SPI_CTRL & 3] >> (CLOCK_SPI_CTRL >> 7);
+    CHECK_EQ(spi_div, CLOCK_SPI_DIV);
+    CHECK(F_CPU / spi_div <= CLOCK_SPI_MAX);
+    CHECK(spi_div == 2 || F_CPU / (spi_div / 2) > CLOCK_SPI_MAX);
+
+    // USART: baud = F_CPU / (16 * (BSEL / 2^-BSCALE + 1)) for BSCALE <= 0
+    bsel = CLOCK_BAUDCTRLA | (CLOCK_BAUDCTRLB & 0xf) << 8;
+    bscale = (CLOCK_BAUDCTRLB >> 4) - (CLOCK_BAUDCTRLB & 0x80 ? 16 : 0);
+    CHECK(bscale <= 0 && bscale >= -7);
+    CHECK_EQ(bsel, CLOCK_BSEL);
+    baud = F_CPU / (16 * (ldexp(bsel, bscale) + 1));
+    CHECK(fabs(baud / CLOCK_BAUD - 1) < 0.01);
+    CHECK(fabs(baud * 100 - CLOCK_BAUD_ACTUAL) < 1);
+    // the finest resolution that fits into BSEL: the next finer one does not
+    if (bscale > -7)
+        CHECK(lround(ldexp(F_CPU / (16. * CLOCK_BAUD) - 1, 1 - bscale)) >= 4096);
+
+    printf("test-clock: F_CPU %lu Hz: PWM %lu counts at 1/%u, tick %lu counts at 1/%u, "
+           "SPI 1/%lu, %.0f baud (%+.2f %%)\n", F_CPU, CLOCK_PER(CLOCK_PWM_PERIOD) + 1,
+           CLOCK_PWM_DIV, CLOCK_PER(CLOCK_TICK_PERIOD(HAL_TICK_HZ)) + 1, CLOCK_TICK_DIV,
+           spi_div, baud, (baud / CLOCK_BAUD - 1) * 100);
+    return check_done("test-clock");
+}
@@ -0,0 +1,227 @@
+/**
+ * @file test-cmd.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Fuzz test of the command input of the simulated firmware
+ *
+ * The firmware runs against the simulated hardware (see hal_host.h), which
+ * receives one character per millisecond, faster than the command task
+ * reads them. Lines of the maximum length, overlong lines and floods of
+ * random bytes are sent; the firmware has to handle at most
+ * @c CMD_RUN_LINES lines per tick, stay idle with current readings, report
+ * the lost characters (with "error: input lost", or the telemetry flag)
+ * and answer a command once the flood is over. Profile names that the
+ * SerLCD would take for commands are rejected.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_host.h"
+#include "hal.h"
+#include "oven.h"
+#include "cmd.h"
+#include "uart.h"
+#include "check.h"
+#ifdef USE_TELEMETRY
+#include "telem.h"
+#endif
+
+#define STEP 0.001 // simulation time step (s)
+
+static char *out;     // serial output
+static size_t out_len, seen;
+
+static void run(double secs)
+{
+    double end = hal_host_time() + secs;
+    while (hal_host_time() < end) {
+        hal_host_step(STEP);
+        oven_poll();
+    }
+}
+
+/**
+ * @brief Count @p s in the serial output since the last call.
+ */
+static unsigned count(FILE *sink, const char *s)
+{
+    unsigned n = 0;
+    char *p;
+
+    fflush(sink);
+    for (p = out + seen; (p = memmem(p, out + out_len - p, s, strlen(s))) != NULL; p++)
+        n++;
+    return n;
+}
+
+static void next(FILE *sink)
+{
+    fflush(sink);
+    seen = out_len;
+}
+
+/**
+ * @brief Number of replies in the serial output since the last call.
+ */
+static unsigned replies(FILE *sink)
+{
+    unsigned n = count(sink, "ok\r\n") + count(sink, "ok ") + count(sink, "error: ");
+    next(sink);
+    return n;
+}
+
+/**
+ * @brief Run for @p secs seconds and get the largest number of replies
+ * sent in one step (the command task runs at most once per step).
+ */
+static unsigned run_replies(FILE *sink, double secs)
+{
+    double end = hal_host_time() + secs;
+    unsigned most = 0;
+    while (hal_host_time() < end) {
+        hal_host_step(STEP);
+        oven_poll();
+        unsigned r = replies(sink);
+        if (r > most)
+            most = r;
+    }
+    return most;
+}
+
+/**
+ * @brief Send "status" and check the reply (none in the telemetry build).
+ */
+static void check_status(FILE *sink)
+{
+    next(sink);
+    hal_host_uart_rx("status\n");
+    run(0.3);
+#ifdef USE_TELEMETRY
+    CHECK_EQ(replies(sink), 0);
+#else
+    int mode, power, bake_temp, end = 0;
+    unsigned phase, profile, flags, bake_time;
+    unsigned long time;
+    float temp, sp;
+    char *p;
+
+    CHECK_EQ(count(sink, "ok mode=0 "), 1);
+    p = memmem(out + seen, out_len - seen, "ok mode=", 8);
+    CHECK(p != NULL && sscanf(p, "ok mode=%d phase=%u profile=%u flags=%u temp=%f sp=%f out=%d "
+                              "time=%lu bake_temp=%d bake_time=%u\r\n%n", &mode, &phase, &profile,
+                              &flags, &temp, &sp, &power, &time, &bake_temp, &bake_time, &end) == 10);
+    CHECK(end > 0);
+    CHECK_EQ(replies(sink), 1);
+#endif
+}
+
+int main()
+{
+    plant_t plant;
+    FILE *sink = open_memstream(&out, &out_len);
+    char buf[4000];
+    unsigned i, n, most = 0;
+    oven_status_t st;
+
+    srand(1);
+    plant_init(&plant);
+    plant.zones = HAL_PWM_CHANNELS > HAL_SPI_DEVICES ? HAL_PWM_CHANNELS : HAL_SPI_DEVICES;
+    hal_host_init(&plant, sink, 0.25, 1);
+    oven_init();
+    run(0.5);
+    check_status(sink);
+
+    // a line of the maximum length fits into the receive buffer with its
+    // line end, a longer one is rejected
+    memset(buf, ' ', CMD_LINE_MAX);
+    memcpy(buf, "status", 6);
+    strcpy(buf + CMD_LINE_MAX, "\r\n");
+    hal_host_uart_rx(buf);
+    run(0.3);
+#ifndef USE_TELEMETRY
+    CHECK_EQ(count(sink, "ok mode=0 "), 1);
+#endif
+    next(sink);
+    memset(buf, 'x', CMD_LINE_MAX + 1);
+    strcpy(buf + CMD_LINE_MAX + 1, "\n");
+    hal_host_uart_rx(buf);
+    run(0.3);
+#ifndef USE_TELEMETRY
+    CHECK_EQ(count(sink, "error: line too long"), 1);
+#endif
+    CHECK_EQ(uart_rx_dropped(), 0);
+    next(sink);
+
+    // floods of random bytes and of overlong lines, much faster than they
+    // are read
+    for (n = 0; n < 20; n++) {
+        unsigned len = n % 2 ? sizeof(buf) - 1 : 1 + rand() % 500;
+        for (i = 0; i < len; i++) {
+            if (n % 4 == 3)
+                buf[i] = i % 300 == 299 ? '\n' : 'a' + i % 26;
+            else
+                buf[i] = rand() % 8 == 0 ? '\n' : 1 + rand() % 255;
+        }
+        buf[len] = 0;
+        hal_host_uart_rx(buf);
+        unsigned r = run_replies(sink, len * STEP + 1.);
+        if (r > most)
+            most = r;
+        CHECK_EQ(oven_mode(), OVEN_MODE_IDLE);
+    }
+    printf("test-cmd: %u characters lost, at most %u replies per tick\n",
+           uart_rx_dropped(), most);
+    CHECK(uart_rx_dropped() > 0);
+    CHECK(most <= CMD_RUN_LINES);
+
+    // the readings have gone on
+    oven_status(&st);
+    CHECK_EQ(st.flags, 0);
+    CHECK(st.temp > 15 * 4 && st.temp < 35 * 4);
+
+    // the lost characters have been reported
+#ifdef USE_TELEMETRY
+    unsigned flagged = 0;
+    char *p, *end;
+    fflush(sink);
+    for (p = out; (end = memchr(p, 0, out + out_len - p)) != NULL; p = end + 1) {
+        telem_rec_t rec;
+        if (telem_decode((uint8_t *)p, end - p, &rec) == 0 && (rec.flags & TELEM_F_RX_LOST))
+            flagged++;
+    }
+    CHECK(flagged > 0);
+#else
+    seen = 0;
+    CHECK(count(sink, "error: input lost\r\n") > 0);
+    next(sink);
+#endif
+
+    // and the commands are answered again once the flood is over
+    hal_host_uart_rx("\n");
+    run(0.3);
+    check_status(sink);
+
+    // profile names with characters the SerLCD would take for commands are
+    // rejected
+    next(sink);
+    hal_host_uart_rx("upload a|b 217\n");
+    run(0.3);
+    hal_host_uart_rx("upload a\033b 217\n");
+    run(0.3);
+    hal_host_uart_rx("upload Test-1 217\n");
+    run(0.3);
+    hal_host_uart_rx("profile\n");
+    run(0.3);
+#ifndef USE_TELEMETRY
+    CHECK_EQ(count(sink, "error: invalid name\r\n"), 2);
+    CHECK_EQ(count(sink, "ok\r\n"), 1);
+    CHECK_EQ(count(sink, "ok profile=0 name=Sn63Pb37"), 1);
+    next(sink);
+#endif
+
+    fclose(sink);
+    free(out);
+    return check_done("test-cmd");
+}
@@ -0,0 +1,124 @@
+/**
+ * @file test-coast.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the overshoot prediction
+ *
+ * coast.c and nvm.c run against an EEPROM image in RAM. The prediction has
+ * to follow the model of coast.h, the coast gain has to be learned once per
+ * cut-off (only from cut-offs fast enough to measure, and clamped), stored
+ * and loaded again, with the default after an erased or corrupted record.
+ * Repeated reflows of an oven that overshoots by a fixed lag time have to
+ * make the gain converge to that lag.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coast.h"
+#include "nvm.h"
+#include "hal.h"
+#include "check.h"
+
+static uint8_t eeprom[HAL_EEPROM_SIZE]; // replaces the one of the hardware
+static unsigned writes;                 // calls of hal_eeprom_write()
+
+void hal_eeprom_read(uint16_t addr, void *buf, uint16_t len)
+{
+    memcpy(buf, eeprom + addr, len);
+}
+
+void hal_eeprom_write(uint16_t addr, const void *buf, uint16_t len)
+{
+    memcpy(eeprom + addr, buf, len);
+    writes++;
+}
+
+/**
+ * @brief Cut off at @p temp (degC * 4) and rate @p rate (0.01 degC/s), then
+ * feed readings rising by @p over (degC * 4) in steps of 1 and falling
+ * again by @p drop .
+ */
+static void coast(int temp, int rate, int over, int drop)
+{
+    int t;
+
+    coast_cut(temp, rate);
+    for (t = temp; t <= temp + over; t++)
+        coast_update(t);
+    for (t = temp + over; t >= temp + over - drop; t--)
+        coast_update(t);
+}
+
+int main()
+{
+    uint16_t gain;
+    unsigned run;
+    int rate;
+
+    // erased EEPROM: the default
+    memset(eeprom, 0xff, sizeof(eeprom));
+    coast_gain = 0;
+    coast_init();
+    CHECK_EQ(coast_gain, COAST_GAIN);
+
+    // prediction: rate * (gain + dt / 2) on top of the temperature
+    CHECK_EQ(coast_predict(800, 0, 1000), 800);
+    CHECK_EQ(coast_predict(800, -50, 1000), 800);
+    CHECK_EQ(coast_predict(800, 100, 1000), 800 + 20);
+    for (rate = 1; rate <= 500; rate++) {
+        double over = rate / 100. * (COAST_GAIN / 10. + 0.5) * 4;
+        if (!CHECK(fabs(coast_predict(800, rate, 1000) - 800 - over) <= 0.5 + 1e-9))
+            break;
+    }
+
+    // a cut-off below 0.2 degC/s is not measured
+    coast(800, 19, 40, 20);
+    CHECK_EQ(coast_gain, COAST_GAIN);
+    CHECK_EQ(writes, 0);
+
+    // 5 degC overshoot at 1 degC/s: the 5 s lag is averaged with the
+    // default once the temperature has dropped 2 degC below the peak
+    coast(800, 100, 20, 7);
+    CHECK_EQ(coast_gain, COAST_GAIN);
+    coast_update(820 - 8);
+    CHECK_EQ(coast_gain, (50 + COAST_GAIN + 1) / 2);
+    CHECK(writes > 0);
+
+    // once per cut-off
+    writes = 0;
+    coast_update(900);
+    coast_update(800);
+    CHECK_EQ(coast_gain, (50 + COAST_GAIN + 1) / 2);
+    CHECK_EQ(writes, 0);
+
+    // stored and loaded again
+    gain = coast_gain;
+    coast_gain = 0;
+    coast_init();
+    CHECK_EQ(coast_gain, gain);
+
+    // clamped to 60 s
+    coast(800, 20, 1000, 8);
+    coast(800, 20, 1000, 8);
+    CHECK_EQ(coast_gain, 600);
+    CHECK(nvm_load(NVM_COAST, 1, &gain, sizeof(gain)));
+    CHECK_EQ(gain, 600);
+
+    // a corrupted record is not used
+    eeprom[NVM_COAST + 1] ^= 1;
+    coast_init();
+    CHECK_EQ(coast_gain, COAST_GAIN);
+
+    // converges to the lag of the oven (12 s) within a few runs, whatever
+    // the rate at the cut-off
+    for (run = 0; run < 8; run++) {
+        rate = 60 + 40 * (run % 3);
+        coast(700 + run, rate, lround(rate * 120 / 250.), 8);
+    }
+    printf("test-coast: gain %u after %u runs with a 12 s lag\n", coast_gain, run);
+    CHECK(abs(coast_gain - 120) <= 2);
+
+    return check_done("test-coast");
+}
@@ -0,0 +1,138 @@
+/**
+ * @file test-est.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the alpha-beta filter
+ *
+ * Feeds the filter with readings of a step and a ramp of the temperature,
+ * without noise and with the thermocouple noise of the simulation (see
+ * @c hal_host_noise() ), quantized to 0.25 degC like the MAX31855K. The
+ * settling time after a step and a change of the rate, the tracking of a
+ * ramp and the standard deviation of the filtered temperature and rate are
+ * checked against the figures given in est.h.
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "est.h"
+#include "hal_host.h"
+#include "check.h"
+
+#define N (EST_HZ * 600) // readings of the noise runs
+
+/**
+ * @brief Reading of the temperature @p t (degC) with noise.
+ */
+static int reading(double t)
+{
+    return lround((t + hal_host_noise()) * 4);
+}
+
+/**
+ * @brief Seconds after which @p value stays within @p tol of @p target ,
+ * with the reading @p k fed at each step.
+ */
+static double settle(int (*value)(), int target, int tol, double (*temp)(int), int n)
+{
+    int k, last_out = -1;
+    for (k = 0; k < n; k++) {
+        est_update(lround(temp(k) * 4));
+        if (abs(value() - target) > tol)
+            last_out = k;
+    }
+    return (last_out + 1.) / EST_HZ;
+}
+
+static double step(int k)
+{
+    return k < 1 ? 100. : 110.;
+}
+
+static double ramp(int k)
+{
+    return 100. + 2. * k / EST_HZ;
+}
+
+/**
+ * @brief Feed @c N readings of @p temp with noise and get the standard
+ * deviation of the error of the readings and the filtered temperature
+ * (degC), the one of the rate from @p rate and the mean rate (degC/s),
+ * after 10 s of settling.
+ */
+static void noise_run(double (*temp)(int), double rate, double *sd_raw, double *sd_temp,
+                      double *sd_rate, double *mean_rate)
+{
+    double sq_raw = 0, sum_t = 0, sum_r = 0, sq_t = 0, sq_r = 0;
+    int k, m = 0;
+
+    est_reset();
+    for (k = 0; k < N; k++) {
+        int z = reading(temp(k));
+        est_update(z);
+        if (k < 10 * EST_HZ)
+            continue;
+        sq_raw += (z / 4. - temp(k)) * (z / 4. - temp(k));
+        double et = est_temp() / 4. - temp(k), r = est_rate() / 100.;
+        sum_t += et;
+        sq_t += et * et;
+        sum_r += r;
+        sq_r += (r - rate) * (r - rate);
+        m++;
+    }
+    *sd_raw = sqrt(sq_raw / m);
+    *sd_temp = sqrt(sq_t / m - (sum_t / m) * (sum_t / m));
+    *sd_rate = sqrt(sq_r / m);
+    *mean_rate = sum_r / m;
+}
+
+int main()
+{
+    double t_step, t_rate, sd_raw, sd_t, sd_r, mean_r;
+
+    // no noise: a step of 10 degC settles to 0.25 degC within 5.5 s and
+    // the rate back to 0 within 0.1 degC/s within 8 s
+    hal_host_init(NULL, NULL, 0., 1);
+    est_reset();
+    t_step = settle(est_temp, 110 * 4, 1, step, 60 * EST_HZ);
+    est_reset();
+    t_rate = settle(est_rate, 0, 10, step, 60 * EST_HZ);
+    printf("test-est: step of 10 degC settled after %.1f s, its rate after %.1f s\n",
+           t_step, t_rate);
+    CHECK(t_step <= 5.5);
+    CHECK(t_rate <= 8.);
+
+    // a ramp of 2 degC/s is tracked without lag, its rate found within
+    // about 4 s
+    est_reset();
+    t_rate = settle(est_rate, 200, 10, ramp, 60 * EST_HZ);
+    printf("test-est: rate of a ramp of 2 degC/s found after %.1f s\n", t_rate);
+    CHECK(t_rate <= 5.);
+    CHECK(abs(est_temp() - (int)lround(ramp(60 * EST_HZ - 1) * 4)) <= 1);
+
+    // with 0.5 degC of noise, the filtered temperature varies by less than
+    // 0.2 degC and the rate by less than 0.1 degC/s, holding or ramping
+    hal_host_init(NULL, NULL, 0.5, 1);
+    noise_run(step, 0., &sd_raw, &sd_t, &sd_r, &mean_r);
+    printf("test-est: 0.5 degC noise, holding: sd %.3f degC (readings %.3f), rate sd %.3f degC/s\n",
+           sd_t, sd_raw, sd_r);
+    CHECK(sd_raw > 0.45);
+    CHECK(sd_t < 0.2);
+    CHECK(sd_r < 0.1);
+    CHECK(fabs(mean_r) < 0.01);
+
+    noise_run(ramp, 2., &sd_raw, &sd_t, &sd_r, &mean_r);
+    printf("test-est: 0.5 degC noise, ramp of 2 degC/s: sd %.3f degC (readings %.3f), "
+           "rate sd %.3f degC/s, mean rate %.3f degC/s\n", sd_t, sd_raw, sd_r, mean_r);
+    CHECK(sd_t < 0.2);
+    CHECK(sd_r < 0.1);
+    CHECK(fabs(mean_r - 2.) < 0.01);
+
+    // a reset restarts the filter at the next reading
+    est_reset();
+    est_update(20 * 4);
+    CHECK_EQ(est_temp(), 20 * 4);
+    CHECK_EQ(est_rate(), 0);
+
+    return check_done("test-est");
+}
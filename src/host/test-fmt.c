@@ -0,0 +1,107 @@
+/**
+ * @file test-fmt.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Exhaustive comparison of the number formatting with snprintf
+ *
+ * Every value of the 16 bit range of the firmware is formatted with each
+ * function of fmt.c and with the equivalent printf format, for all
+ * widths up to 7 and both padding characters, and fmt_uint() with the
+ * 32 bit values around each power of ten and random ones. The temperatures
+ * are exact in binary floating point, so "%.2f" and "%.4f" are exact
+ * references.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmt.h"
+#include "check.h"
+
+static char got[32], want[32];
+static unsigned long compared;
+
+/**
+ * @brief Compare the output ending at @p end with the reference; only the
+ * first mismatch of each function is reported.
+ */
+static int same(const char *end, const char *what, long val, unsigned *failed)
+{
+    compared++;
+    if (end == got + strlen(got) && strcmp(got, want) == 0)
+        return 1;
+    if ((*failed)++ == 0)
+        fprintf(stderr, "%s(%ld): \"%s\" instead of \"%s\"\n", what, val, got, want);
+    return 0;
+}
+
+/**
+ * @brief Compare fmt_uint() for @p u with all widths and padding characters.
+ */
+static void same_uint(unsigned long u, unsigned *failed)
+{
+    int w;
+    for (w = 0; w <= 12; w++) {
+        snprintf(want, sizeof(want), "%*lu", w, u);
+        same(fmt_uint(got, u, w, ' '), "fmt_uint", u, failed);
+        snprintf(want, sizeof(want), "%0*lu", w, u);
+        same(fmt_uint(got, u, w, '0'), "fmt_uint", u, failed);
+    }
+}
+
+int main()
+{
+    unsigned f_int = 0, f_uint = 0, f_t4 = 0, f_t16 = 0, f_hms = 0, f_tenths = 0;
+    unsigned long u, p;
+    long v;
+    int w;
+
+    CHECK(fmt_str(got, "Temp: ") == got + 6 && strcmp(got, "Temp: ") == 0);
+    CHECK(fmt_str(got, "") == got && got[0] == 0);
+
+    for (v = -32768; v <= 32767; v++) {
+        for (w = 0; w <= 7; w++) {
+            snprintf(want, sizeof(want), "%*ld", w, v);
+            same(fmt_int(got, v, w, ' '), "fmt_int", v, &f_int);
+            snprintf(want, sizeof(want), "%0*ld", w, v);
+            same(fmt_int(got, v, w, '0'), "fmt_int", v, &f_int);
+
+            snprintf(want, sizeof(want), "%*.2f", w + 3, v / 4.0);
+            same(fmt_temp4(got, v, w), "fmt_temp4", v, &f_t4);
+            snprintf(want, sizeof(want), "%*.4f", w + 5, v / 16.0);
+            same(fmt_temp16(got, v, w), "fmt_temp16", v, &f_t16);
+        }
+    }
+
+    for (v = 0; v <= 65535; v++) {
+        snprintf(want, sizeof(want), "%2ld:%02ld:%02ld", v / 3600, v / 60 % 60, v % 60);
+        same(fmt_hms(got, v), "fmt_hms", v, &f_hms);
+        for (w = 0; w <= 7; w++) {
+            snprintf(want, sizeof(want), "%*ld.%ld", w, v / 10, v % 10);
+            same(fmt_tenths(got, v, w), "fmt_tenths", v, &f_tenths);
+        }
+    }
+
+    // 32 bit values: all up to 100000, those next to the powers of ten
+    // and the limit, random ones
+    for (u = 0; u < 100000; u++) {
+        snprintf(want, sizeof(want), "%lu", u);
+        same(fmt_uint(got, u, 0, ' '), "fmt_uint", u, &f_uint);
+    }
+    for (p = 1; p <= 1000000000; p *= 10)
+        for (u = p < 50 ? 0 : p - 50; u < p + 50; u++)
+            same_uint(u, &f_uint);
+    for (u = 0xffffffffUL - 1000; u <= 0xffffffffUL; u++)
+        same_uint(u, &f_uint);
+    for (v = 0; v < 1000000; v++)
+        same_uint(((unsigned long)rand() << 16 ^ rand()) & 0xffffffffUL, &f_uint);
+
+    printf("test-fmt: %lu outputs compared\n", compared);
+    CHECK_EQ(f_int, 0);
+    CHECK_EQ(f_uint, 0);
+    CHECK_EQ(f_t4, 0);
+    CHECK_EQ(f_t16, 0);
+    CHECK_EQ(f_hms, 0);
+    CHECK_EQ(f_tenths, 0);
+    return check_done("test-fmt");
+}
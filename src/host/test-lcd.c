@@ -0,0 +1,237 @@
+/**
+ * @file test-lcd.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the incremental updates of the display
+ *
+ * lcd.c writes into a memory stream instead of the serial line. The bytes
+ * of each @c lcd_flush() are counted and interpreted by a model of the
+ * SerLCD (cursor positioning, backlight and clear commands on the DDRAM
+ * layout of the HD44780), whose contents have to match the lines written.
+ *
+ * In the LCD build, the firmware then runs a reflow and a bake against the
+ * simulated oven (see hal_host.h), and the serial output of the real
+ * screens goes through the model: the bytes per display update (once per
+ * second) are compared with the 88 of redrawing the whole screen.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "lcd.h"
+#include "uart.h"
+#include "check.h"
+#ifdef USE_LCD_DISP
+#include "hal_host.h"
+#include "oven.h"
+#endif
+
+#define STEP 0.001 // simulation time step (s)
+#define FULL 88    // bytes of a full redraw: clear, 4 lines, backlight
+
+static FILE *stream;                // replaces the serial line
+static char *out;                   // bytes written to it so far
+static size_t out_len, out_read;    // and how many of them the model saw
+
+static const uint8_t row_addr[LCD_ROWS] = { 0, 64, 20, 84 };
+
+static char ddram[128];             // model of the display
+static uint8_t addr, bl[3];
+
+/**
+ * @brief Feed the bytes sent since the last call to the model; returns
+ * their number.
+ */
+static size_t model()
+{
+    fflush(stream);
+    size_t n = out_len - out_read;
+
+    while (out_read < out_len) {
+        uint8_t c = out[out_read++];
+        if (c == 254) {
+            c = out[out_read++];
+            if (c >= 128)
+                addr = c - 128;
+        } else if (c == '|') {
+            c = out[out_read++];
+            if (c == '-') {
+                memset(ddram, ' ', sizeof(ddram));
+                addr = 0;
+            } else if (c >= 128 && c < 218) {
+                bl[(c - 128) / 30] = (c - 128) % 30;
+            }
+        } else {
+            ddram[addr & 127] = c;
+            addr++;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Check whether the model shows the lines @p lines .
+ */
+static int shows(char lines[LCD_ROWS][LCD_COLS + 1])
+{
+    uint8_t r;
+    for (r = 0; r < LCD_ROWS; r++)
+        if (memcmp(ddram + row_addr[r], lines[r], LCD_COLS) != 0)
+            return 0;
+    return 1;
+}
+
+static int write_all(char lines[LCD_ROWS][LCD_COLS + 1])
+{
+    uint8_t r;
+    lcd_clear();
+    for (r = 0; r < LCD_ROWS; r++)
+        lcd_write(lines[r]);
+    return lcd_flush();
+}
+
+#ifdef USE_LCD_DISP
+/**
+ * @brief Run the firmware in mode @p mode for at most @p secs seconds;
+ * the first line shown has to start with @p title .
+ *
+ * Returns the mean number of bytes sent per display update and stores the
+ * largest one in @p most .
+ */
+static double run_screens(int mode, double secs, const char *title, unsigned *most)
+{
+    double end = hal_host_time() + secs, next = hal_host_time() + 1;
+    unsigned frames = 0, sent = 0, wrong = 0;
+
+    model();
+    CHECK(oven_start(mode));
+    *most = 0;
+    while (hal_host_time() < end && oven_mode() == mode) {
+        hal_host_step(STEP);
+        oven_poll();
+        if (hal_host_time() >= next) {
+            unsigned n = model();
+            if (n > *most)
+                *most = n;
+            sent += n;
+            frames++;
+            // the first update may come before the screen of the mode
+            wrong += frames > 1 && memcmp(ddram, title, strlen(title)) != 0;
+            next += 1;
+        }
+    }
+    CHECK(frames > 0);
+    CHECK_EQ(wrong, 0);
+    oven_abort();
+    while (oven_mode() != OVEN_MODE_IDLE) {
+        hal_host_step(STEP);
+        oven_poll();
+    }
+    return (double)sent / frames;
+}
+#endif
+
+int main()
+{
+    char lines[LCD_ROWS][LCD_COLS + 1];
+    uint8_t r;
+    unsigned i, c;
+
+    uart_file = stream = open_memstream(&out, &out_len);
+    srand(1);
+
+    for (r = 0; r < LCD_ROWS; r++)
+        sprintf(lines[r], "%-*s", LCD_COLS, "");
+
+    lcd_init();
+    CHECK_EQ(model(), 2);
+
+    // the first flush sets the backlight even if nothing else changed
+    CHECK_EQ(lcd_backlight(LCD_BACKLIGHT_MAX, 0, 10), 0);
+    CHECK_EQ(write_all(lines), 6);
+    CHECK_EQ(model(), 6);
+    CHECK(bl[0] == LCD_BACKLIGHT_MAX && bl[1] == 0 && bl[2] == 10);
+    CHECK_EQ(lcd_backlight(31, 0, 0), -1);
+
+    // nothing is sent without a change
+    CHECK_EQ(write_all(lines), 0);
+    CHECK_EQ(model(), 0);
+
+    // a single character costs a cursor positioning command
+    lines[1][5] = 'x';
+    CHECK_EQ(write_all(lines), 3);
+    CHECK_EQ(model(), 3);
+    CHECK(shows(lines));
+
+    // up to two unchanged characters in between are sent again instead of
+    // positioning the cursor, more of them are skipped
+    lines[2][0] = lines[2][3] = 'y';
+    CHECK_EQ(write_all(lines), 6);
+    lines[3][0] = lines[3][4] = 'z';
+    CHECK_EQ(write_all(lines), 6);
+    CHECK_EQ(model(), 12);
+    CHECK(shows(lines));
+
+    // a full redraw costs one positioning command per line
+    for (r = 0; r < LCD_ROWS; r++)
+        for (c = 0; c < LCD_COLS; c++)
+            lines[r][c] = 'A' + r;
+    CHECK_EQ(write_all(lines), LCD_ROWS * (2 + LCD_COLS));
+    CHECK_EQ(model(), LCD_ROWS * (2 + LCD_COLS));
+    CHECK(shows(lines));
+
+    // random sparse and dense changes: the byte count returned is the one
+    // sent, the display shows the lines and no flush costs more than a
+    // full redraw
+    unsigned sent = 0, full = 0;
+    for (i = 0; i < 2000; i++) {
+        unsigned changes = rand() % (i % 2 ? 4 : 40);
+        for (c = 0; c < changes; c++)
+            lines[rand() % LCD_ROWS][rand() % LCD_COLS] = ' ' + rand() % 92; // no '|'
+        if (rand() % 10 == 0)
+            lcd_backlight(rand() % 30, rand() % 30, rand() % 30);
+
+        int n = write_all(lines);
+        size_t m = model();
+        if (!CHECK_EQ(n, m) || !CHECK(shows(lines)) ||
+            !CHECK(n <= 6 + LCD_ROWS * (2 + LCD_COLS)))
+            break;
+        sent += n;
+        full += LCD_ROWS * (2 + LCD_COLS);
+    }
+    printf("test-lcd: %u bytes sent instead of %u for full redraws\n", sent, full);
+
+#ifdef USE_LCD_DISP
+    // the screens of the firmware, from the serial line of the simulation
+    plant_t plant;
+    unsigned most;
+    double mean;
+
+    fclose(stream);
+    free(out);
+    out_read = 0;
+    stream = open_memstream(&out, &out_len);
+    plant_init(&plant);
+    hal_host_init(&plant, stream, 0.25, 1);
+    oven_init();
+    while (hal_host_time() < 2) {
+        hal_host_step(STEP);
+        oven_poll();
+    }
+    model();
+    CHECK(memcmp(ddram, "Solder Reflow Oven", 18) == 0);
+
+    mean = run_screens(OVEN_MODE_REFLOW, 1200, "REFLOW MODE", &most);
+    printf("test-lcd: reflow screen: %.1f bytes per update (at most %u) instead of %u\n",
+           mean, most, FULL);
+    CHECK(mean < FULL / 4);
+    CHECK(most <= FULL);
+    mean = run_screens(OVEN_MODE_BAKE, 600, "BAKING", &most);
+    printf("test-lcd: bake screen: %.1f bytes per update (at most %u) instead of %u\n",
+           mean, most, FULL);
+    CHECK(mean < FULL / 4);
+    CHECK(most <= FULL);
+#endif
+
+    return check_done("test-lcd");
+}
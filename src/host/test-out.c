@@ -0,0 +1,147 @@
+/**
+ * @file test-out.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the heater output stage
+ *
+ * out.c runs against a mocked PWM timer. Every controller output has to
+ * give the duty cycle of the nearest multiple of @c OUT_QUANTUM (clamped to
+ * the PWM period), outputs above @c OUT_MAX are clamped, each zone keeps its
+ * own output and the output stage ignores outputs while it is disabled.
+ * Built a second time with a coarse quantum and @c OUT_DITHER (see the
+ * Makefile), the mean duty cycle over many PWM periods has to be within one
+ * quantum of the exact one instead.
+ */
+#include <math.h>
+
+#include "out.h"
+#include "hal.h"
+#include "check.h"
+
+static uint8_t powered;
+static unsigned sets;                   // calls of hal_pwm_set()
+static uint16_t duty[HAL_PWM_CHANNELS]; // duty cycle written to the timer
+
+void hal_pwm_init()
+{
+}
+
+void hal_pwm_power(uint8_t on)
+{
+    powered = on;
+}
+
+void hal_pwm_set(uint8_t ch, uint16_t d)
+{
+    CHECK(powered);
+    CHECK(ch < HAL_PWM_CHANNELS);
+    CHECK(d <= HAL_PWM_PERIOD);
+    duty[ch] = d;
+    sets++;
+}
+
+/**
+ * @brief Exact duty cycle of the output @p out in timer counts.
+ */
+static double exact(uint16_t out)
+{
+    return (double)out * HAL_PWM_PERIOD / OUT_MAX;
+}
+
+#if OUT_DITHER
+/**
+ * @brief Run the output @p out for @p n PWM periods and check that the mean
+ * duty cycle is within one quantum of the exact one.
+ */
+static void check_mean(uint16_t out, unsigned n)
+{
+    double sum = 0;
+    unsigned i;
+
+    out_set(out);
+    for (i = 0; i < n; i++) {
+        uint16_t latched = duty[0];
+        CHECK_EQ(latched % OUT_QUANTUM == 0 || latched == HAL_PWM_PERIOD, 1);
+        CHECK(fabs(latched - exact(out)) < OUT_QUANTUM);
+        sum += latched;
+        hal_on_pwm_period();
+    }
+    if (!CHECK(fabs(sum - n * exact(out)) < OUT_QUANTUM))
+        fprintf(stderr, "    output %u: %.1f counts in %u periods, not %.1f\n",
+                out, sum, n, n * exact(out));
+}
+#endif
+
+int main()
+{
+    unsigned out;
+    uint8_t z;
+
+    out_init();
+    CHECK_EQ(powered, 0);
+    CHECK_EQ(sets, 0);
+
+    // ignored while disabled
+    out_set(OUT_MAX);
+    CHECK_EQ(sets, 0);
+
+    // enabling starts with the heaters off
+    duty[0] = 1;
+    out_enable(1);
+    CHECK_EQ(powered, 1);
+    CHECK_EQ(sets, HAL_PWM_CHANNELS);
+    for (z = 0; z < HAL_PWM_CHANNELS; z++)
+        CHECK_EQ(duty[z], 0);
+
+#if OUT_DITHER
+    for (out = 0; out <= OUT_MAX; out += 455)
+        check_mean(out, 1000);
+    check_mean(1, 20000);
+    check_mean(OUT_MAX - 1, 1000);
+    check_mean(OUT_MAX, 1000);
+#else
+    // every output rounds to the nearest quantum, and stays there
+    for (out = 0; out <= OUT_MAX; out++) {
+        out_set(out);
+        hal_on_pwm_period();
+        if (!CHECK(fabs(duty[0] - exact(out)) <= OUT_QUANTUM / 2. || duty[0] == HAL_PWM_PERIOD) ||
+            !CHECK(duty[0] % OUT_QUANTUM == 0 || duty[0] == HAL_PWM_PERIOD))
+            break;
+    }
+    out_set(0);
+    CHECK_EQ(duty[0], 0);
+    out_set(OUT_MAX);
+    CHECK_EQ(duty[0], HAL_PWM_PERIOD);
+#endif
+
+    // above the maximum
+    out_set(OUT_MAX + 1);
+    CHECK_EQ(duty[0], HAL_PWM_PERIOD);
+    out_set(0xffff);
+    hal_on_pwm_period();
+    CHECK_EQ(duty[0], HAL_PWM_PERIOD);
+
+    // the zones are independent
+    out_set(0);
+    out_set_zone(HAL_PWM_CHANNELS - 1, OUT_MAX);
+    hal_on_pwm_period();
+    for (z = 0; z < HAL_PWM_CHANNELS - 1; z++)
+        CHECK_EQ(duty[z], 0);
+    CHECK_EQ(duty[HAL_PWM_CHANNELS - 1], HAL_PWM_PERIOD);
+
+    // disabling switches off and powers down, and outputs are ignored
+    out_enable(0);
+    CHECK_EQ(powered, 0);
+    sets = 0;
+    out_set(OUT_MAX);
+    CHECK_EQ(sets, 0);
+    out_enable(1);
+    for (z = 0; z < HAL_PWM_CHANNELS; z++)
+        CHECK_EQ(duty[z], 0);
+    hal_on_pwm_period();
+    for (z = 0; z < HAL_PWM_CHANNELS; z++)
+        CHECK_EQ(duty[z], 0);
+
+    return check_done(OUT_DITHER ? "test-out (dither)" : "test-out");
+}
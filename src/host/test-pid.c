@@ -0,0 +1,163 @@
+/**
+ * @file test-pid.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the saturation of the PID controller
+ *
+ * Drives the controller with the extremes of its inputs (set points and
+ * measurements at the ends of the int16_t range, the largest gains and
+ * time steps) and checks that every result saturates in the right
+ * direction instead of wrapping around, that the output stays within its
+ * limits and that the integral does not wind up while the output is
+ * limited.
+ */
+#include <stdlib.h>
+
+#include "pid.h"
+#include "check.h"
+
+static int16_t rand16()
+{
+    switch (rand() % 4) {
+    case 0:
+        return INT16_MAX - rand() % 4;
+    case 1:
+        return INT16_MIN + rand() % 4;
+    default:
+        return (int16_t)(rand() & 0xffff);
+    }
+}
+
+static void test_extremes()
+{
+    int16_t p, i, d;
+
+    // the error saturates at the ends of the range
+    pid_state_t s = pid_init(1, 0, 0);
+    CHECK_EQ(pid_update(&s, INT16_MAX, INT16_MIN, 0, 100), INT16_MAX);
+    CHECK_EQ(s.last_diff, INT16_MAX);
+    CHECK_EQ(pid_update(&s, INT16_MIN, INT16_MAX, 0, 100), INT16_MIN);
+    CHECK_EQ(s.last_diff, INT16_MIN);
+
+    // so does every term with the largest gains, and so does their sum;
+    // the integral does not start as the output is saturated already
+    s = pid_init(INT16_MAX, INT16_MAX, INT16_MAX);
+    CHECK_EQ(pid_update(&s, INT16_MAX, INT16_MIN, INT16_MAX, 65535), INT16_MAX);
+    pid_terms(&s, &p, &i, &d);
+    CHECK_EQ(p, INT16_MAX);
+    CHECK_EQ(i, 0);
+    s = pid_init(INT16_MAX, INT16_MAX, INT16_MAX);
+    CHECK_EQ(pid_update(&s, INT16_MIN, INT16_MAX, INT16_MIN, 65535), INT16_MIN);
+    pid_terms(&s, &p, &i, &d);
+    CHECK_EQ(p, INT16_MIN);
+    CHECK_EQ(i, 0);
+
+    // a full-range step of the measurement within 1 ms saturates the
+    // derivative, which acts against it
+    s = pid_init(0, 0, INT16_MAX);
+    pid_update(&s, 0, INT16_MIN, 0, 1);
+    CHECK_EQ(pid_update(&s, 0, INT16_MAX, 0, 1), INT16_MIN);
+    pid_terms(&s, &p, &i, &d);
+    CHECK_EQ(d, INT16_MIN);
+    CHECK_EQ(pid_update(&s, 0, INT16_MIN, 0, 1), INT16_MAX);
+
+    // the first update has no derivative, dt 0 counts as 1 ms
+    s = pid_init(0, 0, INT16_MAX);
+    CHECK_EQ(pid_update(&s, 0, 1000, 0, 0), 0);
+    CHECK_EQ(pid_update(&s, 0, 1000, 0, 0), 0);
+}
+
+static void test_integral()
+{
+    int16_t out, p, i, d;
+    int n;
+
+    // with the full output range, the integral saturates at the end of
+    // the range of int16_t instead of wrapping around
+    pid_state_t s = pid_init(0, 1, 0);
+    for (n = 0; n < 100; n++)
+        out = pid_update(&s, INT16_MAX, INT16_MIN, 0, 60000);
+    CHECK_EQ(s.integ, INT16_MAX);
+    CHECK_EQ(out, INT16_MAX);
+    for (n = 0; n < 100; n++)
+        out = pid_update(&s, INT16_MIN, INT16_MAX, 0, 60000);
+    CHECK_EQ(s.integ, INT16_MIN);
+    CHECK_EQ(out, INT16_MIN);
+
+    // the integral stops growing within one step (2 * 10) of the limit of
+    // the output, so it recovers at once when the error changes sign
+    s = pid_init(10, 2, 0);
+    pid_limit(&s, 0, 4096);
+    for (n = 0; n < 36000; n++)
+        out = pid_update(&s, 200, 100, 0, 100);
+    CHECK(out > 4096 - 2 * 10);
+    CHECK(1000 + 2 * s.integ <= 4096);
+    pid_terms(&s, &p, &i, &d);
+    CHECK_EQ(p, 1000);
+    CHECK(i <= 4096);
+    out = pid_update(&s, 200, 210, 0, 1000);
+    CHECK(out < 4096);
+    CHECK(out > 0);
+
+    // the integral is free to unwind out of the limit
+    s = pid_init(0, 1, 0);
+    pid_limit(&s, -100, 100);
+    s.integ = 1000;
+    out = pid_update(&s, 0, 10, 0, 1000);
+    CHECK_EQ(s.integ, 990);
+    CHECK_EQ(out, 100);
+
+    // the fraction of a second is kept across updates
+    s = pid_init(0, 1, 0);
+    for (n = 0; n < 1000; n++)
+        out = pid_update(&s, 3, 0, 0, 1);
+    CHECK_EQ(s.integ, 3);
+    CHECK_EQ(out, 3);
+}
+
+static void test_random()
+{
+    unsigned n, bad_limit = 0, bad_sign = 0;
+
+    // random gains, limits and inputs with many extremes: the output stays
+    // within the limits; with non-negative gains, no derivative and no
+    // feed-forward, a positive error and integral never give a negative
+    // output and vice versa
+    for (n = 0; n < 200000; n++) {
+        int16_t lo = rand16(), hi = rand16();
+        if (lo > hi) {
+            int16_t t = lo;
+            lo = hi;
+            hi = t;
+        }
+        pid_state_t s = pid_init(rand16(), rand16(), rand16());
+        pid_limit(&s, lo, hi);
+        pid_filter(&s, rand() % 3 ? 0 : rand() & 0xffff);
+        unsigned k;
+        for (k = 0; k < 8; k++) {
+            int16_t out = pid_update(&s, rand16(), rand16(), rand16(), rand() & 0xffff);
+            if (out < lo || out > hi)
+                bad_limit++;
+        }
+
+        s = pid_init(abs(rand16()) & INT16_MAX, abs(rand16()) & INT16_MAX, 0);
+        int16_t sp = rand16(), meas = rand16();
+        for (k = 0; k < 8; k++) {
+            int16_t out = pid_update(&s, sp, meas, 0, rand() & 0xffff);
+            if ((sp > meas && s.integ >= 0 && out < 0) || (sp < meas && s.integ <= 0 && out > 0))
+                bad_sign++;
+        }
+    }
+    CHECK_EQ(bad_limit, 0);
+    CHECK_EQ(bad_sign, 0);
+}
+
+int main()
+{
+    srand(1);
+    test_extremes();
+    test_integral();
+    test_random();
+    return check_done("test-pid");
+}
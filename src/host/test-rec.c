@@ -0,0 +1,216 @@
+/**
+ * @file test-rec.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the run recorder
+ *
+ * Runs of the thermal model (see plant.h) under a simple two-point
+ * controller are recorded once per second: a reflow, which fits at full
+ * resolution, and long bakes and a trace of large steps, which make the
+ * recorder drop samples. After rec_stop() the EEPROM image is decoded
+ * independently of rec.c (version, header, zigzag differences and CRC-8
+ * as documented in rec.h and nvm.h); every sample has to equal the one
+ * fed at its time. The size and the compression ratio of each record are
+ * reported.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rec.h"
+#include "nvm.h"
+#include "hal.h"
+#include "plant.h"
+#include "check.h"
+
+#define MAX_SAMPLES (4 * 3600 * 8)
+
+static uint8_t eeprom[HAL_EEPROM_SIZE]; // replaces the one of the hardware
+static FILE *uart_out;                  // and the serial output (rec_dump())
+
+void hal_eeprom_read(uint16_t addr, void *buf, uint16_t len)
+{
+    memcpy(buf, eeprom + addr, len);
+}
+
+void uart_puts(const char *str)
+{
+    fputs(str, uart_out);
+}
+
+void hal_eeprom_write(uint16_t addr, const void *buf, uint16_t len)
+{
+    memcpy(eeprom + addr, buf, len);
+}
+
+static int fed[MAX_SAMPLES];            // samples passed to rec_sample()
+static unsigned fed_count;
+
+/**
+ * @brief Normal distributed random number (Box-Muller).
+ */
+static double gauss()
+{
+    double u = (rand() + 1.) / (RAND_MAX + 2.), v = (rand() + 1.) / (RAND_MAX + 2.);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/**
+ * @brief Feed one sample per second of the plant following the set points
+ * @p sp (degC, -1 ends the run) for @p secs seconds each, with
+ * thermocouple noise of @p noise degC.
+ */
+static void run(const double *sp, const unsigned *secs, double noise)
+{
+    plant_t plant;
+    double heater = 0;
+    unsigned i, s;
+
+    plant_init(&plant);
+    fed_count = 0;
+    rec_start(2);
+    for (i = 0; sp[i] >= 0; i++) {
+        for (s = 0; s < secs[i] && fed_count < MAX_SAMPLES; s++) {
+            int temp = lround((plant.t_sensor[0] + noise * gauss()) * 4);
+            heater = plant.t_sensor[0] < sp[i] ? 1 : 0;
+            plant_step(&plant, &heater, 1.);
+            rec_sample(temp);
+            fed[fed_count++] = temp;
+        }
+    }
+    memset(eeprom, 0xff, sizeof(eeprom));
+    rec_stop();
+}
+
+static uint8_t crc8(uint8_t crc, const uint8_t *data, unsigned len)
+{
+    unsigned i;
+    while (len--) {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8c : crc >> 1;
+    }
+    return crc;
+}
+
+/**
+ * @brief Decode the record in the EEPROM and compare it with the samples
+ * fed; returns the interval of the record.
+ */
+static unsigned check_image(const char *name)
+{
+    const uint8_t *p = eeprom + NVM_RUN;
+    rec_head_t head;
+    unsigned i, pos, bad = 0;
+
+    memcpy(&head, p + 1, sizeof(head));
+    CHECK(p[0] != 0xff);
+    CHECK_EQ(head.mode, 2);
+    if (!CHECK(head.len <= REC_SIZE) || !CHECK(head.count > 0))
+        return 0;
+    CHECK_EQ(p[1 + sizeof(head) + head.len], crc8(0, p, 1 + sizeof(head) + head.len));
+
+    // every sample of the record is the one fed at its time; the samples
+    // left out at the end span at most two intervals
+    const uint8_t *data = p + 1 + sizeof(head);
+    int temp = head.first;
+    for (i = 0, pos = 0; i < head.count; i++) {
+        if (i > 0) {
+            unsigned zz = 0, shift = 0;
+            uint8_t b;
+            do {
+                b = data[pos++];
+                zz |= (b & 0x7f) << shift;
+                shift += 7;
+            } while (b & 0x80 && pos < head.len);
+            temp += (int16_t)((zz >> 1) ^ -(zz & 1));
+        }
+        if (i * head.interval >= fed_count || temp != fed[i * head.interval])
+            bad++;
+    }
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(pos, head.len);
+    CHECK(fed_count - (head.count - 1) * head.interval <= 2 * head.interval);
+
+    // rec.c reads it back the same way
+    CHECK(rec_load());
+    CHECK_EQ(rec_head()->count, head.count);
+    rec_iter_t iter = { 0, 0, 0 };
+    for (i = 0, bad = 0; rec_next(&iter, &temp); i++)
+        if (temp != fed[i * head.interval])
+            bad++;
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(i, head.count);
+
+    unsigned size = sizeof(head) + head.len;
+    printf("test-rec: %s: %u s in %u samples every %u s, %u bytes "
+           "(%.2f bytes per sample, %.1f times smaller than raw)\n",
+           name, fed_count, head.count, head.interval, size,
+           (double)head.len / head.count, 2. * fed_count / size);
+    return head.interval;
+}
+
+int main()
+{
+    srand(1);
+
+    // reflow: preheat, soak, peak, cool down, kept at full resolution
+    static const double reflow[] = { 150, 170, 235, 0, -1 };
+    static const unsigned reflow_secs[] = { 120, 90, 150, 300 };
+    run(reflow, reflow_secs, 0.25);
+    CHECK_EQ(check_image("reflow"), 1);
+
+    // bakes of increasing length, with noise, make the recorder drop every
+    // other sample once or several times
+    static const double bake[] = { 125, 0, -1 };
+    unsigned bake_secs[] = { 0, 600 };
+    unsigned min;
+    for (min = 20; min <= 240; min += 37) {
+        char name[32];
+        bake_secs[0] = min * 60;
+        run(bake, bake_secs, 0.5);
+        snprintf(name, sizeof(name), "bake %u min", min);
+        CHECK(check_image(name) >= 2);
+    }
+
+    // large steps need multi-byte differences
+    unsigned i;
+    rec_start(2);
+    for (i = 0; i < 1500; i++) {
+        fed[i] = (i % 7) * 1000 - (i % 3) * 3000 + i;
+        rec_sample(fed[i]);
+    }
+    fed_count = i;
+    memset(eeprom, 0xff, sizeof(eeprom));
+    rec_stop();
+    check_image("steps");
+
+    // the dump lists each sample with its time
+    char *out, *p;
+    size_t out_len;
+    unsigned mode, count, len, bad = 0;
+    unsigned long t;
+    double temp;
+    int n = 0;
+    uart_out = open_memstream(&out, &out_len);
+    rec_dump();
+    fclose(uart_out);
+    CHECK(sscanf(out, "# mode %u, %u samples, %u bytes\r\n%n", &mode, &count, &len, &n) == 3 && n > 0);
+    CHECK_EQ(mode, 2);
+    CHECK_EQ(count, rec_head()->count);
+    CHECK_EQ(len, rec_head()->len);
+    for (i = 0, p = out + n; *p != 0; i++, p += n) {
+        n = 0;
+        if (sscanf(p, "%lu\t%lf\r\n%n", &t, &temp, &n) != 2 || n == 0 ||
+            t != i * rec_head()->interval || temp * 4 != fed[t])
+            bad++;
+        if (n == 0)
+            break;
+    }
+    CHECK_EQ(i, count);
+    CHECK_EQ(bad, 0);
+    free(out);
+
+    return check_done("test-rec");
+}
@@ -0,0 +1,148 @@
+/**
+ * @file test-sched.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the task scheduler
+ *
+ * sched.c runs against mocked interrupt control and sleep: the test plays
+ * the timer interrupt by calling sched_tick() itself. Tasks have to run
+ * at their periods in the order they were added, a task that became due
+ * several times runs once, and sched_restart() and the events have to work
+ * as documented. sched_sleep() has to sleep with interrupts disabled up to
+ * the sleep instruction exactly when no task is due and no event is
+ * posted, and leave the interrupts enabled in any case.
+ */
+#include <string.h>
+
+#include "sched.h"
+#include "hal.h"
+#include "check.h"
+
+static uint8_t irq_on = 1;
+static unsigned sleeps;
+
+void hal_irq_enable()
+{
+    irq_on = 1;
+}
+
+void hal_irq_disable()
+{
+    irq_on = 0;
+}
+
+void hal_sleep()
+{
+    // entered with interrupts disabled, enables them before sleeping
+    CHECK(!irq_on);
+    irq_on = 1;
+    sleeps++;
+}
+
+static char order[64]; // tasks run, in order
+static unsigned len;
+
+static void task_a()
+{
+    order[len++] = 'a';
+}
+
+static void task_b()
+{
+    order[len++] = 'b';
+}
+
+static void task_c()
+{
+    order[len++] = 'c';
+}
+
+/**
+ * @brief Check that sched_run() runs the tasks @p want , in that order.
+ */
+static void check_run(const char *want)
+{
+    len = 0;
+    CHECK_EQ(sched_run(), strlen(want));
+    order[len] = 0;
+    if (!CHECK(strcmp(order, want) == 0))
+        fprintf(stderr, "    ran \"%s\", not \"%s\"\n", order, want);
+}
+
+/**
+ * @brief Check whether sched_sleep() sleeps (@p want non-zero) or returns
+ * at once.
+ */
+static void check_sleep(uint8_t want)
+{
+    unsigned n = sleeps;
+    sched_sleep();
+    CHECK_EQ(sleeps - n, want);
+    CHECK(irq_on);
+}
+
+int main()
+{
+    unsigned i;
+
+    CHECK_EQ(sched_add(task_a, 0), -1);
+    CHECK_EQ(sched_add(task_a, 1), 0);
+    CHECK_EQ(sched_add(task_b, 3), 0);
+    CHECK_EQ(sched_add(task_c, 2), 0);
+    for (i = 3; i < SCHED_MAX_TASKS; i++)
+        CHECK_EQ(sched_add(task_c, 255), 0);
+    CHECK_EQ(sched_add(task_c, 1), -1);
+    CHECK(irq_on);
+
+    // nothing due: sleep
+    check_run("");
+    check_sleep(1);
+
+    // every task at its period, in the order they were added
+    sched_tick();
+    check_sleep(0);
+    check_run("a");
+    sched_tick();
+    check_run("ac");
+    sched_tick();
+    check_run("ab");
+    sched_tick();
+    check_run("ac");
+    check_sleep(1);
+    CHECK_EQ(sched_now(), 4);
+
+    // due several times while the main loop was busy: run once
+    for (i = 0; i < 6; i++)
+        sched_tick();
+    check_run("abc");
+    check_run("");
+
+    // restart: each task waits for its full period
+    sched_tick();
+    sched_restart();
+    check_run("");
+    check_sleep(1);
+    sched_tick();
+    check_run("a");
+    sched_tick();
+    check_run("ac");
+    sched_tick();
+    check_run("ab");
+
+    // a posted event keeps the main loop awake until it is fetched
+    sched_post(0x01);
+    sched_post(0x10);
+    check_sleep(0);
+    check_sleep(0);
+    CHECK_EQ(sched_events(), 0x11);
+    CHECK_EQ(sched_events(), 0);
+    check_sleep(1);
+
+    // the tick counter wraps around
+    for (i = sched_now(); i < 0x10000; i++)
+        sched_tick();
+    CHECK_EQ(sched_now(), 0);
+
+    return check_done("test-sched");
+}
@@ -0,0 +1,185 @@
+/**
+ * @file test-sweep.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Test of the parameter sweep
+ *
+ * Runs small sweeps of ./sweep (see sweep.c, "make check" builds it) and
+ * reads back the scores of all runs (-o). Every combination of the
+ * parameter ranges has to be simulated once, the Pareto fronts have to be
+ * consistent with the scores (front 1 not dominated by any valid run, each
+ * later front dominated only by runs of the fronts before), the runs
+ * written to stdout have to be front 1 ranked by the sum of their scaled
+ * scores, and the results must not depend on the number of processes.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+
+#define CSV "host/test-sweep.csv"
+#define MAX_RUNS 64
+#define NUM_PARAMS 7
+
+typedef struct {
+    int param[NUM_PARAMS];
+    double score[4];
+    int done, valid, front;
+} run_t;
+
+static run_t runs[MAX_RUNS], first[MAX_RUNS];
+static int num_runs, num_scores, num_first;
+
+/**
+ * @brief Run ./sweep with the options @p opts , read the front written to
+ * stdout into @p first and all runs from the CSV file into @p runs .
+ */
+static int sweep(const char *opts)
+{
+    char cmd[256], line[512];
+    FILE *f;
+    int k;
+
+    snprintf(cmd, sizeof(cmd), "./sweep %s -o %s 2> /dev/null", opts, CSV);
+    f = popen(cmd, "r");
+    if (!CHECK(f != NULL))
+        return 0;
+    num_first = 0;
+    if (CHECK(fgets(line, sizeof(line), f) != NULL))
+        CHECK(strncmp(line, "rank\tP\tI\tD\tff\tcoast\toffset\twindow\t", 34) == 0);
+    while (num_first < MAX_RUNS && fgets(line, sizeof(line), f) != NULL) {
+        run_t *r = &first[num_first];
+        char *p = line;
+        CHECK_EQ(strtol(p, &p, 10), num_first + 1);
+        for (k = 0; k < NUM_PARAMS; k++)
+            r->param[k] = strtol(p, &p, 10);
+        for (k = 0; k < num_scores; k++)
+            r->score[k] = strtod(p, &p);
+        num_first++;
+    }
+    if (!CHECK_EQ(pclose(f), 0))
+        return 0;
+
+    f = fopen(CSV, "r");
+    if (!CHECK(f != NULL))
+        return 0;
+    num_runs = 0;
+    CHECK(fgets(line, sizeof(line), f) != NULL);
+    while (num_runs < MAX_RUNS && fgets(line, sizeof(line), f) != NULL) {
+        run_t *r = &runs[num_runs++];
+        char *p = line;
+        for (k = 0; k < NUM_PARAMS; k++)
+            r->param[k] = strtol(p, &p, 10), p++;
+        for (k = 0; k < num_scores; k++)
+            r->score[k] = strtod(p, &p), p++;
+        r->done = strtol(p, &p, 10), p++;
+        r->valid = strtol(p, &p, 10), p++;
+        r->front = strtol(p, &p, 10);
+    }
+    fclose(f);
+    remove(CSV);
+    return 1;
+}
+
+static int dominates(const run_t *a, const run_t *b)
+{
+    int k, better = 0;
+    for (k = 0; k < num_scores; k++) {
+        if (a->score[k] > b->score[k])
+            return 0;
+        better |= a->score[k] < b->score[k];
+    }
+    return better;
+}
+
+/**
+ * @brief Check the runs of a sweep of @p n combinations and its fronts.
+ */
+static void check_fronts(int n)
+{
+    double lo[4], hi[4], last = -1;
+    int i, j, k;
+
+    CHECK_EQ(num_runs, n);
+    for (i = 0; i < num_runs; i++) {
+        CHECK(runs[i].done);
+        for (j = 0; j < i; j++)
+            CHECK(memcmp(runs[i].param, runs[j].param, sizeof(runs[i].param)) != 0);
+    }
+
+    for (i = 0; i < num_runs; i++) {
+        const run_t *r = &runs[i];
+        if (!r->valid) {
+            CHECK_EQ(r->front, 0);
+            continue;
+        }
+        CHECK(r->front >= 1);
+        int by_prev = r->front == 1;
+        for (j = 0; j < num_runs; j++) {
+            if (!runs[j].valid || !dominates(&runs[j], r))
+                continue;
+            CHECK(runs[j].front < r->front);
+            by_prev |= runs[j].front == r->front - 1;
+        }
+        CHECK(by_prev);
+    }
+
+    // stdout: front 1, by the sum of the scores scaled to their range
+    for (k = 0; k < num_scores; k++) {
+        lo[k] = 1e9;
+        hi[k] = -1e9;
+    }
+    for (i = 0, j = 0; i < num_runs; i++) {
+        if (runs[i].front != 1)
+            continue;
+        j++;
+        for (k = 0; k < num_scores; k++) {
+            lo[k] = runs[i].score[k] < lo[k] ? runs[i].score[k] : lo[k];
+            hi[k] = runs[i].score[k] > hi[k] ? runs[i].score[k] : hi[k];
+        }
+    }
+    CHECK_EQ(num_first, j);
+    for (i = 0; i < num_first; i++) {
+        double rank = 0;
+        for (j = 0; j < num_runs; j++)
+            if (memcmp(first[i].param, runs[j].param, sizeof(first[i].param)) == 0)
+                break;
+        if (!CHECK(j < num_runs) || !CHECK_EQ(runs[j].front, 1))
+            continue;
+        for (k = 0; k < num_scores; k++)
+            if (hi[k] > lo[k])
+                rank += (runs[j].score[k] - lo[k]) / (hi[k] - lo[k]);
+        CHECK(rank >= last - 1e-3); // the scores of the CSV are rounded
+        last = rank;
+    }
+}
+
+int main()
+{
+    run_t serial[MAX_RUNS];
+    int i, n;
+
+    // reflows: 2 x 1 x 2 x 1 x 2 combinations
+    num_scores = 4;
+    if (sweep("-P 120:240:120 -I 1 -D 0:800:800 -c 35:55:20 -j 1")) {
+        check_fronts(8);
+        CHECK(num_first > 0);
+    }
+
+    // the same on several processes
+    memcpy(serial, runs, sizeof(runs));
+    n = num_runs;
+    if (sweep("-P 120:240:120 -I 1 -D 0:800:800 -c 35:55:20 -j 3")) {
+        CHECK_EQ(num_runs, n);
+        for (i = 0; i < n; i++)
+            CHECK(memcmp(&runs[i], &serial[i], sizeof(runs[i])) == 0);
+    }
+
+    // bakes: three scores, the reflow parameters are not swept
+    num_scores = 3;
+    if (sweep("-b -d 900 -P 80:240:80 -I 0:2:2 -D 0 -c 35:55:10 -j 2"))
+        check_fronts(6);
+
+    return check_done("test-sweep");
+}
@@ -0,0 +1,208 @@
+/**
+ * @file test-telem.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the telemetry encoder and decoder
+ *
+ * Random records (and ones full of 0 and 0xff bytes) are encoded and
+ * decoded again. The frames are checked against an independent COBS
+ * decoder and CRC, and corrupted, truncated, extended and re-versioned
+ * records built with an independent COBS encoder have to be rejected.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "telem.h"
+#include "check.h"
+
+/**
+ * @brief CRC-16 as specified in telem.h, bit by bit (CRC-16/MCRF4XX).
+ */
+static uint16_t crc(const uint8_t *buf, unsigned len)
+{
+    uint16_t c = 0xffff;
+    unsigned i, b;
+    for (i = 0; i < len; i++)
+        for (b = 0; b < 8; b++)
+            c = ((c ^ (buf[i] >> b)) & 1) ? (c >> 1) ^ 0x8408 : c >> 1;
+    return c;
+}
+
+/**
+ * @brief COBS-encode @p len bytes of @p buf into @p frame (without the
+ * terminating 0); returns the length of the frame.
+ */
+static unsigned cobs_encode(const uint8_t *buf, unsigned len, uint8_t *frame)
+{
+    unsigned i, n = 1, code = 0;
+    for (i = 0; i < len; i++) {
+        if (buf[i] == 0) {
+            frame[code] = n - code;
+            code = n++;
+        } else
+            frame[n++] = buf[i];
+    }
+    frame[code] = n - code;
+    return n;
+}
+
+/**
+ * @brief COBS-decode the frame @p frame of @p len bytes into @p buf ;
+ * returns the number of bytes or -1.
+ */
+static int cobs_decode(const uint8_t *frame, unsigned len, uint8_t *buf)
+{
+    unsigned i = 0, n = 0;
+    while (i < len) {
+        unsigned code = frame[i++];
+        if (code == 0 || i + code - 1 > len)
+            return -1;
+        while (--code)
+            buf[n++] = frame[i++];
+        if (i < len)
+            buf[n++] = 0;
+    }
+    return n;
+}
+
+/**
+ * @brief A random value (@p kind 0, a third of them 0), all ones (1) or 0 (2).
+ */
+static uint32_t rnd(int kind)
+{
+    if (kind != 0)
+        return kind == 1 ? 0xffffffff : 0;
+    return rand() % 3 == 0 ? 0 : (uint32_t)rand() << 16 ^ rand();
+}
+
+static void random_rec(telem_rec_t *rec, int kind)
+{
+    memset(rec, 0, sizeof(*rec)); // so that records can be compared with memcmp
+    rec->time = rnd(kind);
+    rec->hot = rnd(kind);
+    rec->rate = rnd(kind);
+    rec->cold = rnd(kind);
+    rec->setpoint = rnd(kind);
+    rec->p = rnd(kind);
+    rec->i = rnd(kind);
+    rec->d = rnd(kind);
+    rec->out = rnd(kind);
+    rec->mode = rnd(kind);
+    rec->phase = rnd(kind);
+    rec->flags = rnd(kind);
+    rec->ramp_up = rnd(kind);
+    rec->ramp_down = rnd(kind);
+    rec->peak = rnd(kind);
+    rec->tal = rnd(kind);
+    rec->near_peak = rnd(kind);
+    rec->soak = rnd(kind);
+    rec->verdict = rnd(kind);
+    rec->stack = rnd(kind);
+    rec->ram_free = rnd(kind);
+}
+
+static void test_round_trip()
+{
+    uint8_t frame[TELEM_FRAME_MAX + 8], buf[TELEM_FRAME_MAX];
+    telem_rec_t rec, out;
+    unsigned n, i, bad_len = 0, bad_zero = 0, bad_rec = 0, bad_layout = 0;
+
+    for (n = 0; n < 100000; n++) {
+        random_rec(&rec, n < 3 ? n : 0);
+        unsigned len = telem_encode(&rec, frame);
+
+        // only the terminating byte is 0
+        if (len < 2 || len > TELEM_FRAME_MAX)
+            bad_len++;
+        for (i = 0; i < len - 1; i++)
+            if (frame[i] == 0)
+                bad_zero++;
+        if (frame[len - 1] != 0)
+            bad_zero++;
+
+        // the content: version, little-endian values, CRC of the rest
+        if (cobs_decode(frame, len - 1, buf) != TELEM_REC_SIZE || buf[0] != TELEM_VERSION ||
+            (buf[1] | buf[2] << 8 | buf[3] << 16 | (uint32_t)buf[4] << 24) != rec.time ||
+            (int16_t)(buf[5] | buf[6] << 8) != rec.hot ||
+            (buf[TELEM_REC_SIZE - 2] | buf[TELEM_REC_SIZE - 1] << 8) != crc(buf, TELEM_REC_SIZE - 2))
+            bad_layout++;
+
+        memset(&out, 0, sizeof(out));
+        if (telem_decode(frame, len - 1, &out) != 0 || memcmp(&rec, &out, sizeof(rec)) != 0)
+            bad_rec++;
+    }
+    CHECK_EQ(bad_len, 0);
+    CHECK_EQ(bad_zero, 0);
+    CHECK_EQ(bad_layout, 0);
+    CHECK_EQ(bad_rec, 0);
+}
+
+static void test_reject()
+{
+    uint8_t frame[TELEM_FRAME_MAX + 8], buf[TELEM_REC_SIZE + 8], bad[TELEM_REC_SIZE + 8];
+    telem_rec_t rec, out;
+    unsigned n, i, b, accepted = 0;
+
+    CHECK_EQ(crc((const uint8_t *)"123456789", 9), 0x6f91);
+
+    for (n = 0; n < 200; n++) {
+        random_rec(&rec, n < 3 ? n : 0);
+        unsigned len = telem_encode(&rec, frame) - 1;
+        CHECK_EQ(cobs_decode(frame, len, buf), TELEM_REC_SIZE);
+
+        // every single bit error, validly stuffed, fails the CRC
+        for (i = 0; i < TELEM_REC_SIZE; i++) {
+            for (b = 0; b < 8; b++) {
+                memcpy(bad, buf, TELEM_REC_SIZE);
+                bad[i] ^= 1 << b;
+                unsigned l = cobs_encode(bad, TELEM_REC_SIZE, frame);
+                if (telem_decode(frame, l, &out) == 0)
+                    accepted++;
+            }
+        }
+
+        // another version is rejected even with a valid CRC
+        memcpy(bad, buf, TELEM_REC_SIZE);
+        bad[0] = TELEM_VERSION + 1;
+        uint16_t c = crc(bad, TELEM_REC_SIZE - 2);
+        bad[TELEM_REC_SIZE - 2] = c & 0xff;
+        bad[TELEM_REC_SIZE - 1] = c >> 8;
+        len = cobs_encode(bad, TELEM_REC_SIZE, frame);
+        if (telem_decode(frame, len, &out) == 0)
+            accepted++;
+        bad[0] = TELEM_VERSION;
+        c = crc(bad, TELEM_REC_SIZE - 2);
+        bad[TELEM_REC_SIZE - 2] = c & 0xff;
+        bad[TELEM_REC_SIZE - 1] = c >> 8;
+        len = cobs_encode(bad, TELEM_REC_SIZE, frame);
+        CHECK_EQ(telem_decode(frame, len, &out), 0);
+
+        // records one byte short or long (with a valid CRC), truncated
+        // frames and ones with a broken code byte
+        for (i = TELEM_REC_SIZE - 1; i <= TELEM_REC_SIZE + 1; i += 2) {
+            c = crc(bad, i - 2);
+            bad[i - 2] = c & 0xff;
+            bad[i - 1] = c >> 8;
+            unsigned l = cobs_encode(bad, i, frame);
+            if (telem_decode(frame, l, &out) == 0)
+                accepted++;
+        }
+        len = telem_encode(&rec, frame) - 1;
+        for (i = 0; i < len; i++)
+            if (telem_decode(frame, i, &out) == 0)
+                accepted++;
+        frame[0] = len + 1;
+        if (telem_decode(frame, len, &out) == 0)
+            accepted++;
+    }
+    CHECK_EQ(accepted, 0);
+}
+
+int main()
+{
+    srand(1);
+    test_round_trip();
+    test_reject();
+    return check_done("test-telem");
+}
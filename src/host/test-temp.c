@@ -0,0 +1,195 @@
+/**
+ * @file test-temp.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the decoding of the MAX31855K frames
+ *
+ * temp.c runs against a mocked SPI bus: the test starts a batch and feeds
+ * the frame of each channel byte by byte to hal_on_spi(), like the SPI
+ * interrupt. Good readings of positive and negative temperatures, each
+ * fault cause, set reserved bits, frames of all zeros and all ones (MISO
+ * stuck low or high), abandoned batches and the staleness of the last
+ * good reading are checked.
+ */
+#include <stdlib.h>
+
+#include "temp.h"
+#include "hal.h"
+#include "sched.h"
+#include "check.h"
+
+static int8_t selected = -1; // device selected on the mocked bus
+static unsigned writes;      // bytes requested since the last select
+static uint16_t now;         // tick returned by sched_now()
+
+void hal_spi_init()
+{
+}
+
+void hal_spi_select(uint8_t dev, uint8_t on)
+{
+    CHECK(on ? selected == -1 : selected == dev);
+    selected = on ? dev : -1;
+    writes = 0;
+}
+
+void hal_spi_write(uint8_t data)
+{
+    (void)data;
+    writes++;
+}
+
+uint16_t sched_now()
+{
+    return now;
+}
+
+/**
+ * @brief Frame of a good reading, @p hot and @p cold multiplied by 4 and
+ * 16.
+ */
+static uint32_t good(int16_t hot, int16_t cold)
+{
+    return (uint32_t)(hot & 0x3fff) << 18 | (uint32_t)(cold & 0xfff) << 4;
+}
+
+/**
+ * @brief Read all channels, with the frame @p frame on channel @p ch and
+ * good readings on the others.
+ */
+static void batch(uint8_t ch, uint32_t frame)
+{
+    uint8_t i;
+    int8_t b;
+
+    temp_start();
+    for (i = 0; i < TEMP_CHANNELS; i++) {
+        uint32_t f = i == ch ? frame : good(100, 400);
+        CHECK_EQ(selected, i);
+        for (b = 3; b >= 0; b--) {
+            CHECK_EQ(writes, 4 - b);
+            hal_on_spi(f >> (8 * b));
+        }
+    }
+    CHECK_EQ(selected, -1);
+}
+
+/**
+ * @brief Read the frame @p frame on channel @p ch and check that it fails
+ * with the causes @p faults without touching the last good reading
+ * @p last .
+ */
+static void check_fail(uint8_t ch, uint32_t frame, uint8_t faults, const temp_sample_t *last)
+{
+    temp_sample_t s = *last;
+    uint8_t n = temp_failures(ch);
+
+    now++;
+    batch(ch, frame);
+    CHECK_EQ(temp_faults(ch), faults);
+    CHECK_EQ(temp_failures(ch), n + 1);
+    CHECK_EQ(temp_read(ch, &s), 0);
+    CHECK_EQ(s.hot, last->hot);
+    CHECK_EQ(s.cold, last->cold);
+    CHECK_EQ(s.time, last->time);
+}
+
+int main()
+{
+    uint8_t ch = TEMP_CHANNELS - 1;
+    temp_sample_t s = { 0x1234, 0x5678, 0x9abc }, last;
+    unsigned i;
+
+    temp_init();
+
+    // no good reading yet: the sample is left alone
+    batch(ch, 0);
+    CHECK_EQ(temp_read(ch, &s), 0);
+    CHECK_EQ(s.hot, 0x1234);
+    CHECK_EQ(temp_faults(ch), TEMP_F_BUS);
+
+    // good readings, new once
+    now = 1000;
+    batch(ch, good(25 * 4 + 1, 24 * 16 + 1));
+    CHECK_EQ(temp_faults(ch), 0);
+    CHECK_EQ(temp_failures(ch), 0);
+    CHECK_EQ(temp_read(ch, &s), 1);
+    CHECK_EQ(s.hot, 101);
+    CHECK_EQ(s.cold, 385);
+    CHECK_EQ(s.time, 1000);
+    CHECK_EQ(temp_read(ch, &s), 0);
+    CHECK_EQ(s.time, 1000);
+
+    // every temperature of both junctions, negative ones sign extended
+    for (i = 0; i < 0x4000; i++) {
+        int16_t hot = (int16_t)(i << 2) >> 2;
+        int16_t cold = (int16_t)(i << 4) >> 4;
+        if (hot == 0 && cold == 0)
+            continue;
+        now = i;
+        batch(ch, good(hot, cold));
+        if (!CHECK_EQ(temp_read(ch, &s), 1) || !CHECK_EQ(s.hot, hot) || !CHECK_EQ(s.cold, cold))
+            break;
+        CHECK_EQ(s.time, i);
+    }
+    batch(ch, good(-270 * 4, -55 * 16));
+    temp_read(ch, &s);
+    CHECK_EQ(s.hot, -1080);
+    CHECK_EQ(s.cold, -880);
+
+    // failures: fault causes, reserved bits, MISO stuck low or high
+    batch(ch, good(200 * 4, 25 * 16));
+    temp_read(ch, &last);
+    check_fail(ch, good(200 * 4, 25 * 16) | 0x10001, TEMP_F_OC, &last);
+    check_fail(ch, good(200 * 4, 25 * 16) | 0x10002, TEMP_F_SCG, &last);
+    check_fail(ch, good(200 * 4, 25 * 16) | 0x10004, TEMP_F_SCV, &last);
+    check_fail(ch, good(200 * 4, 25 * 16) | 0x10003, TEMP_F_OC | TEMP_F_SCG, &last);
+    check_fail(ch, good(200 * 4, 25 * 16) | 0x10000, TEMP_F_FAULT, &last);
+    check_fail(ch, good(200 * 4, 25 * 16) | 0x20000, TEMP_F_BUS, &last);
+    check_fail(ch, good(200 * 4, 25 * 16) | 0x8, TEMP_F_BUS, &last);
+    check_fail(ch, 0, TEMP_F_BUS, &last);
+    check_fail(ch, 0x10001, TEMP_F_OC, &last);
+    check_fail(ch, 0xffffffffUL, TEMP_F_BUS, &last);
+    // the status bits alone are no fault without the fault bit
+    batch(ch, good(200 * 4, 25 * 16) | 0x7);
+    CHECK_EQ(temp_faults(ch), 0);
+    CHECK_EQ(temp_read(ch, &s), 1);
+    CHECK_EQ(s.hot, 800);
+
+    // the failure count saturates and a good reading clears it
+    for (i = 0; i < 300; i++)
+        batch(ch, 0);
+    CHECK_EQ(temp_failures(ch), 255);
+    batch(ch, good(30 * 4, 25 * 16));
+    CHECK_EQ(temp_failures(ch), 0);
+    CHECK_EQ(temp_read(ch, &s), 1);
+
+    // a batch abandoned halfway fails on the channels not read yet, and
+    // the next one starts over at the first channel
+    temp_read(ch, &last);
+    now = 2000;
+    temp_start();
+    for (i = 0; i < ch; i++) {
+        int8_t b;
+        for (b = 3; b >= 0; b--)
+            hal_on_spi(good(40 * 4, 25 * 16) >> (8 * b));
+    }
+    hal_on_spi(0x12);
+    CHECK_EQ(selected, ch);
+    batch(TEMP_CHANNELS, 0);
+    CHECK_EQ(temp_failures(ch), 0); // read again by the second batch
+    CHECK_EQ(temp_read(ch, &s), 1);
+    CHECK_EQ(s.hot, 100);
+    CHECK_EQ(s.time, 2000);
+    temp_start();
+    hal_on_spi(0x12);
+    now = 2001;
+    temp_start();
+    for (i = 0; i < TEMP_CHANNELS; i++)
+        CHECK_EQ(temp_failures(i), 1);
+    CHECK_EQ(temp_faults(0), TEMP_F_BUS);
+    CHECK_EQ(selected, 0);
+
+    return check_done("test-temp");
+}
@@ -0,0 +1,179 @@
+/**
+ * @file test-traj.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the set point trajectory
+ *
+ * The trajectories of the built-in profiles and of uploaded ones are
+ * planned and checked: the set point has to ramp at no more than
+ * @c TRAJ_RATE percent of the ramp rate limits (or the rate of the
+ * segment, if lower) and no slower than that, reach the temperature of
+ * each heated segment at its end, hold it for the segment time, stay put
+ * in segments without heater and after the end of the table.
+ * @c traj_seek() has to find the same time as a search of the set point
+ * millisecond by millisecond.
+ */
+#include <string.h>
+
+#include "traj.h"
+#include "profile.h"
+#include "check.h"
+
+#define T(x) ((x) * 4)
+#define STEP_MS ((uint32_t)TRAJ_STEP * 1000)
+#define END_MS ((uint32_t)TRAJ_TIME * 1000)
+
+/**
+ * @brief Planned ramp rate (0.1 degC/s, 0 if not limited) of segment @p s
+ * moving the set point from @p from .
+ */
+static unsigned plan_rate(const profile_limits_t *lim, const profile_seg_t *s, int from)
+{
+    unsigned limit = s->temp > from ? lim->ramp_up : lim->ramp_down;
+    unsigned rate = s->temp > from ? s->rate : 0;
+
+    if (limit != 0 && limit * TRAJ_RATE / 100 == 0)
+        limit = 1;
+    else
+        limit = limit * TRAJ_RATE / 100;
+    return rate != 0 && (limit == 0 || rate < limit) ? rate : limit;
+}
+
+/**
+ * @brief Search the first time from @p ms to the end of segment @p seg at
+ * which the set point is at least @p temp , one millisecond at a time.
+ */
+static uint32_t seek(uint8_t seg, uint32_t ms, int temp)
+{
+    uint32_t end = traj_seg_start(seg + 1);
+    for (; ms < end; ms++)
+        if (traj_setpoint(ms) >= temp)
+            return ms;
+    return end;
+}
+
+/**
+ * @brief Plan profile number @p profile and check its trajectory.
+ */
+static void check_plan(uint8_t profile)
+{
+    uint8_t n = profile_num_segs(profile), i;
+    profile_limits_t lim;
+    profile_seg_t s;
+    int cur = TRAJ_START, temp;
+    uint32_t ms;
+
+    traj_build(profile);
+    profile_limits(profile, &lim);
+    CHECK_EQ(traj_seg_start(0), 0);
+
+    for (i = 0; i < n; i++) {
+        uint32_t start = traj_seg_start(i), end = traj_seg_start(i + 1);
+        profile_seg(profile, i, &s);
+        CHECK(end >= start);
+        CHECK_EQ(start % STEP_MS, 0);
+        if (end > END_MS)
+            break;
+
+        if (s.out == SEG_OUT_OFF || s.exit == SEG_EXIT_NEVER) {
+            // the set point stays
+            for (ms = start; ms < end; ms += 100)
+                if (!CHECK_EQ(traj_setpoint(ms), cur))
+                    break;
+            continue;
+        }
+
+        // ramp at the planned rate, and no slower
+        unsigned rate = plan_rate(&lim, &s, cur);
+        if (rate != 0) {
+            // rate / 10 degC/s = rate * 0.4 (degC * 4) per second
+            double most = rate * 0.4 * TRAJ_STEP + 1;
+            for (ms = start; ms < end; ms += STEP_MS) {
+                int diff = traj_setpoint(ms + STEP_MS) - traj_setpoint(ms);
+                if (!CHECK(diff <= most && -diff <= most))
+                    break;
+            }
+            double ramp = (s.temp > cur ? s.temp - cur : cur - s.temp) / (rate * 0.4);
+            if (s.exit != SEG_EXIT_TIME && s.exit != SEG_EXIT_ABOVE_OR_TIME)
+                CHECK(end - start < (ramp + TRAJ_STEP) * 1000);
+            CHECK_EQ(traj_setpoint(end), s.temp);
+        } else {
+            // step change (a step of the next segment is interpolated over
+            // the last table step of this one)
+            CHECK_EQ(traj_setpoint(start), s.temp);
+            CHECK(end - start < STEP_MS || traj_setpoint(end - STEP_MS) == s.temp);
+        }
+
+        // hold for the segment time
+        if (s.exit == SEG_EXIT_TIME || s.exit == SEG_EXIT_ABOVE_OR_TIME) {
+            CHECK(end - start >= s.time * 1000UL);
+            CHECK(end - start < s.time * 1000UL + STEP_MS || rate != 0);
+        }
+
+        // the crossings of the set point within the segment
+        for (temp = TRAJ_START - 8; temp <= PROFILE_TEMP_MAX; temp += 37) {
+            CHECK_EQ(traj_seek(i, start, temp), seek(i, start, temp));
+            CHECK_EQ(traj_seek(i, start + 1234, temp), seek(i, start + 1234, temp));
+        }
+        CHECK_EQ(traj_seek(i, start, s.temp), seek(i, start, s.temp));
+        CHECK_EQ(traj_seek(i, start, s.temp + 1), end);
+        cur = s.temp;
+    }
+
+    // constant after the end of the table
+    temp = traj_setpoint(END_MS);
+    CHECK_EQ(traj_setpoint(END_MS + 1), temp);
+    CHECK_EQ(traj_setpoint(10 * END_MS), temp);
+}
+
+int main()
+{
+    static const profile_limits_t limits = {
+        30, 60, 60, 180, 60, 150, T(208), T(240), 30
+    };
+    profile_t *p;
+
+    check_plan(PROFILE_LEADED);
+    check_plan(PROFILE_LEAD_FREE);
+
+    // the Sn63Pb37 preheat to 100 degC at 2.4 degC/s: 31.25 s, 7 steps
+    traj_build(PROFILE_LEADED);
+    CHECK_EQ(traj_seg_start(1), 35000);
+    CHECK_EQ(traj_setpoint(0), TRAJ_START);
+    CHECK_EQ(traj_seg_start(2), 35000 + 120000);
+
+    // a segment rate below the limit is used, one above is limited
+    p = profile_user_edit();
+    strcpy(p->name, "test");
+    p->liquidus = T(183);
+    p->limits = limits;
+    p->num_segs = 4;
+    p->segs[0] = (profile_seg_t){ SEG_PREHEAT, SEG_OUT_PID, SEG_EXIT_ABOVE, 0, T(150), 0, 10 };
+    p->segs[1] = (profile_seg_t){ SEG_SOAK, SEG_OUT_PID, SEG_EXIT_TIME, SEG_F_SOAK, T(150), 60, 0 };
+    p->segs[2] = (profile_seg_t){ SEG_RAMP, SEG_OUT_PID, SEG_EXIT_ABOVE, 0, T(200), 0, 50 };
+    p->segs[3] = (profile_seg_t){ SEG_COOL, SEG_OUT_OFF, SEG_EXIT_NEVER, 0, 0, 0, 0 };
+    CHECK(profile_user_done());
+    check_plan(PROFILE_USER);
+    CHECK_EQ(traj_seg_start(1), 125000);            // 125 degC at 1 degC/s
+    CHECK_EQ(traj_seg_start(2), 125000 + 60000);
+    CHECK_EQ(traj_seg_start(3), 125000 + 60000 + 25000); // 50 degC at 2.4 degC/s
+
+    // without any limit the set point steps, and a soak longer than the
+    // table stops the plan at its end
+    p = profile_user_edit();
+    strcpy(p->name, "step");
+    p->num_segs = 3;
+    p->segs[0] = (profile_seg_t){ SEG_PREHEAT, SEG_OUT_PID, SEG_EXIT_ABOVE_OR_TIME, 0, T(150), 8, 0 };
+    p->segs[1] = (profile_seg_t){ SEG_SOAK, SEG_OUT_PID, SEG_EXIT_TIME, 0, T(120), 1000, 0 };
+    p->segs[2] = (profile_seg_t){ SEG_COOL, SEG_OUT_OFF, SEG_EXIT_NEVER, 0, 0, 0, 0 };
+    CHECK(profile_user_done());
+    check_plan(PROFILE_USER);
+    CHECK_EQ(traj_seg_start(1), 2 * STEP_MS);
+    CHECK_EQ(traj_setpoint(0), T(150));
+    CHECK_EQ(traj_setpoint(STEP_MS), T(150));
+    CHECK_EQ(traj_setpoint(2 * STEP_MS), T(120));
+    CHECK_EQ(traj_setpoint(END_MS), T(120));
+
+    return check_done("test-traj");
+}
@@ -0,0 +1,237 @@
+/**
+ * @file test-uart.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the serial ring buffers against a mocked USART
+ *
+ * uart.c is linked against the mock below instead of the simulated
+ * hardware: the characters written to the data register are collected in
+ * a line buffer, and the data register empty interrupt is only delivered
+ * when the test calls @c dre() , so the ring buffers can be filled up,
+ * wrapped around and overrun at will.
+ */
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "uart.h"
+#include "hal.h"
+#include "check.h"
+
+static char line[4096];          // characters sent by the mocked USART
+static unsigned line_len;
+static uint8_t dre_irq;          // data register empty interrupt enabled
+static unsigned busy;            // polls before the data register is empty
+
+void hal_uart_init()
+{
+}
+
+static ssize_t stream_write(void *cookie, const char *buf, size_t size)
+{
+    int (*put)(char, FILE *) = (int (*)(char, FILE *))cookie;
+    size_t i;
+    for (i = 0; i < size; i++)
+        put(buf[i], NULL);
+    return size;
+}
+
+FILE *hal_uart_stream(int (*put)(char, FILE *))
+{
+    cookie_io_functions_t funcs = { .write = stream_write };
+    FILE *f = fopencookie((void *)put, "w", funcs);
+    setvbuf(f, NULL, _IONBF, 0);
+    return f;
+}
+
+uint8_t hal_uart_tx_ready()
+{
+    if (busy == 0)
+        return 1;
+    busy--;
+    return 0;
+}
+
+void hal_uart_tx(char c)
+{
+    if (line_len < sizeof(line))
+        line[line_len++] = c;
+}
+
+void hal_uart_tx_irq(uint8_t on)
+{
+    dre_irq = on;
+}
+
+/**
+ * @brief Deliver up to @p n data register empty interrupts.
+ */
+static unsigned dre(unsigned n)
+{
+    unsigned i;
+    for (i = 0; i < n && dre_irq; i++)
+        hal_on_uart_tx();
+    return i;
+}
+
+/**
+ * @brief Write @p n characters of a counting pattern starting at @p start .
+ */
+static void send(unsigned start, unsigned n)
+{
+    unsigned i;
+    for (i = 0; i < n; i++)
+        fputc('a' + (start + i) % 26, uart_file);
+}
+
+/**
+ * @brief Check that the line carries the counting pattern from 0 on.
+ */
+static int line_in_order()
+{
+    unsigned i;
+    for (i = 0; i < line_len; i++)
+        if (line[i] != 'a' + i % 26)
+            return 0;
+    return 1;
+}
+
+static void test_tx()
+{
+    // nothing is sent before the interrupt fires, all of it in order after
+    send(0, 10);
+    CHECK(dre_irq);
+    CHECK_EQ(line_len, 0);
+    CHECK_EQ(dre(1000), 10);
+    CHECK(!dre_irq);
+    CHECK_EQ(line_len, 10);
+
+    // wrap around the ring several times in uneven pieces
+    unsigned sent = 10, i;
+    for (i = 0; i < 20; i++) {
+        send(sent, 37 + i);
+        sent += 37 + i;
+        dre(50);
+    }
+    dre(1000);
+    CHECK_EQ(line_len, sent);
+    CHECK(line_in_order());
+    CHECK(!dre_irq);
+
+    // overrun the ring without the interrupt being served
+    unsigned n = UART_TX_BUF_SIZE * 2;
+    busy = 5;
+    send(sent, n);
+#if UART_TX_POLICY == UART_TX_DROP
+    // whatever did not fit is dropped and counted
+    CHECK_EQ(dre(1000), UART_TX_BUF_SIZE - 1);
+    CHECK_EQ(uart_tx_dropped(), n - (UART_TX_BUF_SIZE - 1));
+    CHECK_EQ(line_len, sent + UART_TX_BUF_SIZE - 1);
+#else
+    // the writer sends the oldest character itself once the register is
+    // empty, so nothing is lost
+    CHECK_EQ(busy, 0);
+    CHECK_EQ(dre(1000), UART_TX_BUF_SIZE - 1);
+    CHECK_EQ(uart_tx_dropped(), 0);
+    CHECK_EQ(line_len, sent + n);
+#endif
+    CHECK(line_in_order());
+    CHECK(!dre_irq);
+}
+
+static void test_rx()
+{
+    unsigned i, n;
+
+    CHECK_EQ(uart_getc(), -1);
+
+    // interleaved reception and reading wraps the ring without a loss
+    char c = 0;
+    for (n = 0; n < 20; n++) {
+        for (i = 0; i < 13 + n; i++)
+            hal_on_uart_rx(c + i);
+        for (i = 0; i < 13 + n; i++)
+            if (!CHECK_EQ(uart_getc(), (unsigned char)(c + i)))
+                break;
+        c += 13 + n;
+    }
+    CHECK_EQ(uart_getc(), -1);
+    CHECK_EQ(uart_rx_dropped(), 0);
+
+    // characters received while the ring is full are dropped and counted,
+    // the ones already stored stay intact but for the newest one, which
+    // marks the gap
+    for (i = 0; i < 100; i++)
+        hal_on_uart_rx('0' + i % 10);
+    CHECK_EQ(uart_rx_dropped(), 100 - (UART_RX_BUF_SIZE - 1));
+    for (i = 0; i < UART_RX_BUF_SIZE - 2; i++)
+        if (!CHECK_EQ(uart_getc(), '0' + i % 10))
+            break;
+    CHECK_EQ(uart_getc(), 0);
+    CHECK_EQ(uart_getc(), -1);
+
+    // the drop counter saturates instead of wrapping around
+    for (i = 0; i < 70000; i++)
+        hal_on_uart_rx('x');
+    CHECK_EQ(uart_rx_dropped(), 0xffff);
+    for (i = 0; i < UART_RX_BUF_SIZE - 1; i++)
+        uart_getc();
+    CHECK_EQ(uart_getc(), -1);
+}
+
+static void test_msg()
+{
+    unsigned i;
+
+    // a message is sent as a whole when it is complete
+    line_len = 0;
+    uart_tx_begin();
+    send(0, 10);
+    CHECK(!dre_irq);
+    CHECK(uart_tx_end());
+    CHECK_EQ(dre(1000), 10);
+    CHECK(line_in_order());
+
+    // an empty one sends nothing
+    uart_tx_begin();
+    CHECK(uart_tx_end());
+    CHECK(!dre_irq);
+
+    // one that does not fit does not wait and is dropped completely, even
+    // if the buffer drains in the meantime
+    uint16_t dropped = uart_tx_dropped();
+    send(10, 100);
+    busy = 5;
+    uart_tx_begin();
+    send(110, UART_TX_BUF_SIZE - 100);
+    CHECK_EQ(busy, 5);
+    dre(1000);
+    send(110, 5);
+    CHECK(!uart_tx_end());
+    CHECK_EQ(uart_tx_dropped(), dropped + UART_TX_BUF_SIZE - 95);
+    CHECK(!dre_irq);
+    CHECK_EQ(line_len, 110);
+    busy = 0;
+
+    // whatever is written after it goes out as usual
+    send(110, 3);
+    CHECK_EQ(dre(1000), 3);
+    CHECK(line_in_order());
+
+    // the largest message that fits
+    uart_tx_begin();
+    for (i = 0; i < UART_TX_BUF_SIZE - 1; i++)
+        fputc('a' + (113 + i) % 26, uart_file);
+    CHECK(uart_tx_end());
+    CHECK_EQ(dre(1000), UART_TX_BUF_SIZE - 1);
+    CHECK(line_in_order());
+}
+
+int main()
+{
+    uart_init();
+    test_tx();
+    test_rx();
+    test_msg();
+    return check_done("test-uart");
+}
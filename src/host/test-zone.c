@@ -0,0 +1,120 @@
+/**
+ * @file test-zone.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Unit test of the per-zone temperature control
+ *
+ * Built with two heater zones and two thermocouples, the second zone on
+ * the first thermocouple and vice versa (see the Makefile). zone.c runs
+ * with the real PID controller against a mocked output stage: without a
+ * set point all zones get the output of the process; with one, each zone
+ * has to get the output of its own controller on the mean of the readings
+ * of its thermocouple since the last update, the same as a reference
+ * controller fed with that mean, and a zone without a current reading has
+ * to be switched off. The controllers restart with a new set point phase.
+ */
+#include "zone.h"
+#include "pid.h"
+#include "out.h"
+#include "check.h"
+
+#if OUT_ZONES != 2 || TEMP_CHANNELS != 2
+#error "test-zone is built with two zones and two thermocouples"
+#endif
+
+int16_t out_ff = OUT_FF_DEFAULT;
+
+static uint16_t zone_out[OUT_ZONES]; // outputs set through the mocked stage
+
+void out_set(uint16_t out)
+{
+    uint8_t z;
+    for (z = 0; z < OUT_ZONES; z++)
+        zone_out[z] = out;
+}
+
+void out_set_zone(uint8_t zone, uint16_t out)
+{
+    zone_out[zone] = out;
+}
+
+pid_state_t tune_pid()
+{
+    pid_state_t pid = pid_init(200, 2, 400);
+    pid_limit(&pid, 0, OUT_MAX);
+    pid_filter(&pid, 2000);
+    return pid;
+}
+
+int main()
+{
+    pid_state_t ref[OUT_ZONES];
+    int sp, i;
+
+    // without a set point all zones get the output of the process
+    zone_start();
+    zone_reading(0, 100 * 4);
+    zone_update(1234, 0, 3, 1000);
+    CHECK_EQ(zone_out[0], 1234);
+    CHECK_EQ(zone_out[1], 1234);
+
+    // each zone on its own thermocouple (zone 0 on channel 1 and zone 1 on
+    // channel 0, see ZONE_SENSORS), with the mean of the readings
+    ref[0] = ref[1] = tune_pid();
+    for (i = 0; i < 100; i++) {
+        sp = 4 * (100 + i);
+        zone_reading(1, sp - 40);
+        zone_reading(1, sp - 39);  // mean rounds up to sp - 39
+        zone_reading(0, sp + 8);
+        zone_reading(0, sp + 11);
+        zone_reading(0, sp + 12);  // mean rounds to sp + 10
+        zone_update(0, sp, 3, 1000);
+        CHECK_EQ(zone_out[0], pid_update(&ref[0], sp, sp - 39, OUT_FF, 1000));
+        CHECK_EQ(zone_out[1], pid_update(&ref[1], sp, sp + 10, OUT_FF, 1000));
+    }
+    CHECK(zone_out[0] > zone_out[1]); // the colder zone heats more
+
+    // a zone without a current reading is switched off; the other goes on
+    zone_reading(0, sp);
+    zone_update(0, sp, 1, 1000);
+    CHECK_EQ(zone_out[0], 0);
+    CHECK_EQ(zone_out[1], pid_update(&ref[1], sp, sp, OUT_FF, 1000));
+
+    // without new readings the last mean is used
+    zone_update(0, sp, 3, 1000);
+    CHECK_EQ(zone_out[1], pid_update(&ref[1], sp, sp, OUT_FF, 1000));
+
+    // many readings (held off updates): still their mean
+    for (i = 0; i < 1000; i++)
+        zone_reading(0, sp + (i % 2 ? 2 : -2));
+    zone_update(0, sp, 3, 1000);
+    CHECK_EQ(zone_out[1], pid_update(&ref[1], sp, sp, OUT_FF, 1000));
+
+    // negative temperatures round to nearest as well
+    zone_reading(0, -5);
+    zone_reading(0, -6);
+    zone_update(0, sp, 3, 1000);
+    CHECK_EQ(zone_out[1], pid_update(&ref[1], sp, -6, OUT_FF, 1000));
+
+    // a segment without a set point ends the phase, the next one starts
+    // with fresh controllers
+    zone_update(500, 0, 3, 1000);
+    CHECK_EQ(zone_out[0], 500);
+    CHECK_EQ(zone_out[1], 500);
+    ref[0] = ref[1] = tune_pid();
+    zone_reading(0, 150 * 4);
+    zone_reading(1, 140 * 4);
+    zone_update(0, 160 * 4, 3, 1000);
+    CHECK_EQ(zone_out[0], pid_update(&ref[0], 160 * 4, 140 * 4, OUT_FF, 1000));
+    CHECK_EQ(zone_out[1], pid_update(&ref[1], 160 * 4, 150 * 4, OUT_FF, 1000));
+
+    // and so does a new process
+    zone_start();
+    ref[1] = tune_pid();
+    zone_reading(0, 150 * 4);
+    zone_update(0, 160 * 4, 1, 1000);
+    CHECK_EQ(zone_out[1], pid_update(&ref[1], 160 * 4, 150 * 4, OUT_FF, 1000));
+
+    return check_done("test-zone");
+}
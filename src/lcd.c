@@ -0,0 +1,112 @@
+/**
+ * @file lcd.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Pretty print output data to the SparkFun 20x4 SerLCD module
+ */
+#include "lcd.h"
+
+static char fb[LCD_ROWS][LCD_COLS],    // frame buffer (what we want to show)
+            shown[LCD_ROWS][LCD_COLS]; // what the display currently shows
+static uint8_t row;                    // next line written by lcd_write()
+
+static uint8_t bl[3],                  // requested backlight (r, g, b)
+               bl_shown[3];            // backlight currently set
+
+// DDRAM address of the first character of each line (HD44780 layout)
+static const uint8_t row_addr[LCD_ROWS] = { 0, 64, 20, 84 };
+
+// first character of the backlight command for each color component
+static const uint8_t bl_base[3] = { 128, 158, 188 };
+
+void lcd_init()
+{
+    uint8_t r, c;
+    for (r = 0; r < LCD_ROWS; r++)
+        for (c = 0; c < LCD_COLS; c++)
+            shown[r][c] = ' ';
+
+    // the backlight state is unknown, force sending it on the first flush
+    for (c = 0; c < 3; c++)
+        bl_shown[c] = 0xff;
+
+    fputs("|-", uart_file);
+    lcd_clear();
+}
+
+int lcd_clear()
+{
+    uint8_t r, c;
+    for (r = 0; r < LCD_ROWS; r++)
+        for (c = 0; c < LCD_COLS; c++)
+            fb[r][c] = ' ';
+    row = 0;
+    return 0;
+}
+
+int lcd_backlight(uint8_t r, uint8_t g, uint8_t b)
+{
+    if (r > 30 || g > 30 || b > 30)
+        return -1;
+    bl[0] = r;
+    bl[1] = g;
+    bl[2] = b;
+    return 0;
+}
+
+int lcd_write(const char *line)
+{
+    if (row >= LCD_ROWS)
+        return -1;
+
+    char *buf = fb[row++];
+    uint8_t i;
+    for (i = 0; i < LCD_COLS && line[i] != 0; i++)
+        buf[i] = line[i];
+    for (; i < LCD_COLS; i++)
+        buf[i] = ' ';
+    return 0;
+}
+
+int lcd_flush()
+{
+    int sent = 0;
+    uint8_t r, c;
+
+    for (c = 0; c < 3; c++) {
+        if (bl[c] == bl_shown[c])
+            continue;
+        if (fputc('|', uart_file) == EOF || fputc(bl_base[c] + bl[c], uart_file) == EOF)
+            return -1;
+        bl_shown[c] = bl[c];
+        sent += 2;
+    }
+
+    for (r = 0; r < LCD_ROWS; r++) {
+        int8_t cursor = -1; // column of the display cursor, -1 if elsewhere
+        for (c = 0; c < LCD_COLS; c++) {
+            if (fb[r][c] == shown[r][c])
+                continue;
+
+            if (cursor >= 0 && c - cursor <= 2) {
+                // re-sending up to two unchanged characters is not more
+                // expensive than a cursor positioning command
+                for (; cursor < c; cursor++, sent++)
+                    if (fputc(shown[r][cursor], uart_file) == EOF)
+                        return -1;
+            } else if (cursor != c) {
+                if (fputc(254, uart_file) == EOF || fputc(128 + row_addr[r] + c, uart_file) == EOF)
+                    return -1;
+                sent += 2;
+            }
+
+            if (fputc(fb[r][c], uart_file) == EOF)
+                return -1;
+            shown[r][c] = fb[r][c];
+            cursor = c + 1;
+            sent++;
+        }
+    }
+    return sent;
+}
@@ -4,6 +4,11 @@
  * @date 2018-11-29
  *
  * @brief Pretty print output data to the SparkFun 20x4 SerLCD module
+ *
+ * All output is rendered into a shadow frame buffer. Nothing is sent to the
+ * display until @c lcd_flush() is called, which then only transmits the
+ * characters and backlight settings that differ from what the display
+ * currently shows.
  */
 
 #ifndef LCD_H
@@ -13,13 +18,24 @@
 
 #include "uart.h"
 
+#define LCD_COLS 20
+#define LCD_ROWS 4
+
+/**
+ * @brief Initialize the display.
+ *
+ * This function clears the display and resets the frame buffer. It must be
+ * called once after @c uart_init() .
+ */
+void lcd_init();
+
 /**
  * @brief Clear the display.
+ *
+ * This function blanks the frame buffer and moves the write position back
+ * to the first line.
  */
-static inline int lcd_clear()
-{
-    return fputs("|-", &uartout) != EOF ? 0 : -1;
-}
+int lcd_clear();
 
 #define LCD_BACKLIGHT_MAX 29
 
@@ -29,16 +45,7 @@ static inline int lcd_clear()
  * The backlight color can be specified using @p r for the red, @p g for the
  * green and @b for the blue component.
  */
-static inline int lcd_backlight(uint8_t r, uint8_t g, uint8_t b)
-{
-    if (r > 30 || g > 30 || b > 30)
-        return -1;
-    char buf[7] = "|r|g|b";
-    buf[1] = 128 + r;
-    buf[3] = 158 + g;
-    buf[5] = 188 + b;
-    return fputs(buf, &uartout) != EOF ? 0 : -1;
-}
+int lcd_backlight(uint8_t r, uint8_t g, uint8_t b);
 
 /**
  * @brief Write a line to the display.
@@ -47,25 +54,18 @@ static inline int lcd_backlight(uint8_t r, uint8_t g, uint8_t b)
  * Newline characters are ignored. Call this function again to write to the
  * next line of the display. Use @c lcd_clear() to clear the display.
  */
-static inline int lcd_write(const char *line)
-{
-    char buf[21];
-    int i;
-    for (i = 0; i < 20 && line[i] != 0; i++)
-        buf[i] = line[i];
-    for (; i < 20; i++)
-        buf[i] = ' ';
-    buf[20] = 0;
-    return fputs(buf, &uartout) != EOF ? 0 : -1;
-}
+int lcd_write(const char *line);
 
 /**
- * @brief Print a formatted line to the display.
+ * @brief Send pending changes to the display.
+ *
+ * This function compares the frame buffer with the content currently shown
+ * on the display and transmits only the changed characters (using cursor
+ * positioning commands to skip unchanged runs) and changed backlight
+ * components.
+ *
+ * The function returns the number of bytes sent or -1 in case of an error.
  */
-#define lcd_printf(...) {                                                      \
-    char line[21];                                                             \
-    snprintf(line, sizeof(line), __VA_ARGS__);                                 \
-    lcd_write(line);                                                           \
-}
+int lcd_flush();
 
 #endif // LCD_H
@@ -0,0 +1,19 @@
+/**
+ * @file main.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Program entry point
+ */
+#include "oven.h"
+#include "clock.h"
+
+int main()
+{
+    clock_init();
+    oven_init();
+
+    while (1)
+        oven_poll();
+    return 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file nvm.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Settings stored in the EEPROM
+ */
+#include "nvm.h"
+#include "hal.h"
+
+/**
+ * @brief Update the CRC-8 (polynomial 0x31, reflected) @p crc with @p len
+ * bytes of @p data .
+ */
+static uint8_t crc8(uint8_t crc, const uint8_t *data, uint16_t len)
+{
+    uint8_t i;
+    while (len--) {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8c : crc >> 1;
+    }
+    return crc;
+}
+
+uint8_t nvm_load(uint16_t addr, uint8_t version, void *data, uint16_t len)
+{
+    uint8_t stored_version, stored_crc, crc;
+
+    hal_eeprom_read(addr, &stored_version, 1);
+    hal_eeprom_read(addr + 1, data, len);
+    hal_eeprom_read(addr + 1 + len, &stored_crc, 1);
+
+    crc = crc8(0, &stored_version, 1);
+    crc = crc8(crc, data, len);
+    return stored_version == version && stored_crc == crc;
+}
+
+void nvm_save(uint16_t addr, uint8_t version, const void *data, uint16_t len)
+{
+    uint8_t crc;
+
+    crc = crc8(0, &version, 1);
+    crc = crc8(crc, data, len);
+
+    // invalidate the record while it is incomplete
+    hal_eeprom_write(addr, "\xff", 1);
+    hal_eeprom_write(addr + 1, data, len);
+    hal_eeprom_write(addr + 1 + len, &crc, 1);
+    hal_eeprom_write(addr, &version, 1);
+}
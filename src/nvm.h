@@ -0,0 +1,44 @@
+/**
+ * @file nvm.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Settings stored in the EEPROM
+ *
+ * Each record is stored as a version byte, the data and a CRC-8, so that an
+ * erased EEPROM (all 0xff), an incomplete write or a record of an older
+ * firmware is detected and the defaults are used instead.
+ */
+
+#ifndef NVM_H
+#define NVM_H
+
+#include <stdint.h>
+
+// EEPROM layout (address of each record, including version and CRC):
+#define NVM_GAINS       0x000   // controller gains (pid_gains_t, see tune.h)
+#define NVM_COAST       0x008   // coast gain (see coast.h)
+#define NVM_RUN         0x010   // last recorded run (see rec.h), up to the end
+
+/**
+ * @brief Size of a record with @p len bytes of data in the EEPROM.
+ */
+#define NVM_SIZE(len)   ((len) + 2)
+
+/**
+ * @brief Load the record at address @p addr .
+ *
+ * The @p len bytes of data are read into @p data . The function returns 1
+ * if the record is valid and has been written with the same @p version ,
+ * and 0 otherwise (in this case the contents of @p data are undefined).
+ */
+uint8_t nvm_load(uint16_t addr, uint8_t version, void *data, uint16_t len);
+
+/**
+ * @brief Store @p len bytes of @p data as record at address @p addr .
+ *
+ * @p version must not be 0xff.
+ */
+void nvm_save(uint16_t addr, uint8_t version, const void *data, uint16_t len);
+
+#endif // NVM_H
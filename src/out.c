@@ -0,0 +1,106 @@
+/**
+ * @file out.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Heater output stage
+ */
+#include "out.h"
+#include "hal.h"
+
+#define STEP ((uint32_t)OUT_MAX * OUT_QUANTUM) // one quantum in units of 1/OUT_MAX counts
+
+#ifdef HOST
+int16_t out_ff = OUT_FF_DEFAULT;
+#endif
+
+static uint8_t enabled;
+static uint16_t target[OUT_ZONES];  // requested output (0 to OUT_MAX)
+static uint16_t pending[OUT_ZONES]; // duty cycle of the next PWM period (written to the timer)
+#if OUT_DITHER
+static uint32_t error[OUT_ZONES];   // rounding error carried over (in units of 1/OUT_MAX counts)
+#endif
+
+/**
+ * @brief Calculate the duty cycle of zone @p z for the next PWM period.
+ */
+static uint16_t next_duty(uint8_t z)
+{
+#if OUT_DITHER
+    uint32_t duty = (error[z] + (uint32_t)target[z] * HAL_PWM_PERIOD) / STEP * OUT_QUANTUM;
+#else
+    uint32_t duty = ((uint32_t)target[z] * HAL_PWM_PERIOD + STEP / 2) / STEP * OUT_QUANTUM;
+#endif
+    return duty > HAL_PWM_PERIOD ? HAL_PWM_PERIOD : duty;
+}
+
+/**
+ * @brief Switch all zones off.
+ */
+static void clear()
+{
+    uint8_t z;
+
+    for (z = 0; z < OUT_ZONES; z++) {
+        target[z] = pending[z] = 0;
+#if OUT_DITHER
+        error[z] = 0;
+#endif
+    }
+}
+
+void out_init()
+{
+    clear();
+    hal_pwm_init();
+    hal_pwm_power(0);
+    enabled = 0;
+}
+
+void out_enable(uint8_t on)
+{
+    uint8_t z;
+
+    HAL_ATOMIC {
+        clear();
+        hal_pwm_power(on);
+        if (on)
+            for (z = 0; z < OUT_ZONES; z++)
+                hal_pwm_set(z, 0);
+        enabled = on;
+    }
+}
+
+void out_set_zone(uint8_t zone, uint16_t out)
+{
+    if (!enabled)
+        return;
+
+    HAL_ATOMIC {
+        target[zone] = out > OUT_MAX ? OUT_MAX : out;
+        pending[zone] = next_duty(zone);
+        hal_pwm_set(zone, pending[zone]);
+    }
+}
+
+void out_set(uint16_t out)
+{
+    uint8_t z;
+
+    for (z = 0; z < OUT_ZONES; z++)
+        out_set_zone(z, out);
+}
+
+void hal_on_pwm_period()
+{
+    uint8_t z;
+
+    // the pending duty cycles have just been latched, account for their errors
+    for (z = 0; z < OUT_ZONES; z++) {
+#if OUT_DITHER
+        error[z] += (uint32_t)target[z] * HAL_PWM_PERIOD - (uint32_t)pending[z] * OUT_MAX;
+#endif
+        pending[z] = next_duty(z);
+        hal_pwm_set(z, pending[z]);
+    }
+}
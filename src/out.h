@@ -0,0 +1,96 @@
+/**
+ * @file out.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Heater output stage
+ *
+ * Converts the output of the controllers (0 to @c OUT_MAX ) to the duty cycle
+ * of the heater PWM, using the full resolution of the timer. Each heater
+ * zone (@c OUT_ZONES of them, see @c HAL_PWM_CHANNELS ) has its own output.
+ */
+
+#ifndef OUT_H
+#define OUT_H
+
+#include <stdint.h>
+
+#include "hal.h"
+
+// number of heater zones (one PWM output each)
+#define OUT_ZONES HAL_PWM_CHANNELS
+
+/**
+ * @brief Controller output for 100 % heater power.
+ */
+#define OUT_MAX 8191
+
+/**
+ * @brief Feed-forward output of the temperature controllers (50 % heater
+ * power, the mean output during soak and bake).
+ *
+ * In the host build it is the variable @c out_ff , which host/sweep.c
+ * varies.
+ */
+#define OUT_FF_DEFAULT 4096
+
+#ifdef HOST
+extern int16_t out_ff;
+#define OUT_FF out_ff
+#else
+#define OUT_FF OUT_FF_DEFAULT
+#endif
+
+/**
+ * @brief Smallest step of the duty cycle in timer counts.
+ *
+ * The duty cycle is rounded to a multiple of this value. Use 1 for the full
+ * resolution of the timer, or the length of a mains half-cycle for a
+ * zero-crossing solid state relay (312 counts = 10 ms at 50 Hz and 32 MHz),
+ * which can only switch the heater in whole half-cycles anyway.
+ */
+#ifndef OUT_QUANTUM
+#define OUT_QUANTUM 1
+#endif
+
+/**
+ * @brief Carry the rounding error of the duty cycle over to the next period.
+ *
+ * If non-zero, the output stage works as a first-order sigma-delta modulator:
+ * the part of the requested duty cycle that was lost by rounding to
+ * @c OUT_QUANTUM is added to the following PWM periods, so that the mean
+ * heater power matches the controller output exactly. This matters with a
+ * coarse quantum or a short PWM period (see @c HAL_PWM_PERIOD ).
+ */
+#ifndef OUT_DITHER
+#define OUT_DITHER 0
+#endif
+
+/**
+ * @brief Initialize the heater output (off).
+ */
+void out_init();
+
+/**
+ * @brief Set the heater power of all zones.
+ *
+ * The output @p out (between 0 and @c OUT_MAX ) takes effect at the start
+ * of the next PWM period. It is ignored while the output stage is disabled.
+ */
+void out_set(uint16_t out);
+
+/**
+ * @brief Set the heater power of zone @p zone (like @c out_set() ).
+ */
+void out_set_zone(uint8_t zone, uint16_t out);
+
+/**
+ * @brief Enable (@p on non-zero) or disable the output stage.
+ *
+ * Disabling it switches the heaters off at once and powers the PWM timer
+ * down (see @c hal_pwm_power() ); enabling it starts with the heaters off.
+ * The output stage is disabled after @c out_init() .
+ */
+void out_enable(uint8_t on);
+
+#endif // OUT_H
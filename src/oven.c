@@ -6,248 +6,716 @@
  * @brief User interface and state control
  */
 
+#include "oven.h"
+#include "hal.h"
 #include "temp.h"
+#include "est.h"
 #include "reflow.h"
+#include "tune.h"
+#include "rec.h"
+#include "profile.h"
 #include "pid.h"
+#include "out.h"
+#include "zone.h"
+#include "cmd.h"
+#include "sched.h"
 
 #ifdef USE_LCD_DISP
 #include "lcd.h"
-#else
+#include "fmt.h"
+#endif
 #include "uart.h"
+
+#ifdef USE_TELEMETRY
+#ifdef USE_LCD_DISP
+#error "the serial line is needed for the LCD, telemetry requires the text build"
+#endif
+#include "telem.h"
+#include "ana.h"
 #endif
 
 #include <stdio.h>
-#include <avr/io.h>
-#include <avr/interrupt.h>
+
+// Temperature constants for the cold junction (IC temperature, multiply by 16):
+#define IC_OVERHEAT (40 * 16)   // temperature at which the IC is overheated (40 deg C)
+
+// Temperature constants for the hot junction (oven temperature, multiply by 4):
+#define OVEN_COOL   (50 * 4)    // temperature below which it is safe to open the oven (50 deg C)
+#define BAKE_TEMP   (125 * 4)    // default bake temperature
+
+#define EV_BUTTON   1           // start/stop button has been pressed
+
+#define LONG_PRESS  (2 * HAL_TICK_HZ) // ticks the button is held for a long press (2 s)
+
+// Task rates (must divide HAL_TICK_HZ):
+#ifndef SAMPLE_HZ
+#define SAMPLE_HZ   10          // thermocouple readings (MAX31855 converts in <= 100 ms)
+#endif
+#ifndef CONTROL_HZ
+#define CONTROL_HZ  1           // heater updates (averaging the readings in between)
+#endif
+#define DISPLAY_HZ  1           // display or serial output
+
+#if SAMPLE_HZ != EST_HZ
+#error "the temperature filter is tuned for EST_HZ readings per second"
+#endif
+
+#if HAL_TICK_HZ % SAMPLE_HZ || HAL_TICK_HZ % CONTROL_HZ || HAL_TICK_HZ % DISPLAY_HZ
+#error "task rates must divide HAL_TICK_HZ"
+#endif
+
+#define CONTROL_DT  (1000 / CONTROL_HZ) // time between heater updates (ms)
+
+// age of the last good reading at which the heater is switched off (ms)
+#ifndef TEMP_MAX_AGE
+#define TEMP_MAX_AGE 2000
+#endif
+#define MAX_AGE_TICKS ((uint16_t)((uint32_t)TEMP_MAX_AGE * HAL_TICK_HZ / 1000))
+
+// Weights of the thermocouple channels in the oven temperature (the first
+// TEMP_CHANNELS entries are used): the weighted mean of the channels with a
+// current reading is filtered and controlled, e.g. { 1, 3 } for an air and
+// a board thermocouple with more weight on the board.
+#ifndef TEMP_WEIGHTS
+#define TEMP_WEIGHTS { 1, 1, 1, 1 }
+#endif
+
+static const uint8_t temp_weights[4] = TEMP_WEIGHTS;
+
+static int mode = OVEN_MODE_IDLE; // OVEN_MODE_* (see oven.h)
+static pid_state_t pid_state;
+static int bake_time = 0, bake_level; // bake_level: heater power (%)
+static int bake_temp = BAKE_TEMP;
+static uint16_t bake_duration; // (s), 0: until stopped
+static uint8_t profile_sel = OVEN_PROFILE_JUMPER;
+static uint16_t bake_ms;
+static uint8_t hold; // ticks the button has been held in idle (0: not held)
+
+// last good reading of each thermocouple and its time (see sched_now()):
+static int chan_temp[TEMP_CHANNELS];
+static uint16_t sample_time[TEMP_CHANNELS];
+static uint8_t sampled; // channels with a good reading (bit per channel)
+
+// filtered thermocouple readings used for the last heater update:
+static int oven_temp, ic_temp, temp_error;
+
+static int heater_out;   // heater power of the last update
+static uint32_t run_ms;  // time since the start of the current mode (ms)
+
+#ifdef USE_LCD_DISP
+static int lcd_blink = 0;
+static uint8_t idle_shown; // 1 + jumper of the idle screen shown, 0: other screen
+#endif
+
+#ifdef USE_TELEMETRY
+static uint16_t rx_dropped; // uart_rx_dropped() at the last record
+#endif
+
+void hal_on_tick()
+{
+    sched_tick();
+}
+
+/**
+ * @brief Get the profile for a reflow: the selected one, or the one of the
+ * jumper.
+ */
+static uint8_t selected_profile()
+{
+    if (profile_sel != OVEN_PROFILE_JUMPER)
+        return profile_sel;
+    return hal_jumper() ? PROFILE_LEAD_FREE : PROFILE_LEADED;
+}
 
 /**
- * @brief Initialize the PWM output to steer the heater elements.
+ * @brief Get the channels whose last good reading is recent enough to
+ * control the heater (bit per channel).
  */
-void pwm_init()
+static uint8_t current()
 {
-    PORTE.DIRSET = 8;
+    uint8_t ch, cur = 0;
+    uint16_t now = sched_now();
 
-    // set period to 15360 (2 MHz, prescaler: 256 => period: 1.966 s)
-    TCE0.PERL = (15 * 1024) & 0xff;
-    TCE0.PERH = (15 * 1024) >> 8;
+    for (ch = 0; ch < TEMP_CHANNELS; ch++)
+        if ((sampled & (1 << ch)) && (uint16_t)(now - sample_time[ch]) <= MAX_AGE_TICKS)
+            cur |= 1 << ch;
+    return cur;
+}
 
-    // initiate duty cycle to 0
-    TCE0.CCDL = 0;
-    TCE0.CCDH = 0;
+/**
+ * @brief Take the last thermocouple readings and start the next ones.
+ *
+ * The weighted mean of the current readings updates the filtered oven
+ * temperature, the hottest cold junction is taken as the IC temperature.
+ */
+static void sample_task()
+{
+    temp_sample_t s;
+    uint8_t ch, fresh = 0, cur;
+    int32_t sum = 0;
+    uint16_t weights = 0;
+
+    for (ch = 0; ch < TEMP_CHANNELS; ch++)
+        if (temp_read(ch, &s)) {
+            chan_temp[ch] = s.hot;
+            sample_time[ch] = s.time;
+            sampled |= 1 << ch;
+            if (!fresh || s.cold > ic_temp)
+                ic_temp = s.cold;
+            fresh = 1;
+            zone_reading(ch, s.hot);
+        }
+    temp_start();
 
-    TCE0.CTRLB = 0x83; // enable CCD, activate single-slope PWM waveform generation
-    TCE0.CTRLA = 6; // prescaler: 256
+    if (!fresh)
+        return;
+    cur = current();
+    for (ch = 0; ch < TEMP_CHANNELS; ch++)
+        if (cur & (1 << ch)) {
+            sum += (int32_t)temp_weights[ch] * chan_temp[ch];
+            weights += temp_weights[ch];
+        }
+    if (weights != 0)
+        est_update((sum + (sum >= 0 ? weights / 2 : -(weights / 2))) / weights);
 }
 
 /**
- * @brief Initialize the update timer.
+ * @brief Return to idle mode at the end of a run.
  */
-void timer_init()
+static void stop()
 {
-    // set period to 1 s (2 MHz, prescaler: 64 => period: 31250)
-    TCC0.PERL = 31250 & 0xff;
-    TCC0.PERH = 31250 >> 8;
+    mode = OVEN_MODE_IDLE;
+    hal_led_set(0);
+    out_enable(0); // the heater must be off while the EEPROM is written
+    rec_stop();
+}
 
-    TCC0.INTCTRLA = 2; // enable overflow interrupt with level 2
-    TCC0.CTRLA = 5; // prescaler: 64
+/**
+ * @brief Restart the update timer and all tasks.
+ */
+static void restart()
+{
+    run_ms = 0;
+    hal_tick_restart();
+    sched_restart();
 }
 
 /**
- * @brief Restart the update timer.
+ * @brief Stop heating and let the oven cool down (after baking or an
+ * abort).
  */
-void timer_restart()
+static void cool()
 {
-    TCC0.CTRLFSET = 8; // write restart command to F register
-    TCC0.CTRLFCLR = 0xc; // clear command bits in F register
+    mode = OVEN_MODE_COOL;
 
-    TCC0.INTFLAGS = 1; // clear overflow interrupt (in case one is pending)
+    hal_led_set(0);
+    out_enable(0);
+    restart();
 }
 
-// Temperature constants for the cold junction (IC temperature, multiply by 16):
-#define IC_OVERHEAT (40 * 16)   // temperature at which the IC is overheated (40 deg C)
+/**
+ * @brief Calculate and set the heater output.
+ */
+static void control_task()
+{
+    int out, sp = 0;
+    uint8_t ch, cur = current(), used = 0;
+
+    // switch the heaters off while the last good readings of all weighted
+    // channels are too old, restart the filter with the next one; the PWM
+    // is powered down at once rather than at the end of its period (about
+    // 2 s), and powered up again when a reading is back
+    for (ch = 0; ch < TEMP_CHANNELS; ch++)
+        if (temp_weights[ch] != 0)
+            used |= 1 << ch;
+    uint8_t was_error = temp_error;
+    temp_error = !(cur & used);
+    if (temp_error) {
+        est_reset();
+        heater_out = 0;
+        out_enable(0);
+        return;
+    }
+    if (was_error && (mode == OVEN_MODE_REFLOW || mode == OVEN_MODE_BAKE || mode == OVEN_MODE_TUNE))
+        out_enable(1);
 
-// Temperature constants for the hot junction (oven temperature, multiply by 4):
-#define OVEN_COOL   (50 * 4)    // temperature below which it is safe to open the oven (50 deg C)
-#define BAKE_TEMP   (125 * 4)
+    oven_temp = est_temp();
+    run_ms += CONTROL_DT;
+    if (mode != OVEN_MODE_IDLE && run_ms % 1000 < CONTROL_DT)
+        rec_sample(oven_temp);
 
-static volatile int mode = 0; // oven mode; 0: idle, 1: reflow, 2: bake, 3: cool
-static pid_state_t pid_state;
-static int bake_time = 0;
+    if (ic_temp >= IC_OVERHEAT)
+        out = 0;
+    else
+        switch (mode) {
+            case OVEN_MODE_REFLOW:
+                out = reflow_update(oven_temp, CONTROL_DT);
+                if (reflow_pid(&sp) == NULL)
+                    sp = 0;
 
-#ifdef USE_LCD_DISP
-static int lcd_blink = 0;
+                if (out == 0 && oven_temp < OVEN_COOL)
+                    stop();
+
+                break;
+
+            case OVEN_MODE_BAKE:
+                out = pid_update(&pid_state, bake_temp, oven_temp, OUT_FF, CONTROL_DT);
+                sp = bake_temp;
+                bake_ms += CONTROL_DT;
+                if (bake_ms >= 1000) {
+                    bake_ms -= 1000;
+                    bake_time++;
+                }
+
+                bake_level = (out * 100L + OUT_MAX / 2) / OUT_MAX;
+                if (bake_duration != 0 && (uint16_t)bake_time >= bake_duration)
+                    cool();
+                break;
+
+            case OVEN_MODE_TUNE:
+                out = tune_update(oven_temp, CONTROL_DT);
+
+                if (out == 0 && oven_temp < OVEN_COOL)
+                    stop();
+                break;
+
+            case OVEN_MODE_COOL: // after baking
+                out = 0;
+                hal_led_toggle();
+
+                if (oven_temp < OVEN_COOL)
+                    stop();
+                break;
+
+            default: // idle
+                out = 0;
+                break;
+        }
+
+    heater_out = out;
+    zone_update(out, mode != OVEN_MODE_IDLE ? sp : 0, cur, CONTROL_DT);
+}
+
+#ifdef USE_TELEMETRY
+/**
+ * @brief Send a telemetry record of the last heater update.
+ */
+static void telem_task()
+{
+    const pid_state_t *pid = NULL;
+    int sp = 0;
+    telem_rec_t rec;
+    uint8_t frame[TELEM_FRAME_MAX], len, ch;
+
+    if (mode == OVEN_MODE_REFLOW)
+        pid = reflow_pid(&sp);
+    else if (mode == OVEN_MODE_BAKE) {
+        pid = &pid_state;
+        sp = bake_temp;
+    }
+
+    rec.time = run_ms;
+    rec.hot = oven_temp;
+    rec.rate = est_rate();
+    rec.cold = ic_temp;
+    rec.setpoint = sp;
+    if (pid != NULL)
+        pid_terms(pid, &rec.p, &rec.i, &rec.d);
+    else
+        rec.p = rec.i = rec.d = 0;
+    rec.out = heater_out;
+    rec.mode = mode;
+    rec.phase = mode == OVEN_MODE_REFLOW ? reflow_phase() : 0;
+    rec.flags = (temp_error ? TELEM_F_FAULT : 0) | (ic_temp >= IC_OVERHEAT ? TELEM_F_OVERHEAT : 0);
+    for (ch = 0; ch < TEMP_CHANNELS; ch++)
+        rec.flags |= temp_faults(ch) << TELEM_F_CAUSE_SHIFT;
+    if (uart_rx_dropped() != rx_dropped) {
+        rx_dropped = uart_rx_dropped();
+        rec.flags |= TELEM_F_RX_LOST;
+    }
+    if (mode == OVEN_MODE_REFLOW) {
+        ana_result_t res;
+        rec.verdict = ana_result(&res);
+        rec.ramp_up = res.ramp_up;
+        rec.ramp_down = res.ramp_down;
+        rec.peak = res.peak;
+        rec.tal = res.tal;
+        rec.near_peak = res.near_peak;
+        rec.soak = res.soak;
+    } else {
+        rec.verdict = rec.ramp_up = rec.ramp_down = 0;
+        rec.peak = 0;
+        rec.tal = rec.near_peak = rec.soak = 0;
+    }
+
+    hal_ram_t ram;
+    hal_ram_usage(&ram);
+    rec.stack = ram.stack;
+    rec.ram_free = ram.free;
+
+    len = telem_encode(&rec, frame);
+    fwrite(frame, 1, len, uart_file);
+}
 #endif
 
+#ifndef USE_TELEMETRY
 /**
- * @brief Update timer interrupt routine.
+ * @brief Get the first weighted thermocouple channel without a current
+ * reading.
  */
-ISR(TCC0_OVF_vect)
+static uint8_t failed_channel()
 {
-    char temp_buf[4][16];
+    uint8_t ch, cur = current();
 
-    int ic_temp, oven_temp;
+    for (ch = 0; ch < TEMP_CHANNELS; ch++)
+        if (temp_weights[ch] != 0 && !(cur & (1 << ch)))
+            return ch;
+    return 0;
+}
 
-    if (temp_read(&oven_temp, &ic_temp) < 0) {
+/**
+ * @brief Describe the fault of the latest reading of channel @p ch .
+ */
+static const char *fault_name(uint8_t ch)
+{
+    uint8_t f = temp_faults(ch);
+
+    if (f & TEMP_F_OC)
+        return "OPEN CIRCUIT";
+    if (f & TEMP_F_SCG)
+        return "SHORT TO GND";
+    if (f & TEMP_F_SCV)
+        return "SHORT TO VCC";
+    if (f & TEMP_F_BUS)
+        return "NO RESPONSE";
+    if (f & TEMP_F_FAULT)
+        return "FAULT";
+    return "NO READING";
+}
+
+/**
+ * @brief Show the oven state on the display or the serial output.
+ */
+static void display_task()
+{
+#ifdef USE_LCD_DISP
+    char line[LCD_COLS + 1], *p;
+
+    if (mode != OVEN_MODE_IDLE || temp_error || ic_temp >= IC_OVERHEAT)
+        idle_shown = 0;
+#else
+    char temp_buf[3][8];
+#endif
+
+    if (temp_error) {
+        uint8_t ch = failed_channel();
 #ifdef USE_LCD_DISP
         lcd_blink = (lcd_blink == 0) ? LCD_BACKLIGHT_MAX : 0;
         lcd_clear();
         lcd_backlight(lcd_blink, 0, 0);
-        lcd_printf("MAX31855 ERROR");
+        p = fmt_str(line, "MAX31855 ERROR");
+        if (TEMP_CHANNELS > 1) {
+            p = fmt_str(p, " #");
+            fmt_int(p, ch + 1, 0, ' ');
+        }
+        lcd_write(line);
+        lcd_write(fault_name(ch));
+        p = fmt_int(line, temp_failures(ch), 3, ' ');
+        fmt_str(p, " failed reads");
+        lcd_write(line);
+        lcd_write("HEATER OFF");
+        lcd_flush();
 #else
-        fprintf(&uartout, "ERROR: MAX31855 reports a fault condition\r\n");
+        if (TEMP_CHANNELS > 1)
+            fprintf(uart_file, "ERROR: MAX31855 #%u %s, %u failed readings, heater off\r\n",
+                    ch + 1, fault_name(ch), temp_failures(ch));
+        else
+            fprintf(uart_file, "ERROR: MAX31855 %s, %u failed readings, heater off\r\n",
+                    fault_name(ch), temp_failures(ch));
 #endif
         return;
     }
 
-    int32_t pid_out;
-    int out;
-
     if (ic_temp >= IC_OVERHEAT) {
 #ifdef USE_LCD_DISP
         lcd_blink = (lcd_blink == 0) ? LCD_BACKLIGHT_MAX : 0;
         lcd_clear();
         lcd_backlight(lcd_blink, 0, 0);
-        lcd_printf("!!! OVERHEATED !!!");
-        lcd_printf("Controller to hot!");
-        lcd_printf("Temp: %3d.%04d degC", ic_temp >> 4, (ic_temp & 0xf) * 625);
-        lcd_printf("HEATER OFF");
+        lcd_write("!!! OVERHEATED !!!");
+        lcd_write("Controller to hot!");
+        p = fmt_str(line, "Temp: ");
+        p = fmt_temp16(p, ic_temp, 3);
+        fmt_str(p, " degC");
+        lcd_write(line);
+        lcd_write("HEATER OFF");
 #else
-        fprintf(&uartout, "OVERHEATED: IC TEMP: %d.%04d\n", ic_temp >> 4, (ic_temp & 0xf) * 625);
+        fprintf(uart_file, "OVERHEATED: IC TEMP: %d.%04d\n", ic_temp >> 4, (ic_temp & 0xf) * 625);
 #endif
-        out = 0;
     } else
         switch (mode) {
-            case 0: // idle
+            case OVEN_MODE_IDLE:
 #ifdef USE_LCD_DISP
+                // the screen only changes with the jumper, skip redrawing it
+                if (idle_shown == 1 + selected_profile())
+                    return;
+                idle_shown = 1 + selected_profile();
                 lcd_clear();
                 lcd_backlight(0, 0, 0);
-                lcd_printf("Solder Reflow Oven");
-                lcd_printf("READY");
+                lcd_write("Solder Reflow Oven");
+                lcd_write("READY");
+                p = fmt_str(line, "Profile: ");
+                profile_name(p, selected_profile());
+                lcd_write(line);
 #endif
-                out = 0;
                 break;
 
-            case 1: // reflow
-                out = reflow_update(oven_temp);
-
-                if (out == 0 && oven_temp < OVEN_COOL) {
-                    mode = 0;
-                    PORTE.OUTCLR = 4;
-                }
-
+            case OVEN_MODE_REFLOW:
+                reflow_show();
                 break;
 
-            case 2: // bake
-                pid_out = pid_update(&pid_state, BAKE_TEMP - oven_temp);
-                bake_time++;
-
-                // limit out to [0,8191]
-                pid_out += 4096L;
-                if (pid_out < 0L)
-                    pid_out = 0L;
-                if (pid_out > 8191L)
-                    pid_out = 8191L;
-
-                // reduce out to 16 values
-                out = pid_out >> 9;
-
-                TEMP4_TO_STR(temp_buf[0], oven_temp);
-                TEMP4_TO_STR(temp_buf[1], pid_state.last_diff);
-                TEMP4_TO_STR(temp_buf[2], pid_state.integ);
+            case OVEN_MODE_BAKE:
 #ifdef USE_LCD_DISP
                 lcd_clear();
                 lcd_backlight(LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX, 0);
-                lcd_printf("BAKING    %2d:%02d:%02d", bake_time / 3600, (bake_time / 60) % 60, bake_time % 60);
-                lcd_printf("Temp: %3d.%02d degC", oven_temp >> 2, (oven_temp & 3) * 25);
-                lcd_printf("D: %s I: %s", temp_buf[1], temp_buf[2]);
-                lcd_printf("Heater: %d", out);
+                p = fmt_str(line, "BAKING    ");
+                fmt_hms(p, bake_time);
+                lcd_write(line);
+                p = fmt_str(line, "Temp: ");
+                p = fmt_temp4(p, oven_temp, 3);
+                fmt_str(p, " degC");
+                lcd_write(line);
+                p = fmt_str(line, "D: ");
+                p = fmt_temp4(p, pid_state.last_diff, 0);
+                p = fmt_str(p, " I: ");
+                fmt_temp4(p, pid_state.integ, 0);
+                lcd_write(line);
+                p = fmt_str(line, "Heater: ");
+                p = fmt_int(p, bake_level, 0, ' ');
+                fmt_str(p, " %");
+                lcd_write(line);
 #else
-                fprintf(&uartout, "%s\tdiff: %s\tinteg: %s\tout: %d\n", temp_buf[0], temp_buf[1], temp_buf[2], out);
+                TEMP4_TO_STR(temp_buf[0], oven_temp);
+                TEMP4_TO_STR(temp_buf[1], pid_state.last_diff);
+                TEMP4_TO_STR(temp_buf[2], pid_state.integ);
+                fprintf(uart_file, "%s\tdiff: %s\tinteg: %s\tout: %d%%\n", temp_buf[0], temp_buf[1], temp_buf[2], bake_level);
 #endif
-                //fprintf(&uartout, "%3d.%02d\tdiff: %d.%02d\tinteg: %d.%02d\tout: %d\n", oven_temp >> 2, (oven_temp & 3) * 25,
-                //        pid_state.last_diff >> 2, (pid_state.last_diff & 3) * 25, pid_state.integ >> 2, (pid_state.integ & 3) * 25, out);
-
-                out *= 1024;
                 break;
 
-            case 3: // cooling (after baking)
-                out = 0;
-                PORTE.OUTTGL = 4;
-
+            case OVEN_MODE_COOL: // after baking
 #ifdef USE_LCD_DISP
                 lcd_clear();
                 lcd_backlight(0, 0, LCD_BACKLIGHT_MAX);
-                lcd_printf("COOLING");
-                lcd_printf("Temp: %d.%02d degC", oven_temp >> 2, (oven_temp & 3) * 25);
+                lcd_write("COOLING");
+                p = fmt_str(line, "Temp: ");
+                p = fmt_temp4(p, oven_temp, 0);
+                fmt_str(p, " degC");
+                lcd_write(line);
 #endif
+                break;
 
-                if (oven_temp < OVEN_COOL) {
-                    mode = 0;
-                    PORTE.OUTCLR = 4;
-                }
+            case OVEN_MODE_TUNE:
+                tune_show();
                 break;
         }
 
-    TCE0.CCDBUFL = out & 0xff;
-    TCE0.CCDBUFH = out >> 8;
+#ifdef USE_LCD_DISP
+    lcd_flush();
+#endif
 }
+#endif
 
-/**
- * @brief Set up an interrupt for the start/stop button.
- */
-void button_init()
+void hal_on_button()
 {
-    PORTD.INT0MASK = 1; // add pin 0 to port interrupt 0
-    PORTD.PIN0CTRL = 2; // sense falling edge
-
-    PORTD.INTCTRL = 2; // activate port interrupt 0 with level 2
+    sched_post(EV_BUTTON);
 }
 
 /**
- * @brief Start/stop button interrupt routine.
+ * @brief Leave idle mode and start the process @p new_mode .
  */
-ISR(PORTD_INT0_vect)
+static void start(int new_mode)
 {
-    if (mode == 0) {
-        if (!(PORTD.IN & 2)) {
-            mode = 1;
-            reflow_start();
-        } else {
-            mode = 2;
-            pid_state = pid_init(160, 1, 0);
+    mode = new_mode;
+    switch (mode) {
+        case OVEN_MODE_REFLOW:
+            reflow_start(selected_profile());
+            break;
+
+        case OVEN_MODE_BAKE:
+            pid_state = tune_pid();
             bake_time = 0;
-        }
+            bake_ms = 0;
+            break;
 
-        PORTE.OUTSET = 4;
-        timer_restart();
+        case OVEN_MODE_TUNE:
+            tune_start();
+            break;
     }
-    else if (mode == 2 && bake_time > 1) {
-        mode = 3;
 
-        PORTE.OUTCLR = 4;
-        timer_restart();
-    }
+    rec_start(mode);
+    zone_start();
+    hal_led_set(1);
+    out_enable(1);
+    restart();
 }
 
 /**
- * @brief Program entry point.
+ * @brief Write the last recorded run to the serial line.
  */
-int main()
+static void dump()
 {
+    if (rec_load())
+        rec_dump();
+    else
+        uart_puts("# no run recorded\r\n");
+    oven_redraw();
+}
+
+/**
+ * @brief Handle a press of the start/stop button.
+ *
+ * In idle mode, the process starts when the button is released; holding
+ * it for 2 s instead starts the auto-tune with the switch at bake, or
+ * writes the last recorded run to the serial line with the switch at
+ * reflow (see button_task()).
+ */
+static void button_pressed()
+{
+    if (mode == OVEN_MODE_IDLE)
+        hold = 1;
+    else if ((mode == OVEN_MODE_BAKE && bake_time > 1) || mode == OVEN_MODE_TUNE)
+        cool();
+}
+
+/**
+ * @brief Tell a short from a long press of the start/stop button.
+ */
+static void button_task()
+{
+    if (hold == 0)
+        return;
+
+    if (!hal_button_down()) {
+        hold = 0;
+        // not while a profile is being uploaded to the selected slot
+        if (hal_switch_bake() || profile_valid(selected_profile()))
+            start(hal_switch_bake() ? OVEN_MODE_BAKE : OVEN_MODE_REFLOW);
+    } else if (++hold > LONG_PRESS) {
+        hold = 0;
+        if (hal_switch_bake())
+            start(OVEN_MODE_TUNE);
+        else
+            dump();
+    }
+}
+
+void oven_init()
+{
+    hal_power_init();
     uart_init();
+#ifdef USE_LCD_DISP
+    lcd_init();
+#endif
     temp_init();
+    tune_init();
+
+    hal_led_init();
+    out_init();
+
+    // tasks due in the same tick run in this order:
+    sched_add(button_task, 1);
+    sched_add(sample_task, HAL_TICK_HZ / SAMPLE_HZ);
+    sched_add(control_task, HAL_TICK_HZ / CONTROL_HZ);
+    sched_add(cmd_task, 1); // before the output, so that its reply fits
+#ifdef USE_TELEMETRY
+    sched_add(telem_task, HAL_TICK_HZ / CONTROL_HZ);
+#else
+    sched_add(display_task, HAL_TICK_HZ / DISPLAY_HZ);
+#endif
 
-    PORTE.DIRSET = 4;
-    PORTE.OUTCLR = 4;
+    hal_tick_init();
+    hal_button_init();
 
-    pwm_init();
-    timer_init();
-    button_init();
+    hal_irq_enable();
+}
 
-    // enable interrupts:
-    PMIC.CTRL = 0x02;
-    sei();
+void oven_poll()
+{
+    if (sched_events() & EV_BUTTON)
+        button_pressed();
+    sched_run();
+    sched_sleep();
+}
 
-    while (1);
-    return 0;
+int oven_mode()
+{
+    return mode;
+}
+
+uint8_t oven_start(int new_mode)
+{
+    if (mode != OVEN_MODE_IDLE || hold != 0)
+        return 0;
+    if (new_mode == OVEN_MODE_REFLOW && !profile_valid(selected_profile()))
+        return 0;
+    if (new_mode != OVEN_MODE_REFLOW && new_mode != OVEN_MODE_BAKE && new_mode != OVEN_MODE_TUNE)
+        return 0;
+
+    start(new_mode);
+    return 1;
+}
+
+uint8_t oven_abort()
+{
+    if (mode != OVEN_MODE_REFLOW && mode != OVEN_MODE_BAKE && mode != OVEN_MODE_TUNE)
+        return 0;
+
+    cool();
+    return 1;
+}
+
+void oven_set_bake(int temp, uint16_t duration)
+{
+    bake_temp = temp;
+    bake_duration = duration;
+}
+
+uint8_t oven_select_profile(uint8_t profile)
+{
+    if (profile != OVEN_PROFILE_JUMPER && !profile_valid(profile))
+        return 0;
+
+    profile_sel = profile;
+    return 1;
+}
+
+uint8_t oven_profile()
+{
+    return profile_sel;
+}
+
+void oven_status(oven_status_t *st)
+{
+    st->mode = mode;
+    st->phase = mode == OVEN_MODE_REFLOW ? reflow_phase() : 0;
+    st->profile = selected_profile();
+    st->flags = (temp_error ? 1 : 0) | (ic_temp >= IC_OVERHEAT ? 2 : 0);
+    st->temp = oven_temp;
+    st->setpoint = 0;
+    if (mode == OVEN_MODE_REFLOW) {
+        if (reflow_pid(&st->setpoint) == NULL)
+            st->setpoint = 0;
+    } else if (mode == OVEN_MODE_BAKE)
+        st->setpoint = bake_temp;
+    st->out = heater_out;
+    st->time = run_ms / 1000;
+    st->bake_temp = bake_temp;
+    st->bake_duration = bake_duration;
+}
+
+void oven_redraw()
+{
+#ifdef USE_LCD_DISP
+    lcd_init(); // the LCD has shown other output, redraw it
+    idle_shown = 0;
+#endif
 }
@@ -0,0 +1,104 @@
+/**
+ * @file oven.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief User interface and state control
+ */
+
+#ifndef OVEN_H
+#define OVEN_H
+
+#include <stdint.h>
+
+#define OVEN_MODE_IDLE   0
+#define OVEN_MODE_REFLOW 1
+#define OVEN_MODE_BAKE   2
+#define OVEN_MODE_COOL   3 // cooling after baking or an abort
+#define OVEN_MODE_TUNE   4 // controller auto-tune
+
+#define OVEN_PROFILE_JUMPER 0xff // reflow profile selected by the jumper
+
+typedef struct {
+    int mode;                // OVEN_MODE_*
+    uint8_t phase;           // segment of a reflow (0 in the other modes)
+    uint8_t profile;         // profile of the current or next reflow
+    uint8_t flags;           // 1: no recent thermocouple reading, 2: overheated (heater off)
+    int temp;                // filtered oven temperature (multiplied by 4)
+    int setpoint;            // (multiplied by 4), 0 if the heater is not controlled
+    int out;                 // heater power (0 to OUT_MAX)
+    uint32_t time;           // time since the start of the mode (s)
+    int bake_temp;           // bake temperature (multiplied by 4)
+    uint16_t bake_duration;  // bake duration (s), 0: until stopped
+} oven_status_t;
+
+/**
+ * @brief Initialize the peripherals and the oven state.
+ *
+ * This function must be called once at startup. It enables interrupts.
+ */
+void oven_init();
+
+/**
+ * @brief Do the pending work.
+ *
+ * This function handles button presses and runs the tasks that are due,
+ * then sleeps until the next interrupt if nothing is left to do. It must
+ * be called repeatedly from the main loop.
+ */
+void oven_poll();
+
+/**
+ * @brief Get the current oven mode (one of the OVEN_MODE_* constants).
+ */
+int oven_mode();
+
+/**
+ * @brief Start a reflow, bake or auto-tune (@p mode ) like the button.
+ *
+ * The function returns 1 if the process has been started and 0 if the
+ * oven is not idle, the button is held or the selected profile is invalid.
+ */
+uint8_t oven_start(int mode);
+
+/**
+ * @brief Abort a reflow, bake or auto-tune: the heater is switched off and
+ * the oven cools down.
+ *
+ * The function returns 0 if no process is running.
+ */
+uint8_t oven_abort();
+
+/**
+ * @brief Set the bake temperature @p temp (multiplied by 4) and the bake
+ * duration @p duration (s, 0 to bake until the button is pressed).
+ *
+ * The settings apply at once, also to a bake in progress.
+ */
+void oven_set_bake(int temp, uint16_t duration);
+
+/**
+ * @brief Select the reflow profile @p profile (see profile.h) for the
+ * following reflows, or @c OVEN_PROFILE_JUMPER to let the jumper select it.
+ *
+ * The function returns 0 if the profile is invalid.
+ */
+uint8_t oven_select_profile(uint8_t profile);
+
+/**
+ * @brief Get the reflow profile selection (see @c oven_select_profile() ).
+ */
+uint8_t oven_profile();
+
+/**
+ * @brief Get the state of the oven after the last heater update.
+ */
+void oven_status(oven_status_t *status);
+
+/**
+ * @brief Redraw the display after other output has been written to the
+ * serial line (does nothing without a display).
+ */
+void oven_redraw();
+
+#endif // OVEN_H
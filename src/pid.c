@@ -3,24 +3,104 @@
  * @author Michael Platzer
  * @date 2018-11-29
  *
- * @brief Simple PID controller
+ * @brief PID controller
  */
 #include "pid.h"
 
+/**
+ * @brief Add @p a and @p b , saturating instead of overflowing.
+ */
+static int32_t sat_add(int32_t a, int32_t b)
+{
+    if (b > 0 && a > INT32_MAX - b)
+        return INT32_MAX;
+    if (b < 0 && a < INT32_MIN - b)
+        return INT32_MIN;
+    return a + b;
+}
+
+/**
+ * @brief Limit @p x to the range of @c int16_t .
+ */
+static int16_t sat16(int32_t x)
+{
+    if (x > INT16_MAX)
+        return INT16_MAX;
+    if (x < INT16_MIN)
+        return INT16_MIN;
+    return x;
+}
+
 pid_state_t pid_init(int16_t P, int16_t I, int16_t D)
 {
-    pid_state_t state = { .P = P, .I = I, .D = D, .last_diff = 0, .integ = 0 };
+    pid_state_t state = { .P = P, .I = I, .D = D, .out_min = INT16_MIN, .out_max = INT16_MAX,
+                          .tau = 0, .last_diff = 0, .integ = 0, .integ_frac = 0,
+                          .last_meas = 0, .deriv = 0, .started = 0 };
     return state;
 }
 
-int32_t pid_update(pid_state_t *state, int16_t diff)
+void pid_limit(pid_state_t *state, int16_t min, int16_t max)
+{
+    state->out_min = min;
+    state->out_max = max;
+}
+
+void pid_filter(pid_state_t *state, uint16_t tau)
 {
-    int16_t deriv_diff = diff - state->last_diff;
+    state->tau = tau;
+}
+
+int16_t pid_update(pid_state_t *state, int16_t sp, int16_t meas, int16_t ff, uint16_t dt)
+{
+    int16_t diff = sat16((int32_t)sp - meas);
     state->last_diff = diff;
-    state->integ += diff;
 
-    int32_t sum = ((int32_t)state->P) * ((int32_t)diff);
-    sum += ((int32_t)state->I) * ((int32_t)state->integ);
-    sum += ((int32_t)state->D) * ((int32_t)deriv_diff);
-    return sum;
+    if (dt == 0)
+        dt = 1;
+
+    // derivative of the measurement (per second), low pass filtered; there
+    // is none for the first update
+    if (!state->started) {
+        state->last_meas = meas;
+        state->started = 1;
+    }
+    int32_t deriv = sat16(((int32_t)meas - state->last_meas) * 1000 / dt);
+    state->last_meas = meas;
+    int32_t alpha = ((uint32_t)dt << 8) / ((uint32_t)state->tau + dt); // 1 to 256
+    state->deriv += (deriv * 64 - state->deriv) * alpha / 256;
+
+    // integrate diff over dt ms, keeping the fraction of a second
+    int32_t frac = state->integ_frac + (int32_t)diff * dt;
+    int16_t integ = sat16(state->integ + frac / 1000);
+
+    int32_t out = ff;
+    out = sat_add(out, (int32_t)state->P * diff);
+    deriv = (state->deriv + (state->deriv < 0 ? -32 : 32)) / 64;
+    out = sat_add(out, -(int32_t)state->D * deriv);
+    int32_t out_integ = sat_add(out, (int32_t)state->I * integ);
+
+    // anti-windup: do not integrate further into saturation
+    int32_t change = (int32_t)state->I * (integ - state->integ);
+    if ((out_integ > state->out_max && change > 0) || (out_integ < state->out_min && change < 0)) {
+        out = sat_add(out, (int32_t)state->I * state->integ);
+    } else {
+        state->integ = integ;
+        state->integ_frac = frac % 1000;
+        out = out_integ;
+    }
+
+    if (out > state->out_max)
+        return state->out_max;
+    if (out < state->out_min)
+        return state->out_min;
+    return out;
+}
+
+void pid_terms(const pid_state_t *state, int16_t *p, int16_t *i, int16_t *d)
+{
+    int32_t deriv = (state->deriv + (state->deriv < 0 ? -32 : 32)) / 64;
+
+    *p = sat16((int32_t)state->P * state->last_diff);
+    *i = sat16((int32_t)state->I * state->integ);
+    *d = sat16(-(int32_t)state->D * deriv);
 }
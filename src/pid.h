@@ -3,7 +3,12 @@
  * @author Michael Platzer
  * @date 2018-11-29
  *
- * @brief Simple PID controller
+ * @brief PID controller
+ *
+ * Fixed-point PID controller with output limits, anti-windup (conditional
+ * integration), derivative on the measurement with a first-order filter and
+ * a feed-forward input. All intermediate results saturate instead of
+ * overflowing.
  */
 
 #ifndef PID_H
@@ -13,7 +18,17 @@
 
 typedef struct {
     int16_t P, I, D;
+} pid_gains_t;
+
+typedef struct {
+    int16_t P, I, D;
+    int16_t out_min, out_max; // output limits
+    uint16_t tau;       // time constant of the derivative filter (ms)
     int16_t last_diff, integ;
+    int16_t integ_frac; // fraction of integ (in 1/1000)
+    int16_t last_meas;  // last measurement (for the derivative)
+    int32_t deriv;      // filtered derivative of the measurement (per second, times 64)
+    uint8_t started;    // whether last_meas is valid
 } pid_state_t;
 
 /**
@@ -21,24 +36,55 @@ typedef struct {
  *
  * This function initializes a PID controller with the specified gain
  * parameters: @p P for the proportional gain, @p I for the integral gain
- * and @p D for the differential gain.
+ * and @p D for the differential gain. The integral and differential gains
+ * refer to a time base of one second.
+ *
+ * The output is limited to the range of @c int16_t and the derivative is
+ * not filtered; use @c pid_limit() and @c pid_filter() to change this.
  *
  * The function returns a PID state type, which has been initialized
  * accordingly.
  */
 pid_state_t pid_init(int16_t P, int16_t I, int16_t D);
 
+/**
+ * @brief Limit the output of a PID controller to [ @p min , @p max ].
+ *
+ * While the output is saturated, the integral is not increased any further
+ * in the direction of the saturation.
+ */
+void pid_limit(pid_state_t *state, int16_t min, int16_t max);
+
+/**
+ * @brief Set the time constant @p tau (in ms) of the derivative filter.
+ *
+ * The derivative of the measurement is passed through a first-order low
+ * pass filter, which damps the amplification of sensor noise. A value of
+ * 0 disables the filter.
+ */
+void pid_filter(pid_state_t *state, uint16_t tau);
+
 /**
  * @brief Update the state of a PID controller with a new input.
  *
  * This function updates the state of a PID controller with a new input
- * value. @p state is a pointer to the PID state type of the controller
- * and @p diff is the difference between the actual and the target value
- * of the system.
+ * value. @p state is a pointer to the PID state type of the controller,
+ * @p sp is the set point, @p meas the measured value of the system and
+ * @p dt is the time since the last update in ms.
+ *
+ * The differential term acts on the measurement only, hence changes of the
+ * set point do not cause output spikes. @p ff is added to the output as a
+ * feed-forward term (e.g. the expected output needed to hold @p sp ).
  *
  * The function updates the state of the PID controller and returns the
- * new output value of the controller.
+ * new output value of the controller, limited as set by @c pid_limit() .
+ */
+int16_t pid_update(pid_state_t *state, int16_t sp, int16_t meas, int16_t ff, uint16_t dt);
+
+/**
+ * @brief Get the proportional (@p p ), integral (@p i ) and differential
+ * (@p d ) term of the last output of a PID controller.
  */
-int32_t pid_update(pid_state_t *state, int16_t diff);
+void pid_terms(const pid_state_t *state, int16_t *p, int16_t *i, int16_t *d);
 
 #endif // PID_H
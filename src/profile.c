@@ -0,0 +1,143 @@
+/**
+ * @file profile.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Reflow profiles
+ */
+#include "profile.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Temperatures are multiplied by 4:
+#define T(deg) ((deg) * 4)
+
+// The limits follow J-STD-020 (ramp-up 3 degC/s, ramp-down 6 degC/s, 60 to
+// 150 s above liquidus, at most 30 s (SnPb) or 40 s (SAC) within 5 degC of
+// the peak). The soak time (60 to 180 s) and the minimum peak temperature
+// (25 degC above liquidus) are typical solder paste recommendations; the
+// peak may exceed the one of the profile by 5 degC.
+
+const profile_t profiles[PROFILE_BUILTIN] PROGMEM = {
+    [PROFILE_LEADED] = {
+        .name = "Sn63Pb37",
+        .liquidus = T(183),
+        .limits = { 30, 60, 60, 180, 60, 150, T(208), T(240), 30 },
+        .num_segs = 9,
+        .segs = {
+            { SEG_PREHEAT,       SEG_OUT_FULL, SEG_EXIT_ABOVE,         0,          T(100),   0, 0 },
+            { SEG_SOAK,          SEG_OUT_PID,  SEG_EXIT_TIME,          SEG_F_SOAK, T(120), 120, 0 },
+            { SEG_RAMP,          SEG_OUT_FULL, SEG_EXIT_ABOVE,         SEG_F_SOAK, T(150),   0, 0 },
+            { SEG_RAMP_LIQUIDUS, SEG_OUT_FULL, SEG_EXIT_ABOVE,         0,          T(183),   0, 0 },
+            { SEG_LIQUIDUS,      SEG_OUT_FULL, SEG_EXIT_PREDICT,       0,          T(235),   0, 0 },
+            { SEG_COAST,         SEG_OUT_OFF,  SEG_EXIT_ABOVE_OR_TIME, 0,          T(235),   5, 0 },
+            { SEG_PEAK,          SEG_OUT_OFF,  SEG_EXIT_BELOW,         0,          T(235),   0, 0 },
+            { SEG_CHILL,         SEG_OUT_OFF,  SEG_EXIT_BELOW,         0,          T(183),   0, 0 },
+            { SEG_COOL,          SEG_OUT_OFF,  SEG_EXIT_NEVER,         0,          0,        0, 0 },
+        },
+    },
+    [PROFILE_LEAD_FREE] = {
+        .name = "SAC305",
+        .liquidus = T(217),
+        .limits = { 30, 60, 60, 180, 60, 150, T(242), T(250), 40 },
+        .num_segs = 9,
+        .segs = {
+            { SEG_PREHEAT,       SEG_OUT_FULL, SEG_EXIT_ABOVE,         0,          T(150),   0, 0 },
+            { SEG_SOAK,          SEG_OUT_PID,  SEG_EXIT_TIME,          SEG_F_SOAK, T(175),  90, 0 },
+            { SEG_RAMP,          SEG_OUT_FULL, SEG_EXIT_ABOVE,         SEG_F_SOAK, T(200),   0, 0 },
+            { SEG_RAMP_LIQUIDUS, SEG_OUT_FULL, SEG_EXIT_ABOVE,         0,          T(217),   0, 0 },
+            { SEG_LIQUIDUS,      SEG_OUT_FULL, SEG_EXIT_PREDICT,       0,          T(245),   0, 0 },
+            { SEG_COAST,         SEG_OUT_OFF,  SEG_EXIT_ABOVE_OR_TIME, 0,          T(245),   5, 0 },
+            { SEG_PEAK,          SEG_OUT_OFF,  SEG_EXIT_BELOW,         0,          T(245),   0, 0 },
+            { SEG_CHILL,         SEG_OUT_OFF,  SEG_EXIT_BELOW,         0,          T(217),   0, 0 },
+            { SEG_COOL,          SEG_OUT_OFF,  SEG_EXIT_NEVER,         0,          0,        0, 0 },
+        },
+    },
+};
+
+static profile_t user;      // uploaded profile
+static uint8_t user_valid;
+
+/**
+ * @brief Copy @p len bytes at offset @p offset of profile number
+ * @p profile to @p buf .
+ */
+static void copy(uint8_t profile, size_t offset, void *buf, size_t len)
+{
+    if (profile == PROFILE_USER)
+        memcpy(buf, (const char *)&user + offset, len);
+    else
+        memcpy_P(buf, (const char *)&profiles[profile] + offset, len);
+}
+
+char *profile_name(char *buf, uint8_t profile)
+{
+    uint8_t i;
+    for (i = 0; i < sizeof(user.name); i++) {
+        copy(profile, offsetof(profile_t, name) + i, buf, 1);
+        if (*buf == 0)
+            break;
+        if (!PROFILE_NAME_CHAR(*buf))
+            *buf = '?';
+        buf++;
+    }
+    *buf = 0;
+    return buf;
+}
+
+uint8_t profile_valid(uint8_t profile)
+{
+    return profile < PROFILE_BUILTIN || (profile == PROFILE_USER && user_valid);
+}
+
+uint8_t profile_num_segs(uint8_t profile)
+{
+    uint8_t n;
+    copy(profile, offsetof(profile_t, num_segs), &n, sizeof(n));
+    return n;
+}
+
+void profile_seg(uint8_t profile, uint8_t i, profile_seg_t *seg)
+{
+    copy(profile, offsetof(profile_t, segs) + i * sizeof(*seg), seg, sizeof(*seg));
+}
+
+void profile_limits(uint8_t profile, profile_limits_t *lim)
+{
+    copy(profile, offsetof(profile_t, limits), lim, sizeof(*lim));
+}
+
+int16_t profile_liquidus(uint8_t profile)
+{
+    int16_t liquidus;
+    copy(profile, offsetof(profile_t, liquidus), &liquidus, sizeof(liquidus));
+    return liquidus;
+}
+
+profile_t *profile_user_edit()
+{
+    user_valid = 0;
+    memset(&user, 0, sizeof(user));
+    return &user;
+}
+
+uint8_t profile_user_done()
+{
+    uint8_t i;
+
+    if (user.num_segs == 0 || user.num_segs > PROFILE_MAX_SEGS)
+        return 0;
+    for (i = 0; i < user.num_segs; i++) {
+        const profile_seg_t *s = &user.segs[i];
+        if (s->kind > SEG_COOL || s->out > SEG_OUT_PID || s->exit > SEG_EXIT_PREDICT ||
+            s->temp < 0 || s->temp > PROFILE_TEMP_MAX)
+            return 0;
+    }
+    if (user.segs[user.num_segs - 1].out != SEG_OUT_OFF)
+        return 0;
+
+    user.name[sizeof(user.name) - 1] = 0;
+    user_valid = 1;
+    return 1;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file profile.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Reflow profiles
+ *
+ * A reflow profile is a sequence of segments. Each segment specifies how
+ * the heater is driven and when the next segment begins. The built-in
+ * profiles are stored in flash, one more can be uploaded over the serial
+ * line into RAM (see cmd.h); they are interpreted by @c reflow_update() .
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#include "hal.h"
+
+// Segment kinds (determine what is shown on the display):
+#define SEG_PREHEAT       0 // heating up to the soak temperature
+#define SEG_SOAK          1 // holding the soak temperature
+#define SEG_RAMP          2 // heating up to the end of the soak zone
+#define SEG_RAMP_LIQUIDUS 3 // heating up to the liquidus temperature
+#define SEG_LIQUIDUS      4 // heating above the liquidus temperature
+#define SEG_COAST         5 // heater off, temperature still rising
+#define SEG_PEAK          6 // above the peak temperature
+#define SEG_CHILL         7 // cooling down to the liquidus temperature
+#define SEG_COOL          8 // cooling down below the liquidus temperature
+
+// Heater output:
+#define SEG_OUT_FULL 0 // 100 %
+#define SEG_OUT_OFF  1 // 0 %
+#define SEG_OUT_PID  2 // regulate to the segment temperature
+
+// Conditions for leaving a segment:
+#define SEG_EXIT_ABOVE 0 // temperature reached the segment temperature
+#define SEG_EXIT_BELOW 1 // temperature fell below the segment temperature
+#define SEG_EXIT_TIME  2 // segment time elapsed
+#define SEG_EXIT_ABOVE_OR_TIME 3 // whichever comes first
+#define SEG_EXIT_NEVER 4 // last segment
+#define SEG_EXIT_PREDICT 5 // predicted peak after switching the heater off
+                           // reached the segment temperature (see coast.h)
+
+// Segment flags:
+#define SEG_F_SOAK 1 // segment is part of the soak zone (for the soak time)
+
+typedef struct {
+    uint8_t kind;  // one of SEG_PREHEAT ... SEG_COOL
+    uint8_t out;   // one of SEG_OUT_*
+    uint8_t exit;  // one of SEG_EXIT_*
+    uint8_t flags; // SEG_F_* bits
+    int16_t temp;  // exit temperature and set point (multiplied by 4)
+    uint16_t time; // segment time (s)
+    uint8_t rate;  // max. set point ramp rate for SEG_OUT_PID (0.1 degC/s), 0: step
+} profile_seg_t;
+
+#define PROFILE_MAX_SEGS 10
+
+/**
+ * @brief Limits a reflow process must stay within (see ana.h).
+ */
+typedef struct {
+    uint8_t ramp_up, ramp_down;  // max. ramp rates (0.1 degC/s)
+    uint16_t soak_min, soak_max; // soak time (s)
+    uint16_t tal_min, tal_max;   // time above liquidus (s)
+    int16_t peak_min, peak_max;  // peak temperature (multiplied by 4)
+    uint16_t near_peak_max;      // max. time within 5 degC of the peak (s)
+} profile_limits_t;
+
+typedef struct {
+    char name[10];     // name shown on the display
+    int16_t liquidus;  // liquidus temperature (multiplied by 4)
+    profile_limits_t limits;
+    uint8_t num_segs;
+    profile_seg_t segs[PROFILE_MAX_SEGS];
+} profile_t;
+
+#define PROFILE_LEADED    0 // Sn63/Pb37
+#define PROFILE_LEAD_FREE 1 // SAC305
+#define PROFILE_BUILTIN   2 // number of built-in profiles
+#define PROFILE_USER      2 // uploaded profile
+#define PROFILE_COUNT     3
+
+// highest segment temperature of an uploaded profile (multiplied by 4)
+#define PROFILE_TEMP_MAX  (260 * 4)
+
+/**
+ * @brief Built-in profiles (in flash).
+ */
+extern const profile_t profiles[PROFILE_BUILTIN] PROGMEM;
+
+// whether the character @p c may appear in a profile name: printable
+// ASCII except '|', which the SerLCD takes for the start of a command
+#define PROFILE_NAME_CHAR(c) ((c) > ' ' && (c) <= '~' && (c) != '|')
+
+/**
+ * @brief Write the name of profile number @p profile to a string buffer.
+ *
+ * Characters not allowed by @c PROFILE_NAME_CHAR() are written as '?'.
+ * Like the functions in fmt.h this returns a pointer to the terminating
+ * null character.
+ */
+char *profile_name(char *buf, uint8_t profile);
+
+/**
+ * @brief Check whether profile number @p profile can be used.
+ *
+ * The built-in profiles always can, the uploaded one once it has been
+ * checked by @c profile_user_done() .
+ */
+uint8_t profile_valid(uint8_t profile);
+
+/**
+ * @brief Get the number of segments of profile number @p profile .
+ */
+uint8_t profile_num_segs(uint8_t profile);
+
+/**
+ * @brief Copy segment @p i of profile number @p profile to @p seg .
+ */
+void profile_seg(uint8_t profile, uint8_t i, profile_seg_t *seg);
+
+/**
+ * @brief Copy the limits of profile number @p profile to @p lim .
+ */
+void profile_limits(uint8_t profile, profile_limits_t *lim);
+
+/**
+ * @brief Get the liquidus temperature of profile number @p profile
+ * (multiplied by 4).
+ */
+int16_t profile_liquidus(uint8_t profile);
+
+/**
+ * @brief Start uploading a profile.
+ *
+ * The uploaded profile becomes invalid and is cleared; the returned buffer
+ * is filled in by the caller and checked by @c profile_user_done() .
+ */
+profile_t *profile_user_edit();
+
+/**
+ * @brief Finish uploading a profile.
+ *
+ * The function returns 1 if the profile is usable: 1 to
+ * @c PROFILE_MAX_SEGS segments with valid kinds, outputs and exit
+ * conditions, temperatures up to @c PROFILE_TEMP_MAX and the heater off in
+ * the last segment. Otherwise it returns 0 and the profile stays invalid.
+ */
+uint8_t profile_user_done();
+
+#endif // PROFILE_H
@@ -0,0 +1,204 @@
+/**
+ * @file rec.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Record the oven temperature of a run
+ */
+#include "rec.h"
+#include "nvm.h"
+#include "hal.h"
+#include "temp.h"
+#include "uart.h"
+
+#define REC_VERSION 1   // version of the run record in the EEPROM
+
+typedef struct {
+    rec_head_t head;
+    uint8_t data[REC_SIZE];
+} rec_t;
+
+_Static_assert(NVM_RUN + NVM_SIZE(sizeof(rec_t)) <= HAL_EEPROM_SIZE, "REC_SIZE too large for the EEPROM");
+
+static rec_t rec;
+static int last;        // last recorded sample
+static uint8_t ticks;   // seconds since the last recorded sample
+
+/**
+ * @brief Append @p delta to the buffer at position @p pos .
+ *
+ * The function returns the new position, or 0 if @p delta does not fit.
+ */
+static uint16_t put(uint16_t pos, int delta)
+{
+    uint16_t zz = ((uint16_t)delta << 1) ^ (uint16_t)(delta < 0 ? -1 : 0);
+
+    for (;;) {
+        if (pos >= REC_SIZE)
+            return 0;
+        if (zz < 0x80) {
+            rec.data[pos++] = zz;
+            return pos;
+        }
+        rec.data[pos++] = zz | 0x80;
+        zz >>= 7;
+    }
+}
+
+/**
+ * @brief Read a difference from the buffer at position @p pos into
+ * @p delta .
+ *
+ * The function returns the new position, or 0 if the buffer ends first.
+ */
+static uint16_t get(uint16_t pos, int *delta)
+{
+    uint16_t zz = 0;
+    uint8_t shift = 0, b;
+
+    do {
+        if (pos >= rec.head.len || shift > 14)
+            return 0;
+        b = rec.data[pos++];
+        zz |= (uint16_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    *delta = (int16_t)((zz >> 1) ^ -(zz & 1));
+    return pos;
+}
+
+/**
+ * @brief Drop every other sample and double the interval.
+ *
+ * The differences are merged in place: the encoding of the sum of two
+ * differences is never longer than both encodings together, hence the
+ * write position never overtakes the read position.
+ */
+static void compact()
+{
+    uint16_t r = 0, w = 0, n;
+    int d1, d2;
+
+    for (n = 1; n + 2 <= rec.head.count; n += 2) {
+        r = get(r, &d1);
+        r = get(r, &d2);
+        w = put(w, d1 + d2);
+    }
+
+    // an odd number of differences is left: the newest sample is dropped
+    if (n < rec.head.count) {
+        get(r, &d1);
+        last -= d1;
+    }
+
+    rec.head.len = w;
+    rec.head.count = (rec.head.count + 1) / 2;
+    rec.head.interval *= 2;
+}
+
+void rec_start(uint8_t mode)
+{
+    rec.head.mode = mode;
+    rec.head.interval = 1;
+    rec.head.count = 0;
+    rec.head.len = 0;
+    ticks = 0;
+}
+
+void rec_sample(int temp)
+{
+    uint16_t pos;
+
+    if (++ticks < rec.head.interval)
+        return;
+    ticks = 0;
+
+    if (rec.head.count == 0) {
+        rec.head.first = last = temp;
+        rec.head.count = 1;
+        return;
+    }
+
+    while ((pos = put(rec.head.len, temp - last)) == 0) {
+        if (rec.head.interval >= 128)
+            return; // give up (after more than a day)
+
+        // the sample is skipped if it is off the new interval
+        uint8_t odd = rec.head.count % 2;
+        compact();
+        if (odd) {
+            ticks = rec.head.interval / 2;
+            return;
+        }
+    }
+
+    rec.head.len = pos;
+    rec.head.count++;
+    last = temp;
+}
+
+void rec_stop()
+{
+    if (rec.head.count > 0)
+        nvm_save(NVM_RUN, REC_VERSION, &rec, sizeof(rec.head) + rec.head.len);
+}
+
+uint8_t rec_load()
+{
+    // the length of the record is needed first (the header follows the
+    // version byte, see nvm.h)
+    hal_eeprom_read(NVM_RUN + 1, &rec.head, sizeof(rec.head));
+    if (rec.head.len > REC_SIZE)
+        return 0;
+    return nvm_load(NVM_RUN, REC_VERSION, &rec, sizeof(rec.head) + rec.head.len);
+}
+
+const rec_head_t *rec_head()
+{
+    return &rec.head;
+}
+
+uint8_t rec_next(rec_iter_t *iter, int *temp)
+{
+    int delta;
+
+    if (iter->index >= rec.head.count)
+        return 0;
+
+    if (iter->index == 0)
+        iter->temp = rec.head.first;
+    else {
+        iter->pos = get(iter->pos, &delta);
+        if (iter->pos == 0) {
+            iter->index = rec.head.count;
+            return 0;
+        }
+        iter->temp += delta;
+    }
+
+    iter->index++;
+    *temp = iter->temp;
+    return 1;
+}
+
+void rec_dump()
+{
+    rec_iter_t iter = { 0, 0, 0 };
+    char line[42]; // the longest is the first
+    uint32_t t = 0;
+    int temp;
+
+    char *p = fmt_uint(fmt_str(line, "# mode "), rec.head.mode, 0, ' ');
+    p = fmt_uint(fmt_str(p, ", "), rec.head.count, 0, ' ');
+    p = fmt_uint(fmt_str(p, " samples, "), rec.head.len, 0, ' ');
+    fmt_str(p, " bytes\r\n");
+    uart_puts(line);
+    while (rec_next(&iter, &temp)) {
+        p = fmt_uint(line, t, 0, ' ');
+        *p++ = '\t';
+        fmt_str(TEMP4_TO_STR(p, temp), "\r\n");
+        uart_puts(line);
+        t += rec.head.interval;
+    }
+}
@@ -0,0 +1,110 @@
+/**
+ * @file rec.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Record the oven temperature of a run
+ *
+ * The temperature of the hot junction is recorded once per second while
+ * the oven is running. Each sample is stored as the difference to the
+ * previous one, zigzag encoded (0, -1, 1, -2, ... become 0, 1, 2, 3, ...)
+ * in a variable number of bytes (7 bits per byte, the most significant bit
+ * set in all but the last byte), which takes a single byte as long as the
+ * temperature changes by less than 16 degC between two samples.
+ *
+ * If the buffer is full, every other sample is dropped and the interval
+ * is doubled, so that a run of any length fits, at a lower resolution.
+ *
+ * At the end of a run the record is stored in the EEPROM, from where it can
+ * be loaded and written to the serial line later.
+ */
+
+#ifndef REC_H
+#define REC_H
+
+#include <stdint.h>
+
+// size of the sample buffer (bytes; the record must fit in the EEPROM, see
+// nvm.h). It is the largest variable of the firmware, about a quarter of the
+// RAM, and holds a reflow of up to about 15 min at full resolution. It is
+// kept in RAM because dropping samples rewrites the whole record, which in
+// the EEPROM would block the controller for seconds (a few ms per byte).
+// "make bench" reports it next to the RAM left beyond the high-water mark of
+// the stack and fails if less than BENCH_RAM_MARGIN bytes are left, "make
+// check" if the variables exceed RAM_VARS_MAX; this buffer is the one to
+// shrink then (each halving halves the time kept at 1 s).
+#ifndef REC_SIZE
+#define REC_SIZE    960
+#endif
+
+/**
+ * @brief Header of a record.
+ */
+typedef struct {
+    uint8_t mode;       // oven mode of the run (see oven.h)
+    uint8_t interval;   // time between two samples (s)
+    uint16_t count;     // number of samples
+    uint16_t len;       // number of bytes used in the buffer
+    int16_t first;      // first sample (hot junction temperature times 4)
+} rec_head_t;
+
+/**
+ * @brief Position of the decoder within a record (see rec_next()).
+ */
+typedef struct {
+    uint16_t index, pos;
+    int temp;
+} rec_iter_t;
+
+/**
+ * @brief Start recording a run in oven mode @p mode .
+ *
+ * This discards the record in RAM (but not the one in the EEPROM).
+ */
+void rec_start(uint8_t mode);
+
+/**
+ * @brief Record the temperature @p temp (times 4).
+ *
+ * This function must be called once per second while the run lasts.
+ */
+void rec_sample(int temp);
+
+/**
+ * @brief Stop recording and store the record in the EEPROM.
+ *
+ * Writing the EEPROM takes up to 10 s, during which the CPU is blocked;
+ * hence it must only be called once the heater has been switched off.
+ */
+void rec_stop();
+
+/**
+ * @brief Load the record from the EEPROM.
+ *
+ * The function returns 1 if a valid record has been stored and 0 otherwise
+ * (the record in RAM is lost in either case).
+ */
+uint8_t rec_load();
+
+/**
+ * @brief Get the header of the record in RAM.
+ */
+const rec_head_t *rec_head();
+
+/**
+ * @brief Decode the next sample of the record in RAM into @p temp .
+ *
+ * @p iter must be set to zero before the first call. The function returns
+ * 0 if there are no more samples (or the record is damaged) and 1 otherwise.
+ */
+uint8_t rec_next(rec_iter_t *iter, int *temp);
+
+/**
+ * @brief Write the record in RAM to the serial line.
+ *
+ * A line with the time (s) and the temperature (degC) is written for each
+ * sample, following a comment line with the oven mode and the size.
+ */
+void rec_dump();
+
+#endif // REC_H
@@ -8,206 +8,409 @@
 #include "reflow.h"
 
 #include "pid.h"
+#include "tune.h"
+#include "ana.h"
+#include "coast.h"
+#include "est.h"
+#include "profile.h"
+#include "traj.h"
+#include "out.h"
+
+#include <stddef.h>
 
 #ifdef USE_LCD_DISP
 #include "lcd.h"
+#include "fmt.h"
 #else
 #include "uart.h"
 #endif
 
-static int phase, t;
+static uint8_t prof, seg; // active profile and segment
+static int t, t_seg;      // time since start and start of the segment (s)
+static uint16_t t_ms;     // fraction of a second of t (ms)
+
+// last input and output values (for reflow_show()):
+static int temp_last, level; // level: heater power (%)
 
-void reflow_start()
+#if REFLOW_TRAJ
+static uint32_t t_traj;  // trajectory time (ms)
+static uint8_t tracking; // whether the controller is running
+#else
+static int sp_start; // temperature at the start of a PID segment
+#endif
+static int sp_last;  // set point of the last update (0 if not controlled)
+static uint8_t entered; // whether the first segment has been entered
+#ifndef USE_LCD_DISP
+static uint8_t result_shown; // whether the process metrics have been written
+#endif
+static pid_state_t pid_state;
+
+void reflow_start(uint8_t profile)
 {
-    phase = 0;
-    t = 0;
+    prof = profile_valid(profile) ? profile : PROFILE_LEADED;
+    seg = 0;
+    t = t_seg = 0;
+    t_ms = 0;
+    sp_last = 0;
+    entered = 0;
+#if REFLOW_TRAJ
+    t_traj = 0;
+    tracking = 0;
+    traj_build(prof);
+#endif
+#ifndef USE_LCD_DISP
+    result_shown = 0;
+#endif
+    ana_start(prof);
+    coast_init();
 }
 
 #define TIMEOUT         (12 * 60)
+#define LAG             (5 * 4) // lag behind the set point that stops the trajectory time
 
-#define OUT_100_PERCENT (15 * 1024)
-
-// Temperature constants (multiplied by 4):
-#define TEMP_SOAK_MIN   (100 * 4)
-#define TEMP_SOAK_SET   (120 * 4)
-#define TEMP_SOAK_MAX   (150 * 4)
-#define TEMP_LIQUIDUS   (183 * 4)
-#define TEMP_PEAK       (235 * 4)
-#define TEMP_OFF        (TEMP_PEAK - 10)
+/**
+ * @brief Check whether the exit condition of segment @p s is met.
+ */
+static uint8_t seg_done(const profile_seg_t *s, int temp, uint16_t dt)
+{
+    switch (s->exit) {
+        case SEG_EXIT_ABOVE:
+            return temp >= s->temp;
+        case SEG_EXIT_BELOW:
+            return temp < s->temp;
+        case SEG_EXIT_TIME:
+            return t >= t_seg + (int)s->time;
+        case SEG_EXIT_ABOVE_OR_TIME:
+            return temp >= s->temp || t >= t_seg + (int)s->time;
+        case SEG_EXIT_PREDICT:
+            return coast_predict(temp, est_rate(), dt) >= s->temp;
+    }
+    return 0;
+}
 
-int reflow_update(int temp)
+/**
+ * @brief Prepare the control of segment @p s , entered at temperature
+ * @p temp .
+ */
+static void seg_enter(const profile_seg_t *s, int temp)
 {
-    // recorded time-stamps:
-    static int t_soak, // start of soak phase (time when min soak temp reached)
-               t_ramp, // start of ramp (time when max soak temp exceeded)
-               t_liqu, // start of liquidus phase (time when liquidus temp exceeded)
-               t_off,  // time when the heater is turned off previous to peak
-               t_peak, // start of peak phase (time when peak temp exceeded)
-               t_chill, // end of peak phase (time when falling below peak temp)
-               t_cool; // end of critical phase (time when falling below liquidus temp)
+#if REFLOW_TRAJ
+    if (s->out == SEG_OUT_OFF) {
+        tracking = 0;
+        return;
+    }
 
-    static pid_state_t pid_state;
+    // continue from the planned start of the segment or, if the oven is
+    // ahead of the plan, from where the set point reaches its temperature
+    if (t_traj < traj_seg_start(seg))
+        t_traj = traj_seg_start(seg);
+    t_traj = traj_seek(seg, t_traj, temp);
 
-#ifdef USE_LCD_DISP
-    int lcd_blink = ((t & 1)) ? LCD_BACKLIGHT_MAX : 0;
-    lcd_clear();
-    lcd_printf("REFLOW MODE  %4d'", t++);
-    lcd_printf("Temp: %3d.%02d degC", temp >> 2, (temp & 3) * 25);
+    if (!tracking) {
+        pid_state = tune_pid();
+        tracking = 1;
+    }
 #else
-    fprintf(&uartout, "%4d\t%3d.%02d\t", t++, temp >> 2, (temp & 3) * 25);
+    if (s->out == SEG_OUT_PID) {
+        pid_state = tune_pid();
+        sp_start = temp;
+    }
 #endif
+}
 
-    // turn heater off upon timeout
-    if (t >= TIMEOUT) {
-#ifdef USE_LCD_DISP
-        lcd_printf("TIMEOUT!");
-        lcd_backlight(lcd_blink, 0, 0);
+/**
+ * @brief Calculate the heater output for segment @p s .
+ */
+static int seg_output(const profile_seg_t *s, int temp, uint16_t dt)
+{
+    if (s->out == SEG_OUT_OFF)
+        return 0;
+
+#if REFLOW_TRAJ
+    int sp = traj_setpoint(t_traj);
+
+    // the trajectory time stands still while the oven lags behind, and at
+    // the end of a segment left after its time
+    if (temp >= sp - LAG) {
+        t_traj += dt;
+        if (s->exit == SEG_EXIT_TIME || s->exit == SEG_EXIT_ABOVE_OR_TIME) {
+            uint32_t end = traj_seg_start(seg + 1);
+            if (t_traj > end)
+                t_traj = end;
+        }
+    }
 #else
-        fprintf(&uartout, " TIMEOUT\n");
+    if (s->out == SEG_OUT_FULL)
+        return OUT_MAX;
+
+    // set point, approaching the segment temperature with the given rate
+    int sp = s->temp;
+    if (s->rate != 0) {
+        int32_t ramp = sp_start + ((int32_t)s->rate * (t - t_seg) * 2) / 5;
+        if (ramp < sp)
+            sp = ramp;
+    }
 #endif
+
+    sp_last = sp;
+    int out = pid_update(&pid_state, sp, temp, OUT_FF, dt);
+
+    level = (out * 100L + OUT_MAX / 2) / OUT_MAX;
+    return out;
+}
+
+int reflow_update(int temp, uint16_t dt)
+{
+    uint8_t num_segs = profile_num_segs(prof);
+    profile_seg_t s;
+
+    temp_last = temp;
+    sp_last = 0;
+    t_ms += dt;
+    while (t_ms >= 1000) {
+        t_ms -= 1000;
+        t++;
+    }
+
+    // turn heater off upon timeout
+    if (t >= TIMEOUT)
         return 0;
+
+    profile_seg(prof, seg, &s);
+    if (!entered) {
+        seg_enter(&s, temp);
+        entered = 1;
     }
+    ana_update(temp, dt, s.flags & SEG_F_SOAK);
+    coast_update(temp);
+
+    while (seg_done(&s, temp, dt) && seg + 1 < num_segs) {
+        if (s.exit == SEG_EXIT_PREDICT)
+            coast_cut(temp, est_rate());
+        profile_seg(prof, ++seg, &s);
+        t_seg = t;
+        seg_enter(&s, temp);
+    }
+
+    return seg_output(&s, temp, dt);
+}
+
+int reflow_phase()
+{
+    return seg;
+}
+
+const pid_state_t *reflow_pid(int *sp)
+{
+    if (sp_last == 0)
+        return NULL;
+    *sp = sp_last;
+    return &pid_state;
+}
 
-    switch (phase) {
-        case 0:
-            if (temp < TEMP_SOAK_MIN) {
 #ifdef USE_LCD_DISP
-                lcd_printf("PREHEAT");
-                lcd_backlight(LCD_BACKLIGHT_MAX, 0, LCD_BACKLIGHT_MAX);
-#else
-                fprintf(&uartout, " PREHEAT\n");
-#endif
-                return OUT_100_PERCENT;
-            }
-            phase = 1;
-            t_soak = t;
-            pid_state = pid_init(160, 1, 0);
+/**
+ * @brief Mark a value of the process metrics that violates a limit.
+ */
+#define MARK(fails, f) (((fails) & (f)) ? '!' : ' ')
+
+/**
+ * @brief Show the verdict and page @p page (0 to 2) of the process metrics.
+ */
+static void show_result(uint8_t page)
+{
+    char line[LCD_COLS + 1], *p;
+    ana_result_t res;
+    uint8_t fails = ana_result(&res);
+
+    lcd_write(fails ? "COOL DOWN  FAIL" : "COOL DOWN  PASS");
+    switch (page) {
+        case 0:
+            p = fmt_str(line, "TAL");
+            p = fmt_int(p, res.tal, 4, ' ');
+            *p++ = '\'';
+            *p++ = MARK(fails, ANA_F_TAL);
+            p = fmt_str(p, "Pk");
+            p = fmt_temp4(p, res.peak, 4);
+            *p++ = MARK(fails, ANA_F_PEAK);
+            *p = 0;
+            break;
 
         case 1:
-            if (t < t_soak + 120) {
-                int out = pid_update(&pid_state, TEMP_SOAK_SET - temp);
+            p = fmt_str(line, "Ramp +");
+            p = fmt_tenths(p, res.ramp_up, 0);
+            *p++ = MARK(fails, ANA_F_RAMP_UP);
+            p = fmt_str(p, "-");
+            p = fmt_tenths(p, res.ramp_down, 0);
+            *p++ = MARK(fails, ANA_F_RAMP_DOWN);
+            fmt_str(p, "/s");
+            break;
+
+        default:
+            p = fmt_str(line, "Soak");
+            p = fmt_int(p, res.soak, 4, ' ');
+            *p++ = '\'';
+            *p++ = MARK(fails, ANA_F_SOAK);
+            p = fmt_str(p, "Pk5");
+            p = fmt_int(p, res.near_peak, 3, ' ');
+            *p++ = '\'';
+            *p++ = MARK(fails, ANA_F_NEAR_PEAK);
+            *p = 0;
+            break;
+    }
+    lcd_write(line);
+}
+#else
+/**
+ * @brief Mark a value of the process metrics that violates a limit.
+ */
+#define MARK(fails, f) (((fails) & (f)) ? "!" : "")
 
-                // limit out to [0,8191]
-                out += 4096;
-                if (out < 0)
-                    out = 0;
-                if (out > 8191)
-                    out = 8191;
+/**
+ * @brief Write the verdict and the process metrics.
+ */
+static void show_result()
+{
+    ana_result_t res;
+    uint8_t fails = ana_result(&res);
 
-                // reduce out to 16 values
-                out >>= 9;
+    fprintf(uart_file, "%s: ramp +%d.%d%s/-%d.%d%s degC/s, soak %u s%s, TAL %u s%s, "
+            "peak %d.%02d degC%s, %u s%s within 5 degC of the peak\n",
+            fails ? "FAIL" : "PASS",
+            res.ramp_up / 10, res.ramp_up % 10, MARK(fails, ANA_F_RAMP_UP),
+            res.ramp_down / 10, res.ramp_down % 10, MARK(fails, ANA_F_RAMP_DOWN),
+            res.soak, MARK(fails, ANA_F_SOAK), res.tal, MARK(fails, ANA_F_TAL),
+            res.peak >> 2, (res.peak & 3) * 25, MARK(fails, ANA_F_PEAK),
+            res.near_peak, MARK(fails, ANA_F_NEAR_PEAK));
+}
+#endif
 
+void reflow_show()
+{
 #ifdef USE_LCD_DISP
-                lcd_printf("SOAK PHASE, D: %4d", pid_state.last_diff);
-                lcd_printf("I: %4d => O: %2d", pid_state.integ, out);
-                lcd_backlight(LCD_BACKLIGHT_MAX, 0, LCD_BACKLIGHT_MAX);
+    int lcd_blink = ((t & 1)) ? LCD_BACKLIGHT_MAX : 0;
+    char line[LCD_COLS + 1], *p;
+
+    lcd_clear();
+    p = fmt_str(line, "REFLOW MODE  ");
+    p = fmt_int(p, t, 4, ' ');
+    fmt_str(p, "'");
+    lcd_write(line);
+    p = fmt_str(line, "Temp: ");
+    p = fmt_temp4(p, temp_last, 3);
+    fmt_str(p, " degC");
+    lcd_write(line);
 #else
-                fprintf(&uartout, "diff: %d, integ: %d => %d\n", pid_state.last_diff, pid_state.integ, out);
+    fprintf(uart_file, "%4d\t%3d.%02d\t", t, temp_last >> 2, (temp_last & 3) * 25);
 #endif
-                return out * 1024;
-            }
-            phase = 2;
 
-        case 2:
-            if (temp < TEMP_SOAK_MAX) {
+    if (t >= TIMEOUT) {
 #ifdef USE_LCD_DISP
-                lcd_printf("RAMPING UP");
-                lcd_backlight(LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX / 2, 0);
+        lcd_write("TIMEOUT!");
+        lcd_backlight(lcd_blink, 0, 0);
 #else
-                fprintf(&uartout, " RAMPING UP\n");
+        fprintf(uart_file, " TIMEOUT\n");
 #endif
-                return OUT_100_PERCENT;
-            }
-            phase = 3;
-            t_ramp = t;
+        return;
+    }
 
+    profile_seg_t s;
+    profile_seg(prof, seg, &s);
+    switch (s.kind) {
+        case SEG_PREHEAT:
 #ifdef USE_LCD_DISP
+            lcd_write("PREHEAT");
+            lcd_backlight(LCD_BACKLIGHT_MAX, 0, LCD_BACKLIGHT_MAX);
 #else
-            fprintf(&uartout, " total soak time: %d s;", t_ramp - t_soak);
+            fprintf(uart_file, " PREHEAT\n");
 #endif
+            break;
 
-        case 3:
-            if (temp < TEMP_LIQUIDUS) {
+        case SEG_SOAK:
 #ifdef USE_LCD_DISP
-                lcd_printf("RAMPING UP");
-                lcd_printf("LIQUIDUS TEMP");
-                lcd_backlight(LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX / 2, 0);
+            p = fmt_str(line, "SOAK PHASE, D: ");
+            fmt_int(p, pid_state.last_diff, 4, ' ');
+            lcd_write(line);
+            p = fmt_str(line, "I: ");
+            p = fmt_int(p, pid_state.integ, 4, ' ');
+            p = fmt_str(p, " => O: ");
+            p = fmt_int(p, level, 3, ' ');
+            fmt_str(p, "%");
+            lcd_write(line);
+            lcd_backlight(LCD_BACKLIGHT_MAX, 0, LCD_BACKLIGHT_MAX);
 #else
-                fprintf(&uartout, " RAMPING UP\n");
+            fprintf(uart_file, "diff: %d, integ: %d => %d%%\n", pid_state.last_diff, pid_state.integ, level);
 #endif
-                return OUT_100_PERCENT;
-            }
-            phase = 4;
-            t_liqu = t;
+            break;
 
-        case 4:
-            if (temp < TEMP_OFF) {
+        case SEG_RAMP:
 #ifdef USE_LCD_DISP
-                lcd_printf("LIQUIDUS PHASE");
-                lcd_backlight(LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX / 2, 0);
+            lcd_write("RAMPING UP");
+            lcd_backlight(LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX / 2, 0);
 #else
-                fprintf(&uartout, " LIQUIDUS PHASE\n");
+            fprintf(uart_file, " RAMPING UP\n");
 #endif
-                return OUT_100_PERCENT;
-            }
-            phase = 5;
-            t_off = t;
+            break;
 
-        case 5:
-            if (temp < TEMP_PEAK && t < t_off + 5) {
+        case SEG_RAMP_LIQUIDUS:
 #ifdef USE_LCD_DISP
-                lcd_printf("LIQUIDUS PHASE");
-                lcd_printf("HEATER OFF");
-                lcd_backlight(lcd_blink, lcd_blink, lcd_blink);
+            lcd_write("RAMPING UP");
+            lcd_write("LIQUIDUS TEMP");
+            lcd_backlight(LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX / 2, 0);
 #else
-                fprintf(&uartout, " LIQUIDUS PHASE, HEATER OFF\n");
+            fprintf(uart_file, " RAMPING UP\n");
 #endif
-                return 0;
-            }
-            phase = 6;
-            t_peak = t;
+            break;
 
-        case 6:
-            if (temp >= TEMP_PEAK) {
+        case SEG_LIQUIDUS:
 #ifdef USE_LCD_DISP
-                lcd_printf("PEAK");
-                lcd_printf("HEATER OFF");
-                lcd_backlight(lcd_blink, lcd_blink, lcd_blink);
+            lcd_write("LIQUIDUS PHASE");
+            lcd_backlight(LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX / 2, 0);
 #else
-                fprintf(&uartout, " PEAK\n");
+            fprintf(uart_file, " LIQUIDUS PHASE\n");
 #endif
-                return 0;
-            }
-            phase = 7;
-            t_chill = t;
+            break;
 
-        case 7:
-            if (temp >= TEMP_LIQUIDUS) {
+        case SEG_COAST:
 #ifdef USE_LCD_DISP
-                lcd_printf("CHILLING");
-                lcd_backlight(0, LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX);
+            lcd_write("LIQUIDUS PHASE");
+            lcd_write("HEATER OFF");
+            lcd_backlight(lcd_blink, lcd_blink, lcd_blink);
 #else
-                fprintf(&uartout, " CHILLING\n");
+            fprintf(uart_file, " LIQUIDUS PHASE, HEATER OFF\n");
 #endif
-                return 0;
-            }
-            phase = 8;
-            t_chill = t;
+            break;
 
+        case SEG_PEAK:
 #ifdef USE_LCD_DISP
+            lcd_write("PEAK");
+            lcd_write("HEATER OFF");
+            lcd_backlight(lcd_blink, lcd_blink, lcd_blink);
 #else
-            fprintf(&uartout, " total liquidus time: %d s;", t_chill - t_liqu);
+            fprintf(uart_file, " PEAK\n");
 #endif
+            break;
 
-        case 8:
+        case SEG_CHILL:
 #ifdef USE_LCD_DISP
-            lcd_printf("COOL DOWN");
-            lcd_printf("Liquidus time: %3d'", t_chill - t_liqu);
+            lcd_write("CHILLING");
+            lcd_backlight(0, LCD_BACKLIGHT_MAX, LCD_BACKLIGHT_MAX);
+#else
+            fprintf(uart_file, " CHILLING\n");
+#endif
+            break;
+
+        case SEG_COOL:
+#ifdef USE_LCD_DISP
+            show_result(t / 2 % 3);
             lcd_backlight(0, 0, LCD_BACKLIGHT_MAX);
 #else
-            fprintf(&uartout, " COOL DOWN\n");
+            fprintf(uart_file, " COOL DOWN\n");
+            if (!result_shown) {
+                show_result();
+                result_shown = 1;
+            }
 #endif
-            return 0;
+            break;
     }
-    return 0;
 }
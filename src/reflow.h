@@ -9,27 +9,66 @@
 #ifndef REFLOW_H
 #define REFLOW_H
 
+#include <stdint.h>
+
+#include "pid.h"
+
+/**
+ * @brief Regulate the heater along the set point trajectory of the profile
+ * (see traj.h) in all segments that drive it (non-zero), or switch it fully
+ * on in the segments with @c SEG_OUT_FULL and regulate only in the ones
+ * with @c SEG_OUT_PID (zero).
+ */
+#ifndef REFLOW_TRAJ
+#define REFLOW_TRAJ 1
+#endif
+
 /**
  * @brief Start reflowing.
  *
  * This function initializes the reflow process manager. It is used to reset
  * the reflow process manager and must be called each time a reflow process
- * is started.
+ * is started. @p profile selects the reflow profile (see profile.h).
  */
-void reflow_start();
+void reflow_start(uint8_t profile);
 
 /**
  * @brief Update the reflow process state.
  *
- * This function must be called every second while the reflow process is
+ * This function must be called periodically while the reflow process is
  * running. @p temp is the temperature within the oven (i.e. the
- * temperature of the hot junction of the thermocouple).
+ * temperature of the hot junction of the thermocouple) and @p dt is the
+ * time since the last call (or the start) in ms.
  *
- * The function returns the output value for driving the heater elements.
+ * The function returns the heater power (0 to @c OUT_MAX , see out.h).
  *
  * The reflow process has ended if the output value is 0 and the
  * temperature has dropped below 50 degC.
  */
-int reflow_update(int temp);
+int reflow_update(int temp, uint16_t dt);
+
+/**
+ * @brief Get the current phase of the reflow process.
+ *
+ * This is the index of the active segment of the reflow profile.
+ */
+int reflow_phase();
+
+/**
+ * @brief Get the controller of the active phase.
+ *
+ * The function returns NULL if the heater is not controlled in the active
+ * phase (i.e. it is fully on or off); otherwise, the set point of the last
+ * update is written to @p sp .
+ */
+const pid_state_t *reflow_pid(int *sp);
+
+/**
+ * @brief Show the reflow process state.
+ *
+ * This function writes the state after the last call to @c reflow_update()
+ * to the display (or the serial output if no display is used).
+ */
+void reflow_show();
 
 #endif // REFLOW_H
@@ -0,0 +1,123 @@
+/**
+ * @file sched.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Cooperative task scheduler for the main loop
+ */
+#include "sched.h"
+
+#include "hal.h"
+
+#ifdef BENCH
+#include "bench.h"
+#endif
+
+#if SCHED_MAX_TASKS > 8
+#error "SCHED_MAX_TASKS must not exceed 8"
+#endif
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static uint8_t periods[SCHED_MAX_TASKS],
+               counts[SCHED_MAX_TASKS];
+static uint8_t num_tasks;
+
+static volatile uint8_t pending, // one bit per task that is due
+                        events;  // posted event bits
+static volatile uint16_t now;    // ticks since the start
+
+int sched_add(sched_task_t task, uint8_t period)
+{
+    if (num_tasks >= SCHED_MAX_TASKS || period == 0)
+        return -1;
+
+    HAL_ATOMIC {
+        tasks[num_tasks] = task;
+        periods[num_tasks] = period;
+        counts[num_tasks] = 0;
+        num_tasks++;
+    }
+    return 0;
+}
+
+void sched_tick()
+{
+    uint8_t i, bit = 1;
+    now++;
+    for (i = 0; i < num_tasks; i++, bit <<= 1) {
+        if (++counts[i] >= periods[i]) {
+            counts[i] = 0;
+            pending |= bit;
+        }
+    }
+}
+
+uint16_t sched_now()
+{
+    uint16_t t;
+    HAL_ATOMIC {
+        t = now;
+    }
+    return t;
+}
+
+void sched_restart()
+{
+    HAL_ATOMIC {
+        uint8_t i;
+        for (i = 0; i < num_tasks; i++)
+            counts[i] = 0;
+        pending = 0;
+    }
+}
+
+void sched_post(uint8_t ev)
+{
+    HAL_ATOMIC {
+        events |= ev;
+    }
+}
+
+uint8_t sched_events()
+{
+    uint8_t ev;
+    HAL_ATOMIC {
+        ev = events;
+        events = 0;
+    }
+    return ev;
+}
+
+void sched_sleep()
+{
+    hal_irq_disable();
+    if (pending == 0 && events == 0)
+        hal_sleep();
+    else
+        hal_irq_enable();
+}
+
+uint8_t sched_run()
+{
+    uint8_t due, i, bit = 1, n = 0;
+
+    HAL_ATOMIC {
+        due = pending;
+        pending = 0;
+    }
+
+    for (i = 0; i < num_tasks && due != 0; i++, bit <<= 1) {
+        if (due & bit) {
+            due &= ~bit;
+#ifdef BENCH
+            uint32_t t0 = bench_now();
+            tasks[i]();
+            bench_add(BENCH_TASK(i), bench_now() - t0);
+#else
+            tasks[i]();
+#endif
+            n++;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file sched.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Cooperative task scheduler for the main loop
+ *
+ * Interrupt routines only call @c sched_tick() or @c sched_post() , which
+ * mark work as pending. The actual work is done by @c sched_run() in the
+ * main loop, so interrupt latency stays short and bounded.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+/**
+ * @brief Maximum number of periodic tasks.
+ */
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 8
+#endif
+
+typedef void (*sched_task_t)();
+
+/**
+ * @brief Register a periodic task.
+ *
+ * The function @p task is run every @p period ticks. Tasks that are due in
+ * the same tick are run in the order in which they have been registered.
+ *
+ * The function returns 0 on success and -1 if there is no room left.
+ */
+int sched_add(sched_task_t task, uint8_t period);
+
+/**
+ * @brief Advance the scheduler by one tick.
+ *
+ * This function must be called from the timer interrupt routine.
+ */
+void sched_tick();
+
+/**
+ * @brief Get the number of ticks since the start (wraps around).
+ */
+uint16_t sched_now();
+
+/**
+ * @brief Restart the period of all tasks.
+ *
+ * After this call each task runs next when its full period has elapsed.
+ */
+void sched_restart();
+
+/**
+ * @brief Post events.
+ *
+ * This function sets the event bits @p events . It may be called from
+ * interrupt routines. The meaning of the bits is up to the application.
+ */
+void sched_post(uint8_t events);
+
+/**
+ * @brief Fetch and clear all posted events.
+ */
+uint8_t sched_events();
+
+/**
+ * @brief Sleep until the next interrupt, unless work is pending.
+ *
+ * This function should be called from the main loop after
+ * @c sched_run() . It returns at once if a task is due or an event has
+ * been posted; otherwise the CPU sleeps until an interrupt wakes it up
+ * (see @c hal_sleep() ).
+ */
+void sched_sleep();
+
+/**
+ * @brief Run all due tasks.
+ *
+ * This function must be called repeatedly from the main loop. If a task
+ * has become due more than once since it last ran (because the main loop
+ * was busy) it is run only once.
+ *
+ * The function returns the number of tasks that have been run.
+ */
+uint8_t sched_run();
+
+#endif // SCHED_H
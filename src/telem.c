@@ -0,0 +1,137 @@
+/**
+ * @file telem.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Binary telemetry records
+ */
+#include "telem.h"
+
+/**
+ * @brief Update the CRC-16 @p crc with the byte @p data .
+ */
+static uint16_t crc16(uint16_t crc, uint8_t data)
+{
+    uint8_t i;
+    crc ^= data;
+    for (i = 0; i < 8; i++)
+        crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+    return crc;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t val)
+{
+    *p++ = val & 0xff;
+    *p++ = val >> 8;
+    return p;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | ((uint16_t)p[1] << 8);
+}
+
+uint8_t telem_encode(const telem_rec_t *rec, uint8_t *frame)
+{
+    uint8_t buf[TELEM_REC_SIZE], *p = buf;
+    uint16_t crc = 0xffff;
+    uint8_t i, len, code;
+
+    *p++ = TELEM_VERSION;
+    p = put16(p, rec->time & 0xffff);
+    p = put16(p, rec->time >> 16);
+    p = put16(p, rec->hot);
+    p = put16(p, rec->rate);
+    p = put16(p, rec->cold);
+    p = put16(p, rec->setpoint);
+    p = put16(p, rec->p);
+    p = put16(p, rec->i);
+    p = put16(p, rec->d);
+    p = put16(p, rec->out);
+    *p++ = rec->mode;
+    *p++ = rec->phase;
+    *p++ = rec->flags;
+    *p++ = rec->ramp_up;
+    *p++ = rec->ramp_down;
+    p = put16(p, rec->peak);
+    p = put16(p, rec->tal);
+    p = put16(p, rec->near_peak);
+    p = put16(p, rec->soak);
+    *p++ = rec->verdict;
+    p = put16(p, rec->stack);
+    p = put16(p, rec->ram_free);
+    for (i = 0; i < TELEM_REC_SIZE - 2; i++)
+        crc = crc16(crc, buf[i]);
+    put16(p, crc);
+
+    // COBS: each 0 byte is replaced by the distance to the next one, the
+    // first byte holds the distance to the first one
+    code = 0;
+    len = 1;
+    for (i = 0; i < TELEM_REC_SIZE; i++) {
+        if (buf[i] == 0) {
+            frame[code] = len - code;
+            code = len++;
+        } else
+            frame[len++] = buf[i];
+    }
+    frame[code] = len - code;
+    frame[len++] = 0;
+    return len;
+}
+
+int telem_decode(const uint8_t *frame, uint8_t len, telem_rec_t *rec)
+{
+    uint8_t buf[TELEM_REC_SIZE], n = 0;
+    uint16_t crc = 0xffff;
+    uint8_t i, code;
+
+    // undo COBS (records are shorter than 254 bytes, so each code byte is
+    // followed by a 0 byte, except for the last one)
+    i = 0;
+    while (i < len) {
+        code = frame[i++];
+        if (code == 0 || i + code - 1 > len)
+            return -1;
+        while (--code) {
+            if (n >= TELEM_REC_SIZE)
+                return -1;
+            buf[n++] = frame[i++];
+        }
+        if (i < len) {
+            if (n >= TELEM_REC_SIZE)
+                return -1;
+            buf[n++] = 0;
+        }
+    }
+
+    if (n != TELEM_REC_SIZE)
+        return -1;
+    for (i = 0; i < TELEM_REC_SIZE - 2; i++)
+        crc = crc16(crc, buf[i]);
+    if (get16(buf + TELEM_REC_SIZE - 2) != crc || buf[0] != TELEM_VERSION)
+        return -1;
+
+    rec->time = get16(buf + 1) | ((uint32_t)get16(buf + 3) << 16);
+    rec->hot = get16(buf + 5);
+    rec->rate = get16(buf + 7);
+    rec->cold = get16(buf + 9);
+    rec->setpoint = get16(buf + 11);
+    rec->p = get16(buf + 13);
+    rec->i = get16(buf + 15);
+    rec->d = get16(buf + 17);
+    rec->out = get16(buf + 19);
+    rec->mode = buf[21];
+    rec->phase = buf[22];
+    rec->flags = buf[23];
+    rec->ramp_up = buf[24];
+    rec->ramp_down = buf[25];
+    rec->peak = get16(buf + 26);
+    rec->tal = get16(buf + 28);
+    rec->near_peak = get16(buf + 30);
+    rec->soak = get16(buf + 32);
+    rec->verdict = buf[34];
+    rec->stack = get16(buf + 35);
+    rec->ram_free = get16(buf + 37);
+    return 0;
+}
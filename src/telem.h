@@ -0,0 +1,90 @@
+/**
+ * @file telem.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Binary telemetry records
+ *
+ * Instead of the text output, the firmware can send one binary record per
+ * heater update over the serial line (compile with USE_TELEMETRY and
+ * without USE_LCD_DISP). Each record is encoded as:
+ *
+ *     version (1 byte, TELEM_VERSION)
+ *     time (uint32_t, ms since the start of the process)
+ *     hot junction temperature (int16_t, degC * 4, filtered, see est.h)
+ *     its rate of change (int16_t, 0.01 degC/s)
+ *     cold junction temperature (int16_t, degC * 16)
+ *     set point (int16_t, degC * 4; 0 if the heater is not controlled)
+ *     P, I and D term of the controller (3 x int16_t)
+ *     heater power (uint16_t, 0 to OUT_MAX)
+ *     mode (uint8_t, OVEN_MODE_*), phase (uint8_t), flags (uint8_t, TELEM_F_*)
+ *     process metrics of a reflow (see ana.h; 0 in the other modes):
+ *         max. ramp-up and ramp-down rate (2 x uint8_t, 0.1 degC/s),
+ *         peak temperature (int16_t, degC * 4), time above liquidus,
+ *         time within 5 degC of the peak and soak time (3 x uint16_t, s),
+ *         violated limits (uint8_t, ANA_F_*; final in the cool down phase)
+ *     high-water mark of the stack and RAM never used (2 x uint16_t, bytes,
+ *     see hal_ram_usage())
+ *     CRC-16 of all preceding bytes (uint16_t, CCITT polynomial, reflected,
+ *     initial value 0xffff)
+ *
+ * with all multi-byte values in little-endian order. The record is framed
+ * with consistent overhead byte stuffing (COBS) and terminated by a 0 byte,
+ * which does not occur anywhere else in the stream. A receiver can start
+ * listening at any time and resynchronizes at the next 0 byte.
+ *
+ * The encoder and decoder are shared by the firmware and the host tools.
+ */
+
+#ifndef TELEM_H
+#define TELEM_H
+
+#include <stdint.h>
+
+#define TELEM_VERSION   4
+
+#define TELEM_F_FAULT    1 // no recent thermocouple reading, heater off
+#define TELEM_F_OVERHEAT 2 // the controller is overheated, heater off
+#define TELEM_F_CAUSE_SHIFT 2 // position of the fault causes of the latest
+                              // reading (TEMP_F_* bits, see temp.h)
+#define TELEM_F_RX_LOST  128 // received characters lost since the last record
+
+#define TELEM_REC_SIZE  41 // size of an encoded record including the CRC
+
+/**
+ * @brief Maximum size of a frame (COBS overhead and terminating 0 byte).
+ */
+#define TELEM_FRAME_MAX (TELEM_REC_SIZE + 2)
+
+typedef struct {
+    uint32_t time;
+    int16_t hot, rate, cold;
+    int16_t setpoint;
+    int16_t p, i, d;
+    uint16_t out;
+    uint8_t mode, phase, flags;
+    uint8_t ramp_up, ramp_down;
+    int16_t peak;
+    uint16_t tal, near_peak, soak;
+    uint8_t verdict;
+    uint16_t stack, ram_free;
+} telem_rec_t;
+
+/**
+ * @brief Encode the record @p rec as a frame.
+ *
+ * The frame is written to @p frame (at least @c TELEM_FRAME_MAX bytes),
+ * the function returns its length including the terminating 0 byte.
+ */
+uint8_t telem_encode(const telem_rec_t *rec, uint8_t *frame);
+
+/**
+ * @brief Decode the frame @p frame of @p len bytes into @p rec .
+ *
+ * @p frame is the content between two 0 bytes (without the terminating 0).
+ * The function returns 0 on success and -1 if the frame is malformed, its
+ * CRC does not match or it has been encoded with another version.
+ */
+int telem_decode(const uint8_t *frame, uint8_t len, telem_rec_t *rec);
+
+#endif // TELEM_H
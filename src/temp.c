@@ -8,50 +8,142 @@
 #include "temp.h"
 
 #include <stddef.h>
-#include <avr/io.h>
+
+#include "hal.h"
+#include "sched.h"
+
+#define FRAME_BYTES 4
+#define IDLE        0xff // no transfer in progress
+
+// transfer in progress (written by the main loop only while IDLE):
+static volatile uint8_t pos = IDLE; // bytes received so far
+static uint8_t dev;                 // channel being read
+static uint32_t frame;
+static uint16_t start_time;
+
+// results of each channel (written by the interrupt routine):
+static volatile temp_sample_t last[TEMP_CHANNELS];
+static volatile uint8_t valid, fresh; // any good reading yet, a new one (bit per channel)
+static volatile uint8_t faults[TEMP_CHANNELS], failures[TEMP_CHANNELS];
 
 void temp_init()
 {
-    // set pin C1 high and as output (CS pin)
-    PORTC.OUTSET = 2;
-    PORTC.DIRSET = 2;
+    hal_spi_init();
+}
 
-    // set pin C7 low and as output (SCK pin)
-    PORTC.OUTCLR = 0x80;
-    PORTC.DIRSET = 0x80;
+/**
+ * @brief Count a failed reading of channel @p ch with the causes @p f .
+ */
+static void fail(uint8_t ch, uint8_t f)
+{
+    faults[ch] = f;
+    if (failures[ch] != 0xff)
+        failures[ch]++;
+}
 
-    SPIC.INTCTRL = 0; // disable interrupts
-    SPIC.CTRL = 0x50; // master spi in mode 0, 500 kHz (clk / 4), msb first
+/**
+ * @brief Start reading the frame of the current channel.
+ */
+static void start_frame()
+{
+    frame = 0;
+    pos = 0;
+    hal_spi_select(dev, 1);
+    hal_spi_write(0x5a); // dummy byte, the MAX31855K only sends
 }
 
-int temp_read(int *hj_temp_ptr, int *cj_temp_ptr)
+void temp_start()
 {
-    uint32_t data;
+    // a batch takes microseconds, one that is still in progress has lost an
+    // interrupt: abandon it
+    HAL_ATOMIC {
+        if (pos != IDLE) {
+            hal_spi_select(dev, 0);
+            pos = IDLE;
+            for (; dev < TEMP_CHANNELS; dev++)
+                fail(dev, TEMP_F_BUS);
+        }
+    }
 
-    PORTC.OUTCLR = 2; // CS low
-    int i;
-    for (i = 0; i < 4; i++) {
-        SPIC.DATA = 0x5a; // dummy byte to start transmission
-        while (!(SPIC.STATUS & 0x80)); // wait for completion
-        data = (data << 8) | SPIC.DATA; // read byte
+    start_time = sched_now();
+    dev = 0;
+    start_frame();
+}
+
+/**
+ * @brief Decode a complete frame.
+ *
+ * Frame layout: hot junction temperature (14 bit, bits 31 to 18), reserved
+ * (bit 17), fault (bit 16), cold junction temperature (12 bit, bits 15 to
+ * 4), reserved (bit 3), short to VCC (bit 2), short to GND (bit 1), open
+ * circuit (bit 0).
+ *
+ * A frame of all zeros, as read with MISO stuck low or no chip on the bus,
+ * fails too (0 degC at both junctions is no plausible reading).
+ */
+static void decode()
+{
+    uint8_t f = 0;
+
+    if (frame & 0x20008UL)
+        f = TEMP_F_BUS; // reserved bits are always 0
+    else if (frame & 0x10000UL)
+        f = (frame & 7) ? (frame & 7) : TEMP_F_FAULT;
+    else if ((frame & 0xfffcfff0UL) == 0)
+        f = TEMP_F_BUS; // both temperatures 0
+
+    if (f) {
+        fail(dev, f);
+        return;
     }
-    PORTC.OUTSET = 2; // CS high
 
-    // check error bit (reports a fault condition on the MAX31855):
-    if ((data & (((uint32_t)1)<<16)))
-        return -1;
+    volatile temp_sample_t *s = &last[dev];
+    int16_t hot = frame >> 16;
+    s->hot = hot >> 2; // sign extend
+    int16_t cold = frame;
+    s->cold = cold >> 4;
+    s->time = start_time;
+    valid |= 1 << dev;
+    fresh |= 1 << dev;
+    faults[dev] = 0;
+    failures[dev] = 0;
+}
+
+void hal_on_spi(uint8_t data)
+{
+    frame = (frame << 8) | data;
+    if (++pos < FRAME_BYTES) {
+        hal_spi_write(0x5a);
+        return;
+    }
 
-    int16_t hj_temp = data >> 16;
-    hj_temp >>= 2; // sign extend
+    hal_spi_select(dev, 0);
+    decode();
+    if (++dev < TEMP_CHANNELS)
+        start_frame();
+    else
+        pos = IDLE;
+}
 
-    if (hj_temp_ptr != NULL)
-        *hj_temp_ptr = hj_temp;
+uint8_t temp_read(uint8_t ch, temp_sample_t *sample)
+{
+    uint8_t new, bit = 1 << ch;
 
-    int16_t cj_temp = data;
-    cj_temp >>= 4;
+    HAL_ATOMIC {
+        if (valid & bit)
+            *sample = last[ch];
+        new = (fresh & bit) != 0;
+        fresh &= ~bit;
+    }
+    return new;
+}
 
-    if (cj_temp_ptr != NULL)
-        *cj_temp_ptr = cj_temp;
+uint8_t temp_faults(uint8_t ch)
+{
+    return faults[ch];
+}
 
-    return 0;
+uint8_t temp_failures(uint8_t ch)
+{
+    return failures[ch];
 }
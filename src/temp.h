@@ -4,11 +4,42 @@
  * @date 2018-11-29
  *
  * @brief Interface for the MAX31855K Thermocouple-to-Digital Converter
+ *
+ * The 32 bit frames of the MAX31855K on the SPI bus (@c TEMP_CHANNELS of
+ * them, see @c HAL_SPI_DEVICES ) are read in the background, one byte per
+ * SPI interrupt: @c temp_start() reads all of them in a batch, one after
+ * the other. The last good reading, the fault causes of the latest reading
+ * and the number of failed readings since the last good one are kept for
+ * each channel and can be fetched at any time.
+ *
+ * A batch takes 4 transfers of one byte per channel, about 20 us per
+ * channel at the SPI clock of clock.h.
  */
 
 #ifndef TEMP_H
 #define TEMP_H
 
+#include <stdint.h>
+
+#include "fmt.h"
+#include "hal.h"
+
+// number of thermocouples (one MAX31855K each)
+#define TEMP_CHANNELS HAL_SPI_DEVICES
+
+// Causes of a failed reading (see temp_faults()):
+#define TEMP_F_OC    1 // thermocouple open (no connection)
+#define TEMP_F_SCG   2 // thermocouple short-circuited to GND
+#define TEMP_F_SCV   4 // thermocouple short-circuited to VCC
+#define TEMP_F_FAULT 8 // fault bit set without a cause
+#define TEMP_F_BUS   16 // reserved bits set or all zero (no MAX31855K on the bus)
+
+typedef struct {
+    int16_t hot;   // hot junction temperature (multiplied by 4)
+    int16_t cold;  // cold junction temperature (multiplied by 16)
+    uint16_t time; // tick at which the reading was started (see sched_now())
+} temp_sample_t;
+
 /**
  * @brief Initialize temperature readings.
  *
@@ -17,48 +48,49 @@
 void temp_init();
 
 /**
- * @brief Read the temperature of the thermocouple.
+ * @brief Start reading all MAX31855K.
  *
- * This function reads the temperatures of the hot junction and the cold
- * junction of the thermocouple from the MAX31855K. The temperature of the
- * hot junction is copied into the variable pointed to by @p hj_temp_ptr and
- * the temperature of the cold junction is copied into the variable pointed
- * to by @p cj_temp_ptr .
+ * The frames are transferred in the background. The readings of a previous
+ * batch that have not completed yet are abandoned and count as failed
+ * (TEMP_F_BUS), so this should be called at most every few milliseconds.
+ */
+void temp_start();
+
+/**
+ * @brief Get the last good reading of channel @p ch .
  *
- * Either one of these pointers may be NULL, in which case it is not used.
+ * The reading is copied into the variable pointed to by @p sample . The
+ * function returns 1 if the reading is new since the last call and 0
+ * otherwise (@p sample is left unchanged if there has never been a good
+ * reading).
+ */
+uint8_t temp_read(uint8_t ch, temp_sample_t *sample);
+
+/**
+ * @brief Get the causes of the failure of the latest reading of channel
+ * @p ch .
  *
- * The temperatures are given as fixed point values: the value for the
- * hot junction has 2 bits after the radix point, the value for the cold
- * junction has 4 bits after the radix point. Use the macros below for
- * converting these values into a human readable string.
+ * The function returns TEMP_F_* bits, 0 if the latest reading was good.
+ */
+uint8_t temp_faults(uint8_t ch);
+
+/**
+ * @brief Get the number of failed readings of channel @p ch since its last
+ * good one.
  *
- * The functions returns 0 on success and -1 in case of an error.
+ * The count saturates at 255.
  */
-int temp_read(int *hj_temp_ptr, int *cj_temp_ptr);
+uint8_t temp_failures(uint8_t ch);
 
 
 /**
  * @brief Write a hot junction temperature to a string buffer.
  */
-#define TEMP4_TO_STR(str, temp)  {                                             \
-    if ((temp) >= 0)                                                           \
-        sprintf(str, "%d.%02d", (temp) >> 2, ((temp) & 3) * 25);               \
-    else {                                                                     \
-        int abs_temp = -(temp);                                                \
-        sprintf(str, "-%d.%02d", abs_temp >> 2, (abs_temp & 3) * 25);          \
-    }                                                                          \
-}
+#define TEMP4_TO_STR(str, temp)  fmt_temp4((str), (temp), 0)
 
 /**
  * @brief Write a cold junction temperature to a string buffer.
  */
-#define TEMP16_TO_STR(str, temp) {                                             \
-    if ((temp) >= 0)                                                           \
-        sprintf(str, "%d.%04d", (temp) >> 4, ((temp) & 0xf) * 625);            \
-    else {                                                                     \
-        int abs_temp = -(temp);                                                \
-        sprintf(str, "-%d.%04d", abs_temp >> 4, (abs_temp & 0xf) * 625);       \
-    }                                                                          \
-}
+#define TEMP16_TO_STR(str, temp) fmt_temp16((str), (temp), 0)
 
 #endif // TEMP_H
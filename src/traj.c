@@ -0,0 +1,124 @@
+/**
+ * @file traj.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Set point trajectory of a reflow profile
+ */
+#include "traj.h"
+#include "profile.h"
+
+#define TRAJ_LEN    (TRAJ_TIME / TRAJ_STEP + 1)
+#define STEP_MS     ((uint32_t)TRAJ_STEP * 1000)
+
+static int16_t table[TRAJ_LEN];                 // set point at each step
+static uint16_t seg_start[PROFILE_MAX_SEGS + 1]; // planned start of each segment (steps)
+
+/**
+ * @brief Get the number of steps needed to change the set point by
+ * @p diff (multiplied by 4) at @p rate (0.1 degC/s), rounded up.
+ */
+static uint16_t ramp_steps(int diff, uint8_t rate)
+{
+    if (diff < 0)
+        diff = -diff;
+    if (rate == 0)
+        return 0;
+
+    // diff / 4 degC at rate / 10 degC/s takes diff * 5 / (rate * 2) s
+    uint32_t per_step = (uint32_t)rate * 2 * TRAJ_STEP;
+    return ((uint32_t)diff * 5 + per_step - 1) / per_step;
+}
+
+/**
+ * @brief Get @p limit percent of the ramp rate @p limit (at least 0.1
+ * degC/s, unless the rate is not limited) or the segment rate @p rate ,
+ * whichever is lower.
+ */
+static uint8_t plan_rate(uint8_t limit, uint8_t rate)
+{
+    if (limit != 0) {
+        limit = (uint16_t)limit * TRAJ_RATE / 100;
+        if (limit == 0)
+            limit = 1;
+    }
+    if (rate != 0 && (limit == 0 || rate < limit))
+        limit = rate;
+    return limit;
+}
+
+void traj_build(uint8_t profile)
+{
+    uint8_t num_segs = profile_num_segs(profile), i;
+    uint16_t k = 0, j, n;
+    int cur = TRAJ_START;
+    profile_limits_t lim;
+    profile_seg_t s;
+
+    profile_limits(profile, &lim);
+    table[0] = cur;
+
+    for (i = 0; i < num_segs; i++) {
+        profile_seg(profile, i, &s);
+        seg_start[i] = k;
+
+        // segments without heater do not use the set point, it stays
+        int target = s.out == SEG_OUT_OFF || s.exit == SEG_EXIT_NEVER ? cur : s.temp;
+        uint8_t rate = target > cur ? plan_rate(lim.ramp_up, s.rate) : plan_rate(lim.ramp_down, 0);
+
+        n = ramp_steps(target - cur, rate);
+        if (n == 0 && k < TRAJ_LEN)
+            table[k] = target; // step change
+        for (j = 1; j <= n && k + j < TRAJ_LEN; j++)
+            table[k + j] = cur + (int32_t)(target - cur) * j / n;
+        k += n;
+        cur = target;
+
+        // hold for the rest of the segment time
+        if (s.exit == SEG_EXIT_TIME || s.exit == SEG_EXIT_ABOVE_OR_TIME) {
+            n = seg_start[i] + (s.time + TRAJ_STEP - 1) / TRAJ_STEP;
+            for (; k < n; k++)
+                if (k + 1 < TRAJ_LEN)
+                    table[k + 1] = cur;
+        }
+    }
+
+    for (i = num_segs; i <= PROFILE_MAX_SEGS; i++)
+        seg_start[i] = k;
+    for (k++; k < TRAJ_LEN; k++)
+        table[k] = cur;
+}
+
+uint32_t traj_seg_start(uint8_t seg)
+{
+    return seg_start[seg] * STEP_MS;
+}
+
+int traj_setpoint(uint32_t ms)
+{
+    uint32_t i = ms / STEP_MS;
+    if (i >= TRAJ_LEN - 1)
+        return table[TRAJ_LEN - 1];
+
+    int32_t diff = table[i + 1] - table[i];
+    return table[i] + (int)(diff * (int32_t)(ms - i * STEP_MS) / (int32_t)STEP_MS);
+}
+
+uint32_t traj_seek(uint8_t seg, uint32_t ms, int temp)
+{
+    uint32_t end = traj_seg_start(seg + 1), i;
+
+    for (i = ms / STEP_MS; ms < end && i < TRAJ_LEN - 1; i++, ms = i * STEP_MS) {
+        if (traj_setpoint(ms) >= temp)
+            return ms;
+        if (table[i + 1] >= temp) {
+            // crossing within this step
+            int32_t rise = table[i + 1] - table[i];
+            uint32_t at = i * STEP_MS + ((temp - table[i]) * STEP_MS + rise - 1) / rise;
+            if (at < ms)
+                at = ms;
+            return at < end ? at : end;
+        }
+    }
+    return end;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file traj.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Set point trajectory of a reflow profile
+ *
+ * The trajectory is the set point curve of a reflow, planned from the
+ * profile before it starts: beginning at @c TRAJ_START , each segment
+ * moves the set point to its temperature at no more than @c TRAJ_RATE
+ * percent of the ramp rate limits of the profile (or the rate of the
+ * segment, if lower) and holds it there for the segment time. The curve
+ * is sampled every @c TRAJ_STEP seconds into a table, so that looking up
+ * the set point at some time is a single linear interpolation.
+ *
+ * The segments of a reflow are left on temperature conditions, so the
+ * real process does not run on the time base of the plan; the reflow
+ * process manager runs its own trajectory time, which jumps to the
+ * planned start of each segment it enters (see reflow.c).
+ */
+
+#ifndef TRAJ_H
+#define TRAJ_H
+
+#include <stdint.h>
+
+// interval of the trajectory table (s)
+#ifndef TRAJ_STEP
+#define TRAJ_STEP   5
+#endif
+
+// planned duration covered by the table (s, the timeout of a reflow)
+#define TRAJ_TIME   (12 * 60)
+
+// temperature at the start of the plan (multiplied by 4)
+#ifndef TRAJ_START
+#define TRAJ_START  (25 * 4)
+#endif
+
+// ramp rates of the plan, in percent of the limits of the profile
+#ifndef TRAJ_RATE
+#define TRAJ_RATE   80
+#endif
+
+/**
+ * @brief Plan the trajectory of profile number @p profile .
+ */
+void traj_build(uint8_t profile);
+
+/**
+ * @brief Get the planned start time of segment @p seg (ms).
+ *
+ * The end of the segment is the start of segment @p seg + 1.
+ */
+uint32_t traj_seg_start(uint8_t seg);
+
+/**
+ * @brief Get the set point at trajectory time @p ms (multiplied by 4).
+ *
+ * After the end of the table the set point stays at its last value.
+ */
+int traj_setpoint(uint32_t ms);
+
+/**
+ * @brief Find the time at which the set point reaches @p temp .
+ *
+ * The function returns the first time from @p ms up to the end of segment
+ * @p seg at which the set point is at least @p temp , or the end of the
+ * segment if it stays below.
+ */
+uint32_t traj_seek(uint8_t seg, uint32_t ms, int temp);
+
+#endif // TRAJ_H
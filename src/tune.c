@@ -0,0 +1,229 @@
+/**
+ * @file tune.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Auto-tune the temperature controllers
+ */
+#include "tune.h"
+
+#include "nvm.h"
+#include "out.h"
+
+#ifdef USE_LCD_DISP
+#include "lcd.h"
+#include "fmt.h"
+#else
+#include "uart.h"
+#endif
+
+#define GAINS_VERSION 1             // version of the gains record in the EEPROM
+
+#define TUNE_HYST    2              // hysteresis of the relay (0.5 degC)
+#define TUNE_SKIP    1              // oscillation cycles ignored (transient)
+#define TUNE_CYCLES  3              // oscillation cycles measured
+#define TUNE_TIMEOUT (60 * 60)      // give up after one hour (s)
+#define TUNE_FILTER  2000           // time constant of the derivative filter (ms)
+
+#define RELAY_AMP    (OUT_MAX / 2)  // amplitude of the relay output
+
+#define STATE_HEAT   0 // heating up to the set point
+#define STATE_RELAY  1 // relay experiment running
+#define STATE_DONE   2 // new gains determined
+#define STATE_FAILED 3 // no usable oscillation (timeout)
+
+pid_gains_t tune_gains = { 160, 1, 0 };
+
+static int set_temp = TUNE_TEMP * 4; // set point of the relay
+static uint8_t state, relay_on, cycle;
+static uint32_t t_ms, t_cycle;   // time since start and start of the cycle (ms)
+static int temp_last, temp_min, temp_max;
+static uint32_t period_sum;      // sum of the measured periods (ms)
+static uint16_t amp_sum;         // sum of the measured peak-to-peak amplitudes
+
+pid_state_t tune_pid()
+{
+    pid_state_t pid = pid_init(tune_gains.P, tune_gains.I, tune_gains.D);
+    pid_limit(&pid, 0, OUT_MAX);
+    pid_filter(&pid, TUNE_FILTER);
+    return pid;
+}
+
+void tune_init()
+{
+    pid_gains_t gains;
+
+    if (nvm_load(NVM_GAINS, GAINS_VERSION, &gains, sizeof(gains)))
+        tune_gains = gains;
+}
+
+void tune_set_temp(int temp)
+{
+    set_temp = temp;
+}
+
+void tune_start()
+{
+    state = STATE_HEAT;
+    t_ms = 0;
+    period_sum = 0;
+    amp_sum = 0;
+}
+
+/**
+ * @brief Limit @p x to the range of @c int16_t .
+ */
+static int16_t sat16(int32_t x)
+{
+    return x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x);
+}
+
+/**
+ * @brief Calculate the gains from the measured oscillation and store them.
+ */
+static void compute_gains()
+{
+    uint32_t period = period_sum / TUNE_CYCLES;
+    int32_t ku, kp;
+
+    if (amp_sum == 0 || period == 0) {
+        state = STATE_FAILED;
+        return;
+    }
+
+    // ultimate gain: Ku = 4 d / (pi a) with the relay amplitude d and the
+    // amplitude a (half the peak-to-peak amplitude) of the oscillation
+    ku = (8000L * RELAY_AMP * TUNE_CYCLES) / (3142L * amp_sum);
+
+    // Tyreus-Luyben: Kp = Ku / 2.2, Ti = 2.2 Tu, Td = Tu / 6.3 (less
+    // aggressive than Ziegler-Nichols, which suits the long lag of the oven)
+    kp = ku * 10 / 22;
+    tune_gains.P = sat16(kp);
+    tune_gains.I = sat16((kp * 1000 * 10 / 22 + period / 2) / period);
+    tune_gains.D = sat16(kp * (int32_t)(period / 100) / 10 * 10 / 63);
+    if (tune_gains.I == 0)
+        tune_gains.I = 1;
+
+    nvm_save(NVM_GAINS, GAINS_VERSION, &tune_gains, sizeof(tune_gains));
+    state = STATE_DONE;
+}
+
+int tune_update(int temp, uint16_t dt)
+{
+    temp_last = temp;
+    t_ms += dt;
+
+    if (state >= STATE_DONE)
+        return 0;
+
+    if (t_ms >= TUNE_TIMEOUT * 1000UL) {
+        state = STATE_FAILED;
+        return 0;
+    }
+
+    if (state == STATE_HEAT) {
+        if (temp < set_temp)
+            return OUT_MAX;
+
+        state = STATE_RELAY;
+        relay_on = 0;
+        cycle = 0;
+        temp_min = temp_max = temp;
+    }
+
+    if (temp < temp_min)
+        temp_min = temp;
+    if (temp > temp_max)
+        temp_max = temp;
+
+    if (relay_on && temp > set_temp + TUNE_HYST)
+        relay_on = 0;
+    else if (!relay_on && temp < set_temp - TUNE_HYST) {
+        // switching on ends a cycle; the first one is incomplete
+        relay_on = 1;
+        if (cycle > TUNE_SKIP) {
+            period_sum += t_ms - t_cycle;
+            amp_sum += temp_max - temp_min;
+        }
+        t_cycle = t_ms;
+        temp_min = temp_max = temp;
+
+        if (++cycle > TUNE_SKIP + TUNE_CYCLES) {
+            compute_gains();
+            return 0;
+        }
+    }
+
+    return relay_on ? OUT_MAX : 0;
+}
+
+void tune_show()
+{
+    int t = t_ms / 1000;
+#ifdef USE_LCD_DISP
+    char line[LCD_COLS + 1], *p;
+
+    lcd_clear();
+    p = fmt_str(line, "AUTO-TUNE    ");
+    p = fmt_int(p, t, 4, ' ');
+    fmt_str(p, "'");
+    lcd_write(line);
+    p = fmt_str(line, "Temp: ");
+    p = fmt_temp4(p, temp_last, 3);
+    fmt_str(p, " degC");
+    lcd_write(line);
+
+    switch (state) {
+        case STATE_HEAT:
+            lcd_write("HEATING");
+            lcd_backlight(0, LCD_BACKLIGHT_MAX, 0);
+            break;
+
+        case STATE_RELAY:
+            p = fmt_str(line, "CYCLE ");
+            p = fmt_int(p, cycle, 0, ' ');
+            p = fmt_str(p, "/");
+            fmt_int(p, TUNE_SKIP + TUNE_CYCLES, 0, ' ');
+            lcd_write(line);
+            lcd_backlight(0, LCD_BACKLIGHT_MAX, 0);
+            break;
+
+        case STATE_DONE:
+            lcd_write("DONE");
+            p = fmt_str(line, "P");
+            p = fmt_int(p, tune_gains.P, 0, ' ');
+            p = fmt_str(p, " I");
+            p = fmt_int(p, tune_gains.I, 0, ' ');
+            p = fmt_str(p, " D");
+            fmt_int(p, tune_gains.D, 0, ' ');
+            lcd_write(line);
+            lcd_backlight(0, 0, LCD_BACKLIGHT_MAX);
+            break;
+
+        case STATE_FAILED:
+            lcd_write("FAILED");
+            lcd_backlight(LCD_BACKLIGHT_MAX, 0, 0);
+            break;
+    }
+#else
+    fprintf(uart_file, "%4d\t%3d.%02d\t", t, temp_last >> 2, (temp_last & 3) * 25);
+
+    switch (state) {
+        case STATE_HEAT:
+            fprintf(uart_file, " HEATING\n");
+            break;
+
+        case STATE_RELAY:
+            fprintf(uart_file, " CYCLE %d/%d\n", cycle, TUNE_SKIP + TUNE_CYCLES);
+            break;
+
+        case STATE_DONE:
+            fprintf(uart_file, " DONE P: %d I: %d D: %d\n", tune_gains.P, tune_gains.I, tune_gains.D);
+            break;
+
+        case STATE_FAILED:
+            fprintf(uart_file, " FAILED\n");
+            break;
+    }
+#endif
+}
@@ -0,0 +1,93 @@
+/**
+ * @file tune.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Auto-tune the temperature controllers
+ *
+ * The gains of the PID controllers are determined with a relay feedback
+ * experiment (Astrom and Hagglund): the heater is switched fully on below
+ * and off above a set point, which makes the oven temperature oscillate
+ * around it. The ultimate gain follows from the amplitude of the
+ * oscillation, the ultimate period is its period; the PID gains are
+ * calculated from both with the Tyreus-Luyben rules.
+ *
+ * The gains are stored in the EEPROM and used for soak and bake from then
+ * on.
+ */
+
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <stdint.h>
+
+#include "pid.h"
+
+/**
+ * @brief Default set point of the relay experiment (degC).
+ *
+ * The gains suit the temperatures around the one they were tuned at best;
+ * another set point can be chosen with @c tune_set_temp() (e.g. by the
+ * tune command, see cmd.h).
+ */
+#ifndef TUNE_TEMP
+#define TUNE_TEMP 150
+#endif
+
+/**
+ * @brief Gains of the temperature controllers.
+ *
+ * These are the gains found by the last auto-tune, or the defaults.
+ */
+extern pid_gains_t tune_gains;
+
+/**
+ * @brief Create a temperature controller with the current gains.
+ *
+ * The output of the controller is limited to 0 to @c OUT_MAX (see out.h).
+ */
+pid_state_t tune_pid();
+
+/**
+ * @brief Load the gains from the EEPROM.
+ *
+ * The defaults are used if no valid gains have been stored.
+ */
+void tune_init();
+
+/**
+ * @brief Set the set point of the relay experiment to @p temp (multiplied
+ * by 4) for the following auto-tunes.
+ */
+void tune_set_temp(int temp);
+
+/**
+ * @brief Start auto-tuning.
+ *
+ * This function must be called each time an auto-tune is started.
+ */
+void tune_start();
+
+/**
+ * @brief Update the auto-tune state.
+ *
+ * This function must be called periodically while auto-tuning. @p temp is
+ * the temperature within the oven and @p dt is the time since the last
+ * call (or the start) in ms.
+ *
+ * The function returns the heater power (0 to @c OUT_MAX , see out.h).
+ *
+ * The auto-tune has ended if the output value is 0 and the temperature has
+ * dropped below 50 degC.
+ */
+int tune_update(int temp, uint16_t dt);
+
+/**
+ * @brief Show the auto-tune state.
+ *
+ * This function writes the state after the last call to @c tune_update()
+ * to the LCD or the serial output.
+ */
+void tune_show();
+
+#endif // TUNE_H
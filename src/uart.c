@@ -3,33 +3,198 @@
  * @author Michael Platzer
  * @date 2018-11-29
  *
- * @brief UART serial output
+ * @brief UART serial output and input
  */
 #include "uart.h"
 
-#include <avr/io.h>
+#include "hal.h"
+
+#if UART_TX_BUF_SIZE > 256 || (UART_TX_BUF_SIZE & (UART_TX_BUF_SIZE - 1)) != 0
+#error "UART_TX_BUF_SIZE must be a power of 2 and not larger than 256"
+#endif
+
+#if UART_RX_BUF_SIZE > 256 || (UART_RX_BUF_SIZE & (UART_RX_BUF_SIZE - 1)) != 0
+#error "UART_RX_BUF_SIZE must be a power of 2 and not larger than 256"
+#endif
+
+#define TX_MASK (UART_TX_BUF_SIZE - 1)
+#define RX_MASK (UART_RX_BUF_SIZE - 1)
+
+static char tx_buf[UART_TX_BUF_SIZE];
+static volatile uint8_t tx_head, // index of the next free slot
+                        tx_tail; // index of the next character to send
+static volatile uint16_t tx_dropped;
+static uint8_t tx_msg,      // collecting a message (see uart_tx_begin())
+               tx_msg_head, // index of the next free slot after the message
+               tx_msg_full; // the message does not fit
+static uint16_t tx_msg_len;
+
+static char rx_buf[UART_RX_BUF_SIZE];
+static volatile uint8_t rx_head, // index of the next free slot
+                        rx_tail; // index of the next character to read
+static volatile uint16_t rx_dropped;
+
+static int uart_putc(char c, FILE *f);
+
+FILE *uart_file;
 
 void uart_init()
 {
-    // set pin D7 high and as output (TX pin)
-    PORTD.OUTSET = 0x80;
-    PORTD.DIRSET = 0x80;
+    hal_uart_init();
+    uart_file = hal_uart_stream(uart_putc);
+}
+
+uint16_t uart_tx_dropped()
+{
+    uint16_t dropped;
+    HAL_ATOMIC {
+        dropped = tx_dropped;
+    }
+    return dropped;
+}
+
+void uart_puts(const char *str)
+{
+    while (*str != 0)
+        uart_putc(*str++, uart_file);
+}
+
+void uart_puts_P(const char *str)
+{
+    char c;
+    while ((c = pgm_read_byte(str++)) != 0)
+        uart_putc(c, uart_file);
+}
+
+void uart_tx_begin()
+{
+    tx_msg_head = tx_head;
+    tx_msg_full = 0;
+    tx_msg_len = 0;
+    tx_msg = 1;
+}
+
+uint8_t uart_tx_end()
+{
+    tx_msg = 0;
+    if (tx_msg_full) {
+        HAL_ATOMIC {
+            tx_dropped = tx_dropped > 0xffff - tx_msg_len ? 0xffff : tx_dropped + tx_msg_len;
+        }
+        return 0;
+    }
+    if (tx_msg_head != tx_head) {
+        HAL_ATOMIC {
+            tx_head = tx_msg_head;
+            hal_uart_tx_irq(1);
+        }
+    }
+    return 1;
+}
+
+void uart_flush()
+{
+    while (tx_tail != tx_head);
+}
+
+int uart_getc()
+{
+    uint8_t tail = rx_tail;
+    if (tail == rx_head)
+        return -1;
+
+    char c = rx_buf[tail];
+    rx_tail = (tail + 1) & RX_MASK;
+    return (unsigned char)c;
+}
 
-    // target baud rate: 9600, 2 MHz clock => BSCALE = 0, BSEL = 12
-    USARTD1.BAUDCTRLB = 0;
-    USARTD1.BAUDCTRLA = 13;
+uint16_t uart_rx_dropped()
+{
+    uint16_t dropped;
+    HAL_ATOMIC {
+        dropped = rx_dropped;
+    }
+    return dropped;
+}
 
-    USARTD1.CTRLA = 0; // disable interrupts
-    USARTD1.CTRLC = 3; // async, no parity, 8 bit data, 1 stop bit
+/**
+ * @brief Store a received character in the ring buffer.
+ */
+void hal_on_uart_rx(char c)
+{
+    uint8_t head = rx_head;
+    uint8_t next = (head + 1) & RX_MASK;
 
-    USARTD1.CTRLB = 8; // enable transmitter
+    if (next == rx_tail) {
+        // mark the gap in place of the newest character
+        rx_buf[(head - 1) & RX_MASK] = 0;
+        if (rx_dropped != 0xffff)
+            rx_dropped++;
+        return;
+    }
+    rx_buf[head] = c;
+    rx_head = next;
+}
+
+/**
+ * @brief Send the next character from the ring buffer.
+ *
+ * Called by the data register empty interrupt, which is disabled again
+ * once the buffer is empty.
+ */
+void hal_on_uart_tx()
+{
+    uint8_t tail = tx_tail;
+    hal_uart_tx(tx_buf[tail]);
+    tail = (tail + 1) & TX_MASK;
+    tx_tail = tail;
+
+    if (tail == tx_head)
+        hal_uart_tx_irq(0); // buffer empty, disable DRE interrupt
 }
 
 static int uart_putc(char c, FILE *f)
 {
-    while (!(USARTD1.STATUS & 0x20)); // wait for data register empty flag
-    USARTD1.DATA = c; // write data
+    if (tx_msg) {
+        uint8_t next = (tx_msg_head + 1) & TX_MASK;
+        if (next == tx_tail)
+            tx_msg_full = 1;
+        if (!tx_msg_full) {
+            tx_buf[tx_msg_head] = c;
+            tx_msg_head = next;
+        }
+        tx_msg_len++;
+        return 0;
+    }
+
+    uint8_t head = tx_head;
+    uint8_t next = (head + 1) & TX_MASK;
+
+    while (next == tx_tail) {
+#if UART_TX_POLICY == UART_TX_DROP
+        HAL_ATOMIC {
+            if (tx_dropped != 0xffff)
+                tx_dropped++;
+        }
+        return 0;
+#else
+        // The DRE interrupt cannot run if we are called from an interrupt
+        // routine of the same or a higher level, hence send the oldest
+        // character ourselves as soon as the data register is empty.
+        HAL_ATOMIC {
+            uint8_t tail = tx_tail;
+            if (next == tail && hal_uart_tx_ready()) {
+                hal_uart_tx(tx_buf[tail]);
+                tx_tail = (tail + 1) & TX_MASK;
+            }
+        }
+#endif
+    }
+
+    tx_buf[head] = c;
+    HAL_ATOMIC {
+        tx_head = next;
+        hal_uart_tx_irq(1);
+    }
     return 0;
 }
-
-FILE uartout = FDEV_SETUP_STREAM(uart_putc, NULL, _FDEV_SETUP_WRITE);
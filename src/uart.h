@@ -3,26 +3,127 @@
  * @author Michael Platzer
  * @date 2018-11-29
  *
- * @brief UART serial output
+ * @brief UART serial output and input
  */
 
 #ifndef UART_H
 #define UART_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 /**
- * @brief Initialize the serial output.
+ * @brief Size of the transmit ring buffer in bytes.
  *
- * This function initializes the serial output.
+ * Must be a power of 2 and at most 256. The default holds one complete
+ * refresh of the LCD.
+ */
+#ifndef UART_TX_BUF_SIZE
+#define UART_TX_BUF_SIZE 128
+#endif
+
+#define UART_TX_DROP  0 // discard a character if the transmit buffer is full
+#define UART_TX_BLOCK 1 // wait until there is room in the transmit buffer
+
+/**
+ * @brief Behaviour when writing to a full transmit buffer.
+ *
+ * With @c UART_TX_DROP characters that do not fit are discarded and
+ * counted (see @c uart_tx_dropped() ). With @c UART_TX_BLOCK the writer
+ * waits until the oldest character has been sent; this also works from
+ * within interrupt routines, since the buffer is then drained by polling.
+ */
+#ifndef UART_TX_POLICY
+#define UART_TX_POLICY UART_TX_BLOCK
+#endif
+
+/**
+ * @brief Size of the receive ring buffer in bytes.
+ *
+ * Must be a power of 2 and at most 256. The default holds a few command
+ * lines (see cmd.h).
+ */
+#ifndef UART_RX_BUF_SIZE
+#define UART_RX_BUF_SIZE 64
+#endif
+
+/**
+ * @brief Initialize the serial output and input.
+ *
+ * This function initializes the serial output and input.
  */
 void uart_init();
 
+/**
+ * @brief Get the next received character.
+ *
+ * The function returns the oldest character in the receive buffer, or -1
+ * if it is empty. Where received characters have been discarded because
+ * the buffer was full, the last character before them reads as 0.
+ */
+int uart_getc();
+
+/**
+ * @brief Get the number of received characters that have been discarded
+ * because the receive buffer was full. The counter saturates at 65535.
+ */
+uint16_t uart_rx_dropped();
+
+/**
+ * @brief Write the string @p str to the serial output.
+ *
+ * Like fputs() to @c uart_file , but without stdio; together with the
+ * functions of fmt.h this replaces fprintf() for the replies and dumps.
+ */
+void uart_puts(const char *str);
+
+/**
+ * @brief Write the string @p str in the program memory (see PSTR()) to
+ * the serial output.
+ */
+void uart_puts_P(const char *str);
+
+/**
+ * @brief Start a message that is sent completely or not at all.
+ *
+ * The characters written until @c uart_tx_end() are collected in the
+ * transmit buffer without waiting, whatever @c UART_TX_POLICY says. If
+ * they do not all fit, the message is discarded and its characters are
+ * counted as dropped. Interrupt routines must not write to the serial
+ * output in the meantime.
+ */
+void uart_tx_begin();
+
+/**
+ * @brief Send the message started by @c uart_tx_begin() .
+ *
+ * The function returns 1 if the message is sent and 0 if it has been
+ * discarded.
+ */
+uint8_t uart_tx_end();
+
+/**
+ * @brief Get the number of dropped characters.
+ *
+ * This function returns the number of characters that have been discarded
+ * because the transmit buffer was full. The counter saturates at 65535.
+ */
+uint16_t uart_tx_dropped();
+
+/**
+ * @brief Wait until all characters in the transmit buffer have been sent.
+ *
+ * Interrupts must be enabled.
+ */
+void uart_flush();
+
 /**
  * @brief Serial file object.
  *
- * Use this file object to write data to the serial output.
+ * Use this file object to write data to the serial output; it is set up by
+ * @c uart_init() . Characters are placed in a ring buffer and sent in the
+ * background by the data register empty interrupt of the USART.
  */
-extern FILE uartout;
+extern FILE *uart_file;
 
 #endif // UART_H
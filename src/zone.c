@@ -0,0 +1,88 @@
+/**
+ * @file zone.c
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Per-zone temperature control
+ */
+#include "zone.h"
+#include "pid.h"
+#include "tune.h"
+
+#if ZONE_PID
+// entry n of ZONE_SENSORS (0 if there are fewer entries)
+#define SENSOR(n) SENSOR_(SENSOR##n, ZONE_SENSORS, 0, 0, 0, 0)
+#define SENSOR_(f, ...) f(__VA_ARGS__)
+#define SENSOR0(a, ...) a
+#define SENSOR1(a, b, ...) b
+#define SENSOR2(a, b, c, ...) c
+#define SENSOR3(a, b, c, d, ...) d
+
+#if SENSOR(0) >= TEMP_CHANNELS || (OUT_ZONES > 1 && SENSOR(1) >= TEMP_CHANNELS) || \
+    (OUT_ZONES > 2 && SENSOR(2) >= TEMP_CHANNELS) || (OUT_ZONES > 3 && SENSOR(3) >= TEMP_CHANNELS)
+#error "ZONE_SENSORS: each zone needs a channel below TEMP_CHANNELS"
+#endif
+
+static const uint8_t sensors[4] = { ZONE_SENSORS };
+
+static pid_state_t pid[OUT_ZONES];
+static uint8_t active; // whether the controllers are running
+
+// readings of each channel since the last update (a mean one is dropped
+// when count is full, e.g. while a fault holds off the updates):
+static int32_t sum[TEMP_CHANNELS];
+static uint8_t count[TEMP_CHANNELS];
+static int mean[TEMP_CHANNELS]; // mean of the last readings
+#endif
+
+void zone_start()
+{
+#if ZONE_PID
+    active = 0;
+#endif
+}
+
+void zone_reading(uint8_t ch, int temp)
+{
+#if ZONE_PID
+    if (count[ch] == UINT8_MAX) {
+        sum[ch] -= sum[ch] / count[ch];
+        count[ch]--;
+    }
+    sum[ch] += temp;
+    count[ch]++;
+#endif
+}
+
+void zone_update(uint16_t out, int sp, uint8_t current, uint16_t dt)
+{
+#if ZONE_PID
+    uint8_t ch, z;
+
+    for (ch = 0; ch < TEMP_CHANNELS; ch++) {
+        if (count[ch] != 0)
+            mean[ch] = (sum[ch] + (sum[ch] >= 0 ? count[ch] / 2 : -(count[ch] / 2))) / count[ch];
+        sum[ch] = 0;
+        count[ch] = 0;
+    }
+
+    if (sp != 0) {
+        if (!active) {
+            for (z = 0; z < OUT_ZONES; z++)
+                pid[z] = tune_pid();
+            active = 1;
+        }
+
+        for (z = 0; z < OUT_ZONES; z++) {
+            ch = sensors[z];
+            if (current & (1 << ch))
+                out_set_zone(z, pid_update(&pid[z], sp, mean[ch], OUT_FF, dt));
+            else
+                out_set_zone(z, 0);
+        }
+        return;
+    }
+    active = 0;
+#endif
+    out_set(out);
+}
@@ -0,0 +1,65 @@
+/**
+ * @file zone.h
+ * @author Michael Platzer
+ * @date 2018-11-29
+ *
+ * @brief Per-zone temperature control
+ *
+ * With more than one heater zone (see @c OUT_ZONES ), each zone can follow
+ * the set point of the process with its own PID controller on the
+ * thermocouple in that zone (see @c ZONE_SENSORS ), instead of all zones
+ * getting the output of the controller of the process, which works on the
+ * combined temperature of all thermocouples. Segments without a set point
+ * (heater fully on or off) and the auto-tune drive all zones alike.
+ *
+ * The zone controllers start with the gains of the auto-tune (see
+ * @c tune_pid() ) and work on the mean of the readings since their last
+ * update. A zone whose thermocouple has no current reading is switched off.
+ */
+
+#ifndef ZONE_H
+#define ZONE_H
+
+#include <stdint.h>
+
+#include "out.h"
+#include "temp.h"
+
+/**
+ * @brief Thermocouple channel of each zone, separated by commas (the first
+ * @c OUT_ZONES entries are used, each one below @c TEMP_CHANNELS ).
+ */
+#ifndef ZONE_SENSORS
+#define ZONE_SENSORS 0, 1, 2, 3
+#endif
+
+/**
+ * @brief Control the zones with their own controllers (non-zero) or drive
+ * all of them with the output of the process.
+ */
+#ifndef ZONE_PID
+#define ZONE_PID (OUT_ZONES > 1 && TEMP_CHANNELS > 1)
+#endif
+
+/**
+ * @brief Restart the zone controllers (at the start of a process).
+ */
+void zone_start();
+
+/**
+ * @brief Add the good reading @p temp (multiplied by 4) of thermocouple
+ * channel @p ch .
+ */
+void zone_reading(uint8_t ch, int temp);
+
+/**
+ * @brief Set the heater outputs.
+ *
+ * @p out is the output of the process and @p sp its set point (0 if the
+ * output does not come from a controller). Bit ch of @p current is set if
+ * channel ch has a current reading. @p dt is the time since the last update
+ * in ms.
+ */
+void zone_update(uint16_t out, int sp, uint8_t current, uint16_t dt);
+
+#endif // ZONE_H